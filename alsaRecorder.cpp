@@ -0,0 +1,272 @@
+#include "alsaRecorder.h"
+#include "logger.h"
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <chrono>
+#include <algorithm>
+
+alsaRecorder::alsaRecorder(){
+    this->pcm = NULL;
+    this->lame = NULL;
+    this->file = NULL;
+    this->channelCount = 0;
+    this->sampleRate = 0;
+    this->ring = NULL;
+    this->capturing.store(false);
+    this->encoding.store(false);
+    this->captured.store(0);
+    this->dropped.store(0);
+    this->overruns.store(0);
+    this->encodedBytes.store(0);
+    this->placement = NULL;
+}
+
+alsaRecorder::~alsaRecorder(){
+    this->stop();
+}
+
+// Opens the device for mmap capture and returns 1 with sampleRate set to
+// what the hardware actually runs at
+int alsaRecorder::openDevice(const char* device, unsigned rate, int channels){
+    int rc = snd_pcm_open(&this->pcm, device, SND_PCM_STREAM_CAPTURE, 0);
+    if (rc < 0) {
+        printf("Unable to open PCM device %s: %s\n", device, snd_strerror(rc));
+        this->pcm = NULL;
+        return 0;
+    }
+
+    snd_pcm_hw_params_t* params;
+    snd_pcm_hw_params_malloc(&params);
+    snd_pcm_hw_params_any(this->pcm, params);
+    snd_pcm_uframes_t period = RECORDER_PERIOD_FRAMES;
+    snd_pcm_uframes_t bufferFrames = RECORDER_PERIOD_FRAMES * RECORDER_PERIODS;
+    int dir = 0;
+    rc = snd_pcm_hw_params_set_access(this->pcm, params, SND_PCM_ACCESS_MMAP_INTERLEAVED);
+    if (rc >= 0) rc = snd_pcm_hw_params_set_format(this->pcm, params, SND_PCM_FORMAT_S16_LE);
+    if (rc >= 0) rc = snd_pcm_hw_params_set_channels(this->pcm, params, channels);
+    if (rc >= 0) rc = snd_pcm_hw_params_set_rate_near(this->pcm, params, &rate, &dir);
+    if (rc >= 0) rc = snd_pcm_hw_params_set_period_size_near(this->pcm, params, &period, &dir);
+    if (rc >= 0) rc = snd_pcm_hw_params_set_buffer_size_near(this->pcm, params, &bufferFrames);
+    if (rc >= 0) rc = snd_pcm_hw_params(this->pcm, params);
+    snd_pcm_hw_params_free(params);
+    if (rc >= 0) rc = snd_pcm_prepare(this->pcm);
+    if (rc < 0) {
+        printf("Unable to set up %s for mmap capture (%d channels, %u Hz): %s\n", device, channels, rate, snd_strerror(rc));
+        snd_pcm_close(this->pcm);
+        this->pcm = NULL;
+        return 0;
+    }
+    this->sampleRate = rate;
+    return 1;
+}
+
+// Starts recording `device` to the MP3 at `path`. bitrate is in kbit/s,
+// 0 for LAME's default VBR. Only mono and stereo can be encoded.
+int alsaRecorder::start(const char* path, const char* device, unsigned rate, int channels, int bitrate){
+    if (this->isRecording()) {
+        printf("Already recording\n");
+        return 0;
+    }
+    // A capture that died on an error has stopped recording but still holds
+    // its threads, device, encoder and file; finish and release them first
+    if (this->captureThread.joinable() || this->encoderThread.joinable()) {
+        this->stop();
+    }
+    if (channels < 1 || channels > 2) {
+        printf("MP3 recording takes 1 or 2 channels, not %d\n", channels);
+        return 0;
+    }
+    if (!this->openDevice(device, rate, channels)) {
+        return 0;
+    }
+    this->channelCount = channels;
+
+    // The encoder is told the rate the hardware settled on, not the one asked for
+    this->lame = lame_init();
+    lame_set_in_samplerate(this->lame, this->sampleRate);
+    lame_set_num_channels(this->lame, channels);
+    lame_set_mode(this->lame, channels == 1 ? MONO : JOINT_STEREO);
+    if (bitrate > 0) {
+        lame_set_brate(this->lame, bitrate);
+    } else {
+        lame_set_VBR(this->lame, vbr_default);
+    }
+    this->file = fopen(path, "wb");
+    if (this->lame == NULL || lame_init_params(this->lame) < 0 || this->file == NULL) {
+        printf("Unable to set up the encoder for %s\n", path);
+        this->stop();
+        return 0;
+    }
+
+    this->ring = new spscRing<short>((size_t)this->sampleRate * RECORDER_RING_SECONDS * channels);
+    this->captured.store(0);
+    this->dropped.store(0);
+    this->overruns.store(0);
+    this->encodedBytes.store(0);
+    this->capturing.store(true);
+    this->encoding.store(true);
+    this->encoderThread = std::thread(&alsaRecorder::encode, this);
+    this->captureThread = std::thread(&alsaRecorder::capture, this);
+    return 1;
+}
+
+// Stops capture, encodes what is still queued, flushes the encoder and
+// closes the file
+void alsaRecorder::stop(){
+    this->capturing.store(false);
+    if (this->captureThread.joinable()) {
+        this->captureThread.join();
+    }
+    this->encoding.store(false);
+    if (this->encoderThread.joinable()) {
+        this->encoderThread.join();
+    }
+    if (this->file != NULL) {
+        fclose(this->file);
+        this->file = NULL;
+    }
+    if (this->lame != NULL) {
+        lame_close(this->lame);
+        this->lame = NULL;
+    }
+    if (this->pcm != NULL) {
+        snd_pcm_close(this->pcm);
+        this->pcm = NULL;
+    }
+    delete this->ring;
+    this->ring = NULL;
+}
+
+// Capture thread: wait for a period, copy it out of the mapped buffer,
+// hand it back. Nothing here allocates, encodes or touches a file.
+void alsaRecorder::capture(){
+    if (this->placement != NULL) {
+        this->placement->apply(THREAD_AUDIO);
+    }
+    int channels = this->channelCount;
+    int rc = snd_pcm_start(this->pcm);
+    while (this->capturing.load(std::memory_order_relaxed)) {
+        if (rc >= 0) {
+            rc = snd_pcm_wait(this->pcm, 1000);
+        }
+        snd_pcm_sframes_t avail = rc >= 0 ? snd_pcm_avail_update(this->pcm) : rc;
+        while (avail > 0) {
+            const snd_pcm_channel_area_t* areas;
+            snd_pcm_uframes_t offset;
+            snd_pcm_uframes_t frames = (snd_pcm_uframes_t)avail;
+            rc = snd_pcm_mmap_begin(this->pcm, &areas, &offset, &frames);
+            if (rc < 0) {
+                avail = rc;
+                break;
+            }
+            // Interleaved S16: every channel's area starts at the same frame
+            const short* samples = (const short*)((const char*)areas[0].addr + areas[0].first / 8 + offset * areas[0].step / 8);
+            size_t room = (this->ring->capacity() - this->ring->size()) / channels;
+            size_t queued = std::min<size_t>(frames, room);
+            this->ring->write(samples, queued * channels);
+            if (queued < frames) {
+                this->dropped.fetch_add(frames - queued, std::memory_order_relaxed);
+            }
+            this->captured.fetch_add(frames, std::memory_order_relaxed);
+            snd_pcm_sframes_t committed = snd_pcm_mmap_commit(this->pcm, offset, frames);
+            if (committed < 0 || (snd_pcm_uframes_t)committed != frames) {
+                avail = committed < 0 ? committed : -EPIPE;
+                break;
+            }
+            avail -= frames;
+        }
+        if (avail < 0) {
+            // Overrun (or suspend): whatever the device held is gone; restart it
+            if (avail == -EPIPE) {
+                this->overruns.fetch_add(1, std::memory_order_relaxed);
+                logWarn("Capture overrun, restarting the device");
+            }
+            rc = snd_pcm_recover(this->pcm, (int)avail, 1);
+            if (rc >= 0) {
+                rc = snd_pcm_start(this->pcm);
+            }
+            if (rc < 0) {
+                logError("Capture stopped: %s", snd_strerror(rc));
+                this->capturing.store(false);
+                break;
+            }
+        }
+    }
+    snd_pcm_drop(this->pcm);
+}
+
+// Encoder thread: takes the ring in big batches so LAME and the disk see a
+// few large calls a second rather than one per period
+void alsaRecorder::encode(){
+    int channels = this->channelCount;
+    std::vector<short> pcmBatch((size_t)RECORDER_BATCH_FRAMES * channels);
+    std::vector<unsigned char> mp3((size_t)(1.25 * RECORDER_BATCH_FRAMES) + 7200);
+    std::vector<unsigned char> pending;
+    pending.reserve(RECORDER_WRITE_BYTES + mp3.size());
+    bool writeFailed = false;
+
+    while (true) {
+        bool more = this->encoding.load();
+        int frames = (int)(this->ring->read(&pcmBatch[0], pcmBatch.size()) / channels);
+        if (frames > 0) {
+            int bytes = channels == 1
+                ? lame_encode_buffer(this->lame, &pcmBatch[0], &pcmBatch[0], frames, &mp3[0], (int)mp3.size())
+                : lame_encode_buffer_interleaved(this->lame, &pcmBatch[0], frames, &mp3[0], (int)mp3.size());
+            if (bytes > 0) {
+                pending.insert(pending.end(), mp3.begin(), mp3.begin() + bytes);
+            }
+        }
+        bool last = !more && frames == 0;
+        if (last) {
+            int bytes = lame_encode_flush(this->lame, &mp3[0], (int)mp3.size());
+            if (bytes > 0) {
+                pending.insert(pending.end(), mp3.begin(), mp3.begin() + bytes);
+            }
+        }
+        if (pending.size() >= RECORDER_WRITE_BYTES || (last && !pending.empty())) {
+            if (fwrite(&pending[0], 1, pending.size(), this->file) != pending.size() && !writeFailed) {
+                logError("Writing the recording failed: %s", strerror(errno));
+                writeFailed = true;
+            }
+            this->encodedBytes.fetch_add(pending.size(), std::memory_order_relaxed);
+            pending.clear();
+        }
+        if (last) {
+            break;
+        }
+        if (frames < RECORDER_BATCH_FRAMES && more) {
+            // Let a full batch build up rather than spinning on every period
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000 * RECORDER_BATCH_FRAMES / 4 / (int)this->sampleRate + 1));
+        }
+    }
+    fflush(this->file);
+}
+
+bool alsaRecorder::isRecording(){
+    return this->capturing.load();
+}
+
+// Capture thread placement (THREAD_AUDIO); set before start()
+void alsaRecorder::setPlacement(threadPlacement* placement){
+    this->placement = placement;
+}
+
+// Audio taken off the device so far, dropped frames included
+double alsaRecorder::secondsRecorded(){
+    return this->sampleRate > 0 ? (double)this->captured.load() / this->sampleRate : 0.0;
+}
+
+// Frames lost because the encoder fell more than RECORDER_RING_SECONDS behind
+unsigned long long alsaRecorder::droppedFrames(){
+    return this->dropped.load();
+}
+
+// Device overruns: the capture thread itself was too late
+unsigned long long alsaRecorder::xruns(){
+    return this->overruns.load();
+}
+
+unsigned long long alsaRecorder::bytesWritten(){
+    return this->encodedBytes.load();
+}
@@ -0,0 +1,70 @@
+#ifndef ALSARECORDER_H
+#define ALSARECORDER_H
+
+#include <atomic>
+#include <thread>
+#include <string>
+#include <vector>
+#include <alsa/asoundlib.h>
+#include <lame/lame.h>
+#include "spscRing.h"
+#include "threadPlacement.h"
+
+#define RECORDER_RING_SECONDS 8        // Captured audio the encoder may fall behind by before frames drop
+#define RECORDER_PERIOD_FRAMES 1024    // ALSA period: how often the capture thread wakes
+#define RECORDER_PERIODS 4             // Periods in the ALSA buffer
+#define RECORDER_BATCH_FRAMES 16384    // Frames the encoder takes per pass (~0.37 s at 44.1 kHz)
+#define RECORDER_WRITE_BYTES (256 * 1024) // Encoded MP3 gathered before each fwrite
+
+// Records a set to MP3 in constant memory, however long it runs.
+//
+// A capture thread maps the ALSA buffer (SND_PCM_ACCESS_MMAP_INTERLEAVED),
+// copies each period straight from the device's memory into a fixed
+// lock-free ring and commits it back, and does nothing else. A separate
+// encoder thread drains the ring in large batches through LAME and writes
+// the MP3 in RECORDER_WRITE_BYTES chunks. A slow disk or an encoder stall
+// only fills the ring (RECORDER_RING_SECONDS deep); the device itself never
+// overruns unless the capture thread is starved, and either kind of loss is
+// counted rather than silently skipped.
+//
+//   alsaRecorder recorder;
+//   recorder.start("set.mp3");        // "default" device, 44.1 kHz stereo
+//   ...
+//   recorder.stop();                  // Drains, flushes and closes the file
+class alsaRecorder{
+    private:
+        snd_pcm_t* pcm;
+        lame_t lame;
+        FILE* file;
+        int channelCount;
+        unsigned sampleRate;
+        spscRing<short>* ring;
+        std::thread captureThread;
+        std::thread encoderThread;
+        std::atomic<bool> capturing;
+        std::atomic<bool> encoding;
+        std::atomic<unsigned long long> captured;  // Frames taken off the device
+        std::atomic<unsigned long long> dropped;   // Frames lost to a full ring
+        std::atomic<unsigned long long> overruns;  // Device overruns (-EPIPE) recovered from
+        std::atomic<unsigned long long> encodedBytes;
+        threadPlacement* placement;
+
+        int openDevice(const char* device, unsigned rate, int channels);
+        void capture();
+        void encode();
+    public:
+        alsaRecorder();
+        ~alsaRecorder();
+
+        int start(const char* path, const char* device = "default", unsigned rate = 44100, int channels = 2, int bitrate = 0);
+        void stop();
+        bool isRecording();
+        void setPlacement(threadPlacement*);
+
+        double secondsRecorded();
+        unsigned long long droppedFrames();
+        unsigned long long xruns();
+        unsigned long long bytesWritten();
+};
+
+#endif
@@ -1,27 +1,40 @@
 #include "audioAnalyzer.h"
+#include "simdKernels.h"
+#include "portAudioSession.h"
 audioAnalyzer::~audioAnalyzer(){
     // Free allocated resources used for FFT calculation
-    fftw_destroy_plan(this->spectroData->p);
-    fftw_free(this->spectroData->in);
-    fftw_free(this->spectroData->out);
-    free(this->spectroData);
+    this->endSession();
+    delete this->tones;
+    delete this->cq;
+    delete this->normalizer;
+    delete this->callbackJitter;
 }
 
 
-float bpmDetection(streamCallbackData* data, const void *inputBuffer){
+float bpmDetection(streamCallbackData* data, const void *inputBuffer, unsigned long frames){
     const float *in = (const float *)inputBuffer;
-    // Copy audio data into the input vector for Aubio processing
-    for (size_t j = 0; j < FRAMES_PER_BUFFER; ++j) {
-        data->in_vec->data[j] = in[j];
-    }
-
-    aubio_tempo_do(data->tempo, data->in_vec, data->tempo_out);
-    if (aubio_tempo_get_last(data->tempo) != 0) {
-        float bpm = aubio_tempo_get_bpm(data->tempo);
-        data->bpm_sum += bpm;
-        data->bpm_count++;
+    // in_vec only holds one aubio hop, which need not divide our hop, so
+    // fill it across buffers and run the tracker whenever it is full
+    uint_t hop = data->in_vec->length;
+    for (unsigned long i = 0; i < frames; i++) {
+        // Copy audio data into the input vector for Aubio processing
+        data->in_vec->data[data->aubioFill++] = in[i];
+        if (data->aubioFill < hop) {
+            continue;
+        }
+        data->aubioFill = 0;
+
+        aubio_tempo_do(data->tempo, data->in_vec, data->tempo_out);
+        if (aubio_tempo_get_last(data->tempo) != 0) {
+            float bpm = aubio_tempo_get_bpm(data->tempo);
+            data->bpm_sum += bpm;
+            data->bpm_count++;
+        }
     }
     //cout << data->bpm_sum << " - " << data->bpm_count;
+    if (data->bpm_count == 0) { // No beat tracked yet this session, avoid 0/0
+        return data->current_bpm;
+    }
     return data->bpm_sum/data->bpm_count;
 }
 
@@ -35,33 +48,144 @@ int audioAnalyzer::checkErr(PaError err){
 
 //I haven't managed to pass this as a callback function
 // PortAudio stream callback function. Will be called after every
-// `FRAMES_PER_BUFFER` audio samples PortAudio captures. Used to process the
+// buffer of audio samples PortAudio captures. Used to process the
 // resulting audio sample.
 int streamCallback(
     const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer,
     const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags,
     void* userData
 ) {
-    streamCallbackData* self = static_cast<streamCallbackData*>(userData);
-    // Cast our input buffer to a float pointer (since our sample format is `paFloat32`)
-    float* in = (float*)inputBuffer;
-
     // We will not be modifying the output buffer. This line is a no-op.
     (void)outputBuffer;
     streamCallbackData* callbackData = (streamCallbackData*)userData;
-    // Set our spectrogram size in the terminal to 100 characters, and move the
-    // cursor to the beginning of the line
+    if (!callbackData->placed) {
+        // PortAudio creates the thread, so this is the first chance to place it
+        callbackData->placed = true;
+        if (callbackData->placement != NULL) {
+            callbackData->placement->apply(THREAD_AUDIO);
+        }
+    }
+    callbackData->jitter->tick();
+    // Cast our input buffer to a float pointer (since our sample format is `paFloat32`)
+    captureBuffer(callbackData, (const float*)inputBuffer, framesPerBuffer);
+    return 0;
+}
+
+// Fraction of a band's energy the separation put in the percussive part
+static float percussiveShare(const hpssResult* separation, int band){
+    return separation->percussive[band] / (separation->percussive[band] + separation->harmonic[band] + 1e-12f);
+}
+
+// Deinterleaves the input and returns the mono signal the main analysis
+// runs on: the input itself for one channel, mid for two, the mean otherwise
+static const float* splitChannels(streamCallbackData* data, const float* in, unsigned long frames){
+    int channels = data->channels;
+    if (channels == 1) {
+        return in;
+    }
+    deinterleave(in, channels, (int)frames, data->channelData);
+    midSide(data->channelData[0], data->channelData[1], data->mid, data->side, (int)frames);
+    if (channels == 2) {
+        return data->mid;
+    }
+    mixDown(data->channelData, channels, data->mono, (int)frames);
+    return data->mono;
+}
+
+// Per-channel and mid/side meters. Mono input just mirrors the main results.
+static void analyzeChannels(streamCallbackData* data, unsigned long frames,
+                            const transientResult* transients, const loudnessResult* loudness, featureFrame* frame){
+    frame->channels = data->channels;
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+        frame->channelLoudness[c] = LOUDNESS_SILENCE;
+        frame->channelRms[c] = 0.0f;
+        frame->channelPeak[c] = 0.0f;
+        frame->channelLowBeat[c] = false;
+        frame->channelHighBeat[c] = false;
+    }
+    if (data->channels == 1) {
+        frame->channelLoudness[0] = loudness->momentary;
+        frame->channelRms[0] = loudness->rms;
+        frame->channelPeak[0] = loudness->peak;
+        frame->channelLowBeat[0] = transients->transient[BAND_LOW];
+        frame->channelHighBeat[0] = transients->transient[BAND_HIGH];
+        frame->midLoudness = loudness->momentary;
+        frame->sideLoudness = LOUDNESS_SILENCE;
+        frame->stereoWidth = 0.0f;
+        frame->correlation = 1.0f;
+        return;
+    }
+
+    for (int c = 0; c < data->channels; c++) {
+        loudnessResult level;
+        transientResult hits;
+        data->channelLoudness[c]->process(data->channelData[c], frames, &level);
+        data->channelTransients[c]->process(data->channelData[c], frames, &hits);
+        frame->channelLoudness[c] = level.momentary;
+        frame->channelRms[c] = level.rms;
+        frame->channelPeak[c] = level.peak;
+        frame->channelLowBeat[c] = hits.transient[BAND_LOW];
+        frame->channelHighBeat[c] = hits.transient[BAND_HIGH];
+    }
+
+    loudnessResult mid, side;
+    data->midLoudness->process(data->mid, frames, &mid);
+    data->sideLoudness->process(data->side, frames, &side);
+    frame->midLoudness = mid.momentary;
+    frame->sideLoudness = side.momentary;
+    frame->stereoWidth = mid.rms > 1e-6f ? side.rms / mid.rms : (side.rms > 1e-6f ? 1.0f : 0.0f);
+
+    const float* left = data->channelData[0];
+    const float* right = data->channelData[1];
+    float lr = dotProduct(left, right, (int)frames);
+    float ll = dotProduct(left, left, (int)frames);
+    float rr = dotProduct(right, right, (int)frames);
+    frame->correlation = ll * rr > 1e-12f ? lr / std::sqrt(ll * rr) : 1.0f;
+}
+
+void analyzeBuffer(streamCallbackData* callbackData, const float* in, unsigned long framesPerBuffer){
+    const float* interleaved = in;
+    in = splitChannels(callbackData, interleaved, framesPerBuffer);
+
+    // Time-domain path: knows where in the buffer a kick started without
+    // waiting for the FFT
+    transientResult transients;
+    callbackData->transients->process(in, framesPerBuffer, &transients);
+    loudnessResult loudness;
+    callbackData->loudness->process(in, framesPerBuffer, &loudness);
+
+    // Resolution of the log-spaced spectrum the loudest frequency is picked from
     int dispSize = 100;
-    printf("\r");
 
-    // Copy audio sample to FFTW's input buffer
-    for (unsigned long i = 0; i < framesPerBuffer; i++) {
-        callbackData->in[i] = in[i * NUM_CHANNELS];
+    // Slide the FFT window along by one hop and copy the new samples in
+    int window = callbackData->window;
+    int hop = (int)framesPerBuffer;
+    if (window > hop) {
+        memmove(callbackData->in, callbackData->in + hop, sizeof(double) * (window - hop));
     }
+    widenToDouble(in, callbackData->in + window - hop, hop);
     // Perform FFT on callbackData->in (results will be stored in callbackData->out)
     fftw_execute(callbackData->p);
     // cout << callbackData->p << endl;
 
+    // Beats come from the percussive part of the spectrum only, so a held
+    // bass note no longer reads as a kick. A time-domain transient counts
+    // too, but only while its band is percussive rather than tonal.
+    hpssResult separation;
+    callbackData->hpss->process(callbackData->out, &separation);
+    bool lowBeat = separation.onset[BAND_LOW] || (transients.transient[BAND_LOW] && percussiveShare(&separation, BAND_LOW) >= HPSS_ONSET_SHARE);
+    bool highBeat = separation.onset[BAND_HIGH] || (transients.transient[BAND_HIGH] && percussiveShare(&separation, BAND_HIGH) >= HPSS_ONSET_SHARE);
+    if (lowBeat) {
+        callbackData->lowBeat->store(true);
+    }
+    if (highBeat) {
+        callbackData->highBeat->store(true);
+    }
+
+    bassFeatures bass;
+    callbackData->bass->process(in, framesPerBuffer, &bass);
+    callbackData->tones->process(in, framesPerBuffer);
+
     // Draw the spectrogram
     for (int i = 0; i < dispSize; i++) {
         // Sample frequency data logarithmically
@@ -71,42 +195,222 @@ int streamCallback(
             
         callbackData->freq = freq;
 
+        // Peak tracking only; beats come from the percussive onsets above
         if (freq > 15.0 && i < 10) {// VERY meh implementation
-            callbackData->lowBeat = true;
             if(callbackData->maxLowBeat < freq){
                 callbackData->maxLowBeat = freq;
             }
-            cout << "LOW BEAT DETECTED - " << i << endl;
             break;
             // printf("-%f - %f/n",proportion, freq);
         }else if (freq > 25.0 && i > 80) {
-            callbackData->highBeat = true;
             if(callbackData->maxHighBeat < freq){
                 callbackData->maxHighBeat = freq;
             }
-            cout << "HIGH BEAT DETECTED - " << i << endl;
             break;
         } 
     }
 
     // Display the buffered changes to stdout in the terminal
     // fflush(stdout);
-    callbackData->current_bpm = bpmDetection(callbackData, inputBuffer);
-    return 0;
+    callbackData->current_bpm = bpmDetection(callbackData, in, framesPerBuffer);
+
+    featureFrame frame;
+    frame.frameIndex = ++callbackData->frameIndex;
+    frame.source = callbackData->source;
+    frame.bpm = callbackData->current_bpm;
+    frame.freq = callbackData->freq;
+    frame.lowBeat = callbackData->lowBeat->load();
+    frame.highBeat = callbackData->highBeat->load();
+    frame.lowBeatDetected = lowBeat;
+    frame.highBeatDetected = highBeat;
+    frame.maxLowBeat = callbackData->maxLowBeat;
+    frame.maxHighBeat = callbackData->maxHighBeat;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        frame.bandEnvelope[b] = transients.envelope[b];
+        frame.transientOffset[b] = transients.transientOffset[b];
+    }
+    frame.subBass = bass.subBass;
+    frame.bass = bass.bass;
+    frame.bassPeakHz = bass.peakHz;
+    sdftFrame tones = callbackData->tones->latest();
+    frame.toneCount = tones.count;
+    static_assert(sizeof(frame.toneMagnitude) == sizeof(sdftFrame::magnitude), "featureFrame tone bins out of step with slidingDft");
+    memcpy(frame.toneMagnitude, tones.magnitude, sizeof(frame.toneMagnitude));
+    memset(frame.noteEnergy, 0, sizeof(frame.noteEnergy));
+    callbackData->cq->process(callbackData->out, frame.chroma, frame.noteEnergy);
+    frame.lowestNote = callbackData->cq->lowestNote();
+    frame.noteCount = callbackData->cq->noteCount();
+    for (int b = 0; b < NUM_BANDS; b++) {
+        frame.harmonic[b] = separation.harmonic[b];
+        frame.percussive[b] = separation.percussive[b];
+        frame.percussiveOnset[b] = separation.onset[b];
+    }
+    frame.loudnessMomentary = loudness.momentary;
+    frame.loudnessShortTerm = loudness.shortTerm;
+    frame.rms = loudness.rms;
+    frame.peak = loudness.peak;
+    frame.crestFactor = loudness.crestFactor;
+    frame.energy = loudness.energy;
+
+    analyzeChannels(callbackData, framesPerBuffer, &transients, &loudness, &frame);
+
+    featureNormalizer* norm = callbackData->normalizer;
+    frame.normalized[NORM_FREQ] = norm->update(NORM_FREQ, frame.freq);
+    frame.normalized[NORM_SUB_BASS] = norm->update(NORM_SUB_BASS, frame.subBass);
+    frame.normalized[NORM_BASS] = norm->update(NORM_BASS, frame.bass);
+    frame.normalized[NORM_RMS] = norm->update(NORM_RMS, frame.rms);
+    frame.normalized[NORM_LOUDNESS] = norm->update(NORM_LOUDNESS, frame.loudnessMomentary);
+    for (int b = 0; b < NUM_BANDS; b++) {
+        // Amplitudes rather than energies, which are too heavy-tailed to spread well
+        frame.normalized[NORM_PERCUSSIVE_LOW + b] = norm->update(NORM_PERCUSSIVE_LOW + b, std::sqrt(frame.percussive[b]));
+        frame.normalized[NORM_HARMONIC_LOW + b] = norm->update(NORM_HARMONIC_LOW + b, std::sqrt(frame.harmonic[b]));
+    }
+    callbackData->bus->publish(frame);
+    if (callbackData->shared != NULL) {
+        callbackData->shared->publish(frame);
+    }
+}
+
+void captureBuffer(streamCallbackData* callbackData, const float* in, unsigned long frames){
+    resampler* converter = callbackData->converter;
+    unsigned long hop = callbackData->hop;
+    if (converter == NULL && callbackData->stagedFrames == 0 && frames == hop) {
+        // The usual case: the device delivers exactly one hop
+        analyzeBuffer(callbackData, in, frames);
+        return;
+    }
+    int channels = callbackData->channels;
+    while (frames > 0) {
+        float* end = callbackData->staged + callbackData->stagedFrames * channels;
+        unsigned long chunk;
+        if (converter != NULL) {
+            chunk = std::min(frames, (unsigned long)converter->maxInput());
+            callbackData->stagedFrames += converter->process(in, (int)chunk, end);
+        } else {
+            chunk = std::min(frames, hop);
+            memcpy(end, in, sizeof(float) * chunk * channels);
+            callbackData->stagedFrames += chunk;
+        }
+        in += chunk * channels;
+        frames -= chunk;
+
+        while (callbackData->stagedFrames >= hop) {
+            analyzeBuffer(callbackData, callbackData->staged, hop);
+            callbackData->stagedFrames -= hop;
+            memmove(callbackData->staged, callbackData->staged + hop * channels,
+                    sizeof(float) * callbackData->stagedFrames * channels);
+        }
+    }
 }
 
 audioAnalyzer::audioAnalyzer(){
+    this->spectroData = NULL;
+    this->lowBeatLatch.store(false);
+    this->highBeatLatch.store(false);
+    this->channels = NUM_CHANNELS;
+    this->source = 0;
+    this->inputRate = 0.0;
+    this->resampleQuality = RESAMPLE_MEDIUM;
+    this->hop = FRAMES_PER_BUFFER;
+    this->window = FFT_SIZE;
+    this->placement = NULL;
+    this->shared = NULL;
+    this->callbackJitter = new threadJitter();
+    // Lives across sessions so its bin configuration survives the re-init loop
+    this->tones = new slidingDft(SAMPLE_RATE);
+    // Same for the constant-Q kernel, which is also too costly to rebuild per session
+    this->cqBinsPerOctave = CQT_BINS_PER_OCTAVE;
+    this->cqMinHz = CQT_MIN_HZ;
+    this->cqMaxHz = CQT_MAX_HZ;
+    this->cq = new constantQ(SAMPLE_RATE, this->window);
+    // And the learned feature ranges, so a new session does not start from scratch
+    this->normalizer = new featureNormalizer(NORM_COUNT, SAMPLE_RATE / this->hop);
+    this->normalizer->setMinSpan(NORM_FREQ, 1.0f);
+    this->normalizer->setMinSpan(NORM_SUB_BASS, 0.01f);
+    this->normalizer->setMinSpan(NORM_BASS, 0.01f);
+    this->normalizer->setMinSpan(NORM_RMS, 0.01f);
+    this->normalizer->setMinSpan(NORM_LOUDNESS, 6.0f); // dB
+    for (int b = 0; b < NUM_BANDS; b++) {
+        this->normalizer->setMinSpan(NORM_PERCUSSIVE_LOW + b, 0.01f);
+        this->normalizer->setMinSpan(NORM_HARMONIC_LOW + b, 0.01f);
+    }
 
+    // Safe values for anyone reading before the first buffer is analysed
+    featureFrame initial;
+    memset(&initial, 0, sizeof(featureFrame));
+    initial.bpm = 120.0;
+    initial.maxLowBeat = 1.0;
+    initial.maxHighBeat = 1.0;
+    initial.loudnessMomentary = LOUDNESS_SILENCE;
+    initial.loudnessShortTerm = LOUDNESS_SILENCE;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        initial.transientOffset[b] = -1;
+    }
+    this->bus.publish(initial);
 }
 
 int audioAnalyzer::init(){
-     // Initialize PortAudio
-        // Initialize Aubio structures
+    if (!this->initAnalysis()) {
+        return 0;
+    }
+
+     // Initialize PortAudio (shared with any other analyzer or deviceManager)
+    if (!portAudioAcquire()) {
+        return 0;
+    }
+
+    // Get and display the number of audio devices accessible to PortAudio
+    int numDevices = Pa_GetDeviceCount();
+    printf("Number of devices: %d\n", numDevices);
+
+    if (numDevices < 0) {
+        printf("Error getting device count.\n");
+        portAudioRelease();
+        return 0;
+    } else if (numDevices == 0) {
+        printf("There are no available audio devices on this machine.\n");
+        portAudioRelease();
+        return 0;
+    }
+
+    // Display audio device information for each device accessible to PortAudio
+    const PaDeviceInfo* deviceInfo;
+    for (int i = 0; i < numDevices; i++) {
+        deviceInfo = Pa_GetDeviceInfo(i);
+        printf("Device %d:\n", i);
+        printf("  name: %s\n", deviceInfo->name);
+        printf("  maxInputChannels: %d\n", deviceInfo->maxInputChannels);
+        printf("  maxOutputChannels: %d\n", deviceInfo->maxOutputChannels);
+        printf("  defaultSampleRate: %f\n", deviceInfo->defaultSampleRate);
+    }
+    portAudioRelease();
+    return 1;
+}
+
+// 32-byte aligned so the AVX kernels never split a cache line per load
+static float* alignedBuffer(unsigned long frames){
+    void* buffer = NULL;
+    if (posix_memalign(&buffer, 32, sizeof(float) * frames) != 0) {
+        return NULL;
+    }
+    memset(buffer, 0, sizeof(float) * frames);
+    return (float*)buffer;
+}
+
+// Everything init() sets up except PortAudio, so the analysis can also be
+// driven without an audio device through process(). Any earlier session is
+// released first; on failure nothing is left allocated.
+int audioAnalyzer::initAnalysis(){
+    this->endSession();
+    // Initialize Aubio structures
     uint_t win_s = 1024; // Window size
     uint_t hop_s = 512;  // Hop size
-    // streamCallbackData analysisData;
-    spectroData = (streamCallbackData*)malloc(sizeof(streamCallbackData));
-
+    // Zeroed, so endSession() can release a partly built session
+    spectroData = (streamCallbackData*)calloc(1, sizeof(streamCallbackData));
+    if (spectroData == NULL) {
+        printf("Could not allocate spectro data\n");
+        return 0;
+    }
 
     spectroData->tempo = new_aubio_tempo("default", win_s, hop_s, SAMPLE_RATE);
     spectroData->pitch = new_aubio_pitch("default", win_s, hop_s, SAMPLE_RATE);
@@ -118,76 +422,171 @@ int audioAnalyzer::init(){
     spectroData->tempo_out = new_fvec(1);
     spectroData->pitch_out = new_fvec(1);
     spectroData->filterbank_out = new_fvec(aubio_filterbank_get_power(spectroData->filterbank));
+    spectroData->aubioFill = 0;
     spectroData->bpm_sum = 0.0;
     spectroData->bpm_count = 0;
     spectroData->brightness_sum = 0.0;
     spectroData->brightness_count = 0;
     spectroData->current_bpm = 120.0;
     spectroData->freq = 0.0f;
-    spectroData->lowBeat = false;
-    spectroData->highBeat = false;
-    PaError err;
-    err = Pa_Initialize();
-    checkErr(err);
+    spectroData->lowBeat = &this->lowBeatLatch;
+    spectroData->highBeat = &this->highBeatLatch;
+    spectroData->maxLowBeat = 1.0;
+    spectroData->maxHighBeat = 1.0;
+    spectroData->transients = new transientDetector(SAMPLE_RATE);
+    spectroData->bass = new bassAnalyzer(SAMPLE_RATE);
+    spectroData->hpss = new harmonicPercussive(SAMPLE_RATE, this->window, this->hop);
+    spectroData->loudness = new loudnessMeter(SAMPLE_RATE);
+    spectroData->tones = this->tones;
+    spectroData->cq = this->cq;
+    spectroData->normalizer = this->normalizer;
+
+    spectroData->channels = this->channels;
+    spectroData->source = this->source;
+    spectroData->mono = spectroData->mid = spectroData->side = NULL;
+    spectroData->midLoudness = spectroData->sideLoudness = NULL;
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+        spectroData->channelData[c] = NULL;
+        spectroData->channelTransients[c] = NULL;
+        spectroData->channelLoudness[c] = NULL;
+    }
+    if (this->channels > 1) {
+        for (int c = 0; c < this->channels; c++) {
+            spectroData->channelData[c] = alignedBuffer(this->hop);
+            spectroData->channelTransients[c] = new transientDetector(SAMPLE_RATE);
+            spectroData->channelLoudness[c] = new loudnessMeter(SAMPLE_RATE);
+        }
+        spectroData->mono = alignedBuffer(this->hop);
+        spectroData->mid = alignedBuffer(this->hop);
+        spectroData->side = alignedBuffer(this->hop);
+        spectroData->midLoudness = new loudnessMeter(SAMPLE_RATE);
+        spectroData->sideLoudness = new loudnessMeter(SAMPLE_RATE);
+        bool allocated = spectroData->mono != NULL && spectroData->mid != NULL && spectroData->side != NULL;
+        for (int c = 0; c < this->channels; c++) {
+            allocated = allocated && spectroData->channelData[c] != NULL;
+        }
+        if (!allocated) {
+            printf("Could not allocate the channel buffers\n");
+            this->endSession();
+            return 0;
+        }
+    }
+    spectroData->hop = this->hop;
+    spectroData->window = this->window;
+    spectroData->placement = this->placement;
+    spectroData->placed = false;
+    spectroData->jitter = this->callbackJitter;
+    spectroData->converter = NULL;
+    spectroData->staged = NULL;
+    spectroData->stagedFrames = 0;
+    spectroData->bus = &this->bus;
+    spectroData->shared = this->shared;
+    spectroData->frameIndex = this->bus.published();
 
     // Allocate and define the callback data used to calculate/display the spectrogram
-    this->spectroData->in = (double*)malloc(sizeof(double) * FRAMES_PER_BUFFER);
-    this->spectroData->out = (double*)malloc(sizeof(double) * FRAMES_PER_BUFFER);
+    this->spectroData->in = (double*)malloc(sizeof(double) * this->window);
+    this->spectroData->out = (double*)malloc(sizeof(double) * this->window);
     if (this->spectroData->in == NULL || this->spectroData->out == NULL) {
         printf("Could not allocate spectro data\n");
+        this->endSession();
         return 0;
     }
+    memset(this->spectroData->in, 0, sizeof(double) * this->window);
 
     this->spectroData->p = fftw_plan_r2r_1d(
-        FRAMES_PER_BUFFER, this->spectroData->in, this->spectroData->out,
+        this->window, this->spectroData->in, this->spectroData->out,
         FFTW_R2HC, FFTW_ESTIMATE
     );
-    double sampleRatio = FRAMES_PER_BUFFER / SAMPLE_RATE;
+    double sampleRatio = this->window / SAMPLE_RATE;
     this->spectroData->startIndex = std::ceil(sampleRatio * SPECTRO_FREQ_START);
     this->spectroData->spectroSize = min(
         std::ceil(sampleRatio * SPECTRO_FREQ_END),
-        FRAMES_PER_BUFFER / 2.0
+        this->window / 2.0
     ) - this->spectroData->startIndex;
 
-    // Get and display the number of audio devices accessible to PortAudio
-    int numDevices = Pa_GetDeviceCount();
-    printf("Number of devices: %d\n", numDevices);
+    // A fixed capture rate can be set up now; the device's own rate is only
+    // known once startSession() looks at the device
+    if (!this->prepareInput(this->inputRate > 0.0 ? this->inputRate : SAMPLE_RATE)) {
+        this->endSession();
+        return 0;
+    }
+    return 1;
+}
 
-    if (numDevices < 0) {
-        printf("Error getting device count.\n");
+// Sets up conversion from `rate` to SAMPLE_RATE for the current session,
+// replacing any earlier one. Call after initAnalysis() and before any audio
+// arrives; a rate of SAMPLE_RATE analyses the input as it comes.
+int audioAnalyzer::prepareInput(double rate){
+    if (this->spectroData == NULL) {
         return 0;
-    } else if (numDevices == 0) {
-        printf("There are no available audio devices on this machine.\n");
+    }
+    if (rate < MIN_INPUT_RATE || rate > MAX_INPUT_RATE) {
+        printf("Capture rate %.0f Hz is outside %.0f - %.0f Hz\n", rate, MIN_INPUT_RATE, MAX_INPUT_RATE);
         return 0;
     }
-
-    // Display audio device information for each device accessible to PortAudio
-    const PaDeviceInfo* deviceInfo;
-    for (int i = 0; i < numDevices; i++) {
-        deviceInfo = Pa_GetDeviceInfo(i);
-        printf("Device %d:\n", i);
-        printf("  name: %s\n", deviceInfo->name);
-        printf("  maxInputChannels: %d\n", deviceInfo->maxInputChannels);
-        printf("  maxOutputChannels: %d\n", deviceInfo->maxOutputChannels);
-        printf("  defaultSampleRate: %f\n", deviceInfo->defaultSampleRate);
+    delete this->spectroData->converter;
+    free(this->spectroData->staged);
+    this->spectroData->converter = NULL;
+    this->spectroData->staged = NULL;
+    this->spectroData->stagedFrames = 0;
+
+    // Staging holds less than a hop between calls, plus whatever one call
+    // adds: up to a hop copied through, or one converted device buffer
+    size_t capacity = 2 * this->hop;
+    resampler* converter = NULL;
+    if (std::fabs(rate - SAMPLE_RATE) >= 0.5) {
+        int maxInput = std::max(this->hop, (int)std::ceil(this->hop * rate / SAMPLE_RATE));
+        converter = new resampler(rate, SAMPLE_RATE, this->channels, maxInput, this->resampleQuality);
+        capacity = this->hop + converter->maxOutput(maxInput);
+    }
+    this->spectroData->staged = (float*)malloc(sizeof(float) * capacity * this->channels);
+    if (this->spectroData->staged == NULL) {
+        printf("Could not allocate the capture staging buffer\n");
+        delete converter;
+        return 0;
     }
+    this->spectroData->converter = converter;
     return 1;
 }
 
 int audioAnalyzer::startSession(int seconds, int device){
-    PaError err = Pa_Initialize();
+    if (!portAudioAcquire()) {
+        this->endSession();
+        return 0;
+    }
+    PaError err;
 
     // Use device 0 (for a programmatic solution for choosing a device,
     // `numDevices - 1` is typically the 'default' device
 
+    const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(device);
+    if (deviceInfo == NULL || deviceInfo->maxInputChannels < this->channels) {
+        printf("Device %d cannot capture %d channels\n", device, this->channels);
+        portAudioRelease();
+        this->endSession();
+        return 0;
+    }
+
+    // Capture at the device's own rate unless told otherwise, so PortAudio
+    // never resamples behind our back, and convert to SAMPLE_RATE ourselves
+    double rate = this->inputRate > 0.0 ? this->inputRate : deviceInfo->defaultSampleRate;
+    if (!this->prepareInput(rate)) {
+        portAudioRelease();
+        this->endSession();
+        return 0;
+    }
+    // About one hop's worth of time per callback
+    unsigned long framesPerBuffer = (unsigned long)std::lround(this->hop * rate / SAMPLE_RATE);
+    this->callbackJitter->setPeriod(framesPerBuffer / rate);
+
     // Define stream capture specifications
     PaStreamParameters inputParameters;
     memset(&inputParameters, 0, sizeof(inputParameters));
-    inputParameters.channelCount = NUM_CHANNELS;
+    inputParameters.channelCount = this->channels;
     inputParameters.device = device;
     inputParameters.hostApiSpecificStreamInfo = NULL;
     inputParameters.sampleFormat = paFloat32;
-    inputParameters.suggestedLatency = Pa_GetDeviceInfo(device)->defaultLowInputLatency;
+    inputParameters.suggestedLatency = deviceInfo->defaultLowInputLatency;
 
     // Open the PortAudio stream
     PaStream* stream;
@@ -195,8 +594,8 @@ int audioAnalyzer::startSession(int seconds, int device){
         &stream,
         &inputParameters,
         NULL,
-        SAMPLE_RATE,
-        FRAMES_PER_BUFFER,
+        rate,
+        framesPerBuffer,
         paNoFlag,
         streamCallback,
         this->spectroData
@@ -218,16 +617,106 @@ int audioAnalyzer::startSession(int seconds, int device){
     err = Pa_CloseStream(stream);
     checkErr(err);
 
-    // Terminate PortAudio
-    err = Pa_Terminate();
-    checkErr(err);
-    fftw_destroy_plan(this->spectroData->p);
-    fftw_free(this->spectroData->in);
-    fftw_free(this->spectroData->out);
-    free(this->spectroData);
+    // Terminate PortAudio (once nobody else is using it)
+    portAudioRelease();
+    this->endSession();
     return 1;
 }
 
+// Like startSession(), but the audio comes from `input`, paced to the wall
+// clock by the pipe, and is analysed on the calling thread. Returns 0 once
+// the pipe's input has ended (or on error) and 1 otherwise, so a caller can
+// loop on sessions until the writer is done.
+int audioAnalyzer::startPipeSession(int seconds, pcmPipe* input){
+    if (input == NULL || !input->isOpen() || input->channels() != this->channels) {
+        printf("The pipe must be open and carry %d channels\n", this->channels);
+        this->endSession();
+        return 0;
+    }
+    double rate = input->rate();
+    if (!this->prepareInput(rate)) {
+        this->endSession();
+        return 0;
+    }
+    unsigned long framesPerBuffer = (unsigned long)std::lround(this->hop * rate / SAMPLE_RATE);
+    this->callbackJitter->setPeriod(framesPerBuffer / rate);
+    // This thread stands in for the PortAudio callback thread
+    if (this->placement != NULL) {
+        this->placement->apply(THREAD_AUDIO);
+    }
+    this->spectroData->placed = true;
+
+    std::vector<float> buffer(framesPerBuffer * this->channels);
+    unsigned long long remaining = (unsigned long long)(seconds * rate);
+    bool more = true;
+    while (remaining > 0) {
+        long frames = input->read(&buffer[0], (long)framesPerBuffer);
+        if (frames <= 0) {
+            more = false;
+            break;
+        }
+        this->callbackJitter->tick();
+        captureBuffer(this->spectroData, &buffer[0], frames);
+        remaining -= std::min<unsigned long long>(remaining, frames);
+    }
+    this->endSession();
+    return more ? 1 : 0;
+}
+
+// Feeds interleaved samples (channelCount() per frame, at the setInputRate()
+// rate) through the same path the PortAudio callback uses. Any number of
+// frames is accepted; each whole hop is analysed as it builds up. Requires
+// init() or initAnalysis() first.
+int audioAnalyzer::process(const float* samples, unsigned long frames){
+    if (this->spectroData == NULL) {
+        return 0;
+    }
+    captureBuffer(this->spectroData, samples, frames);
+    return 1;
+}
+
+// Releases everything initAnalysis() allocated, including a session it
+// only partly built
+void audioAnalyzer::endSession(){
+    if (this->spectroData == NULL) {
+        return;
+    }
+    if (this->spectroData->p != NULL) fftw_destroy_plan(this->spectroData->p);
+    free(this->spectroData->in);
+    free(this->spectroData->out);
+
+    // aubio's destructors do not take NULL
+    if (this->spectroData->tempo != NULL) del_aubio_tempo(this->spectroData->tempo);
+    if (this->spectroData->pitch != NULL) del_aubio_pitch(this->spectroData->pitch);
+    if (this->spectroData->filterbank != NULL) del_aubio_filterbank(this->spectroData->filterbank);
+    if (this->spectroData->onset != NULL) del_aubio_onset(this->spectroData->onset);
+    if (this->spectroData->pvoc != NULL) del_aubio_pvoc(this->spectroData->pvoc);
+    if (this->spectroData->in_vec != NULL) del_fvec(this->spectroData->in_vec);
+    if (this->spectroData->fftgrain != NULL) del_cvec(this->spectroData->fftgrain);
+    if (this->spectroData->tempo_out != NULL) del_fvec(this->spectroData->tempo_out);
+    if (this->spectroData->pitch_out != NULL) del_fvec(this->spectroData->pitch_out);
+    if (this->spectroData->filterbank_out != NULL) del_fvec(this->spectroData->filterbank_out);
+    delete this->spectroData->transients;
+    delete this->spectroData->bass;
+    delete this->spectroData->hpss;
+    delete this->spectroData->loudness;
+    for (int c = 0; c < MAX_CHANNELS; c++) {
+        free(this->spectroData->channelData[c]);
+        delete this->spectroData->channelTransients[c];
+        delete this->spectroData->channelLoudness[c];
+    }
+    free(this->spectroData->mono);
+    free(this->spectroData->mid);
+    free(this->spectroData->side);
+    delete this->spectroData->midLoudness;
+    delete this->spectroData->sideLoudness;
+    delete this->spectroData->converter;
+    free(this->spectroData->staged);
+
+    free(this->spectroData);
+    this->spectroData = NULL;
+}
+
 
 // Returns the lowest of the two given numbers
 inline float audioAnalyzer::min(float a, float b) {
@@ -235,30 +724,154 @@ inline float audioAnalyzer::min(float a, float b) {
 }
 
 float audioAnalyzer::getCurrentBPM(){
-    return this->spectroData->current_bpm;
+    return this->bus.latest().bpm;
 }
 float audioAnalyzer::getCurrentFrequency(){
-    return this->spectroData->freq;
+    return this->bus.latest().freq;
 }
 bool audioAnalyzer::lowBeat(){
-    return this->spectroData->lowBeat;
+    return this->lowBeatLatch.load();
 }
 bool audioAnalyzer::highBeat(){
-    return this->spectroData->highBeat;
+    return this->highBeatLatch.load();
 }
 
 float audioAnalyzer::maxLowBeat(){
-    return this->spectroData->maxLowBeat;
+    return this->bus.latest().maxLowBeat;
 }
 float audioAnalyzer::maxHighBeat(){
-    return this->spectroData->maxHighBeat;
+    return this->bus.latest().maxHighBeat;
+}
+
+featureFrame audioAnalyzer::getFeatures(){
+    return this->bus.latest();
+}
+
+// Interleaved channels to capture (and to expect in process()). Only allowed
+// between sessions. Returns 0 if a session is open or the count is unsupported.
+int audioAnalyzer::setChannels(int channels){
+    if (this->spectroData != NULL) {
+        printf("Channel count can only be changed between sessions\n");
+        return 0;
+    }
+    if (channels < 1 || channels > MAX_CHANNELS) {
+        printf("Unsupported channel count %d (1-%d)\n", channels, MAX_CHANNELS);
+        return 0;
+    }
+    this->channels = channels;
+    return 1;
+}
+
+int audioAnalyzer::channelCount(){
+    return this->channels;
+}
+
+// Sets the hop (new samples per analysed buffer, so the feature rate and
+// latency) and the FFT window, which is the last `window` samples and may
+// overlap the previous hop. Smaller hops react faster, longer windows
+// resolve low notes better. Only allowed between sessions; rebuilds the
+// constant-Q kernel for the new window.
+int audioAnalyzer::setGeometry(int hop, int window){
+    if (this->spectroData != NULL) {
+        printf("Hop and window can only be changed between sessions\n");
+        return 0;
+    }
+    if (hop < MIN_HOP || window < hop || window > MAX_WINDOW) {
+        printf("Unsupported hop %d / window %d (%d <= hop <= window <= %d)\n", hop, window, MIN_HOP, MAX_WINDOW);
+        return 0;
+    }
+    if (window != this->window) {
+        delete this->cq;
+        this->cq = new constantQ(SAMPLE_RATE, window, this->cqBinsPerOctave, this->cqMinHz, this->cqMaxHz);
+    }
+    this->hop = hop;
+    this->window = window;
+    this->normalizer->setUpdateRate(SAMPLE_RATE / hop);
+    return 1;
+}
+
+int audioAnalyzer::hopSize(){
+    return this->hop;
+}
+
+int audioAnalyzer::windowSize(){
+    return this->window;
+}
+
+// Identifies this analyzer's frames when several feed one renderer
+// (see deviceManager). Takes effect from the next session.
+void audioAnalyzer::setSource(int source){
+    this->source = source;
+}
+
+// Scheduling for the PortAudio callback thread (THREAD_AUDIO), from the next
+// session. The placement must outlive the analyzer's sessions.
+void audioAnalyzer::setPlacement(threadPlacement* placement){
+    this->placement = placement;
+}
+
+// Also publish every frame to other processes (see featureShm.h), from the
+// next session. NULL stops it; the publisher must outlive the sessions.
+void audioAnalyzer::setSharedBus(featureShmPublisher* shared){
+    this->shared = shared;
+}
+
+// How regularly the callback has been woken since the last call
+jitterStats audioAnalyzer::audioJitter(){
+    jitterStats stats = this->callbackJitter->stats();
+    this->callbackJitter->reset();
+    return stats;
+}
+
+// Rate the input is captured at. 0 (the default) uses whatever the device
+// runs at natively. Takes effect from the next session.
+int audioAnalyzer::setInputRate(double rate){
+    if (rate != 0.0 && (rate < MIN_INPUT_RATE || rate > MAX_INPUT_RATE)) {
+        printf("Capture rate %.0f Hz is outside %.0f - %.0f Hz\n", rate, MIN_INPUT_RATE, MAX_INPUT_RATE);
+        return 0;
+    }
+    this->inputRate = rate;
+    return 1;
+}
+
+// The setInputRate() value, 0 for the device's native rate
+double audioAnalyzer::getInputRate(){
+    return this->inputRate;
+}
+
+// RESAMPLE_FAST, RESAMPLE_MEDIUM or RESAMPLE_BEST, from the next session
+void audioAnalyzer::setResampleQuality(int quality){
+    this->resampleQuality = quality;
+}
+
+// Configure bins / control rate, or read the ~1 kHz frame stream
+slidingDft* audioAnalyzer::toneBank(){
+    return this->tones;
+}
+
+// Rebuilds the constant-Q kernel. Only allowed between sessions, since the
+// audio thread reads the kernel without locking. Returns 0 if a session is open.
+int audioAnalyzer::setConstantQ(int binsPerOctave, double minHz, double maxHz){
+    if (this->spectroData != NULL) {
+        printf("Constant-Q can only be reconfigured between sessions\n");
+        return 0;
+    }
+    if (minHz <= 0.0 || maxHz <= minHz) {
+        printf("Invalid constant-Q range %f - %f Hz\n", minHz, maxHz);
+        return 0;
+    }
+    delete this->cq;
+    this->cq = new constantQ(SAMPLE_RATE, this->window, binsPerOctave, minHz, maxHz);
+    this->cqBinsPerOctave = binsPerOctave;
+    this->cqMinHz = minHz;
+    this->cqMaxHz = maxHz;
+    return 1;
 }
 
 
 void audioAnalyzer::setLowBeat(bool){
-    this->spectroData->lowBeat = false;
+    this->lowBeatLatch.store(false);
 }
 void audioAnalyzer::setHighBeat(bool){
-    this->spectroData->highBeat = false;
+    this->highBeatLatch.store(false);
 }
-
@@ -10,12 +10,30 @@
 #include <fftw3.h>     // FFTW:      Provides a discrete FFT algorithm to get
 #include <aubio/aubio.h>
 #include <vector>
+#include <atomic>
+#include "featureBus.h"
+#include "transientDetector.h"
+#include "bassAnalyzer.h"
+#include "slidingDft.h"
+#include "constantQ.h"
+#include "harmonicPercussive.h"
+#include "loudnessMeter.h"
+#include "featureNormalizer.h"
+#include "resampler.h"
+#include "threadPlacement.h"
+#include "featureShmPublisher.h"
+#include "pcmPipe.h"
 
                        //            frequency data from captured audio
 
-#define SAMPLE_RATE 44100.0   // How many audio samples to capture every second (44100 Hz is standard)
-#define FRAMES_PER_BUFFER 1024 // How many audio samples to send to our callback function for each channel
-#define NUM_CHANNELS 1        // Number of audio channels to capture
+#define SAMPLE_RATE 44100.0   // Rate the analysis runs at; other capture rates are converted to it
+#define MIN_INPUT_RATE 8000.0   // Lowest capture rate setInputRate() accepts (Hz)
+#define MAX_INPUT_RATE 384000.0 // Highest
+#define FRAMES_PER_BUFFER 1024 // Default hop: new samples per analysed buffer, per channel (see setGeometry)
+#define FFT_SIZE 1024          // Default analysis window, the FFT length; at least the hop
+#define MIN_HOP 64             // Smallest hop setGeometry() accepts
+#define MAX_WINDOW 8192        // Largest window setGeometry() accepts
+#define NUM_CHANNELS 1        // Default number of audio channels to capture (see setChannels)
 
 #define SPECTRO_FREQ_START 20  // Lower bound of the displayed spectrogram (Hz)
 #define SPECTRO_FREQ_END 20000 // Upper bound of the displayed spectrogram (Hz)
@@ -24,6 +42,8 @@ using namespace std;
 #define DETAIL 100
 
 typedef struct {
+    int hop;         // Samples per analysed buffer
+    int window;      // FFT length; the last `window` samples, overlapping when longer than the hop
     double* in;      // Input buffer, will contain our audio sample
     double* out;     // Output buffer, FFTW will write to this based on the input buffer's contents
     fftw_plan p;     // Created by FFTW to facilitate FFT calculation
@@ -40,6 +60,7 @@ typedef struct {
     fvec_t *tempo_out;
     fvec_t *pitch_out;
     fvec_t *filterbank_out;
+    unsigned int aubioFill;  // Samples already in in_vec towards aubio's next hop
 
     float bpm_sum;
     int bpm_count;
@@ -50,18 +71,80 @@ typedef struct {
 
     float current_bpm = 120.0;
     double freq = 1.0f;
-    bool lowBeat = false;
-    bool highBeat = false;
+    std::atomic<bool>* lowBeat;     // Set on a beat, cleared by the renderer; owned by audioAnalyzer
+    std::atomic<bool>* highBeat;
     float maxLowBeat = 1.0;
     float maxHighBeat = 1.0;
 
+    transientDetector* transients;  // Per-sample crossover and transient detection
+    bassAnalyzer* bass;             // Decimated small-FFT bass analysis
+    slidingDft* tones;              // Selected bins at control rate, owned by audioAnalyzer
+    harmonicPercussive* hpss;       // Median-filter harmonic/percussive separation
+    loudnessMeter* loudness;        // K-weighted loudness, RMS, peak, crest factor
+    featureNormalizer* normalizer;  // Adaptive ranges for the published features, owned by audioAnalyzer
+
+    // Multichannel input. Everything above runs on a mono mix; each channel
+    // and the front pair's mid/side only get the per-sample meters.
+    int channels;                                   // Interleaved samples per frame
+    float* channelData[MAX_CHANNELS];               // Deinterleaved input, NULL when mono
+    float* mono;                                    // Mix of more than two channels
+    float* mid;
+    float* side;
+    transientDetector* channelTransients[MAX_CHANNELS];
+    loudnessMeter* channelLoudness[MAX_CHANNELS];
+    loudnessMeter* midLoudness;
+    loudnessMeter* sideLoudness;
+    // Capture at another rate than SAMPLE_RATE, or in buffers that are not
+    // one hop long. Input (converted if need be) collects in `staged` until
+    // there is a whole hop to analyse.
+    resampler* converter;           // NULL when the input already runs at SAMPLE_RATE
+    float* staged;                  // Interleaved, channels per frame
+    unsigned long stagedFrames;
+    constantQ* cq;                  // Chroma and note energies from the FFT frame, owned by audioAnalyzer
+    threadPlacement* placement;     // Applied to the callback thread on its first buffer, may be NULL
+    bool placed;
+    threadJitter* jitter;           // Callback wakeups against the buffer period, owned by audioAnalyzer
+    featureBus* bus;                // Where every analysed buffer is published
+    featureShmPublisher* shared;    // And, if not NULL, to other processes
+    int source;                     // Stamped on every published frame
+    unsigned long long frameIndex;  // Buffers analysed so far, carried across sessions
+
 } streamCallbackData;
 
+// Runs the full analysis on one hop of interleaved samples (callbackData->channels
+// per frame) and publishes the result.
+// Used by the PortAudio callback and by offline drivers such as the soak test.
+void analyzeBuffer(streamCallbackData*, const float*, unsigned long);
+
+// Takes any number of interleaved frames at the capture rate, converts them
+// to SAMPLE_RATE if needed and analyses every whole hop that results.
+void captureBuffer(streamCallbackData*, const float*, unsigned long);
+
 
 class audioAnalyzer{
     private:
         streamCallbackData* spectroData;
         int device;
+        // Beat latches outlive the session data, which the analysis thread
+        // frees and reallocates while the render thread polls them
+        std::atomic<bool> lowBeatLatch;
+        std::atomic<bool> highBeatLatch;
+        featureBus bus;
+        slidingDft* tones;
+        constantQ* cq;
+        int cqBinsPerOctave;  // Kept to rebuild the kernel when the window changes
+        double cqMinHz;
+        double cqMaxHz;
+        featureNormalizer* normalizer;
+        int hop;
+        int window;
+        int channels;
+        threadPlacement* placement;
+        featureShmPublisher* shared;
+        threadJitter* callbackJitter;
+        int source;
+        double inputRate;     // 0 captures at the device's own rate
+        int resampleQuality;
         // float bpmDetection(streamCallbackData*, const void*);
         int checkErr(PaError);
         inline float min(float, float);
@@ -71,7 +154,11 @@ class audioAnalyzer{
         audioAnalyzer();
         ~audioAnalyzer();
         int init();
+        int initAnalysis();
         int startSession(int, int device=7);
+        int startPipeSession(int, pcmPipe*);
+        int process(const float*, unsigned long);
+        void endSession();
 
         void setLowBeat(bool);
         void setHighBeat(bool);
@@ -82,6 +169,22 @@ class audioAnalyzer{
         bool highBeat();
         float maxLowBeat();
         float maxHighBeat();
+        featureFrame getFeatures();
+        slidingDft* toneBank();
+        int setConstantQ(int binsPerOctave, double minHz, double maxHz);
+        int setChannels(int);
+        int channelCount();
+        int setGeometry(int hop, int window);
+        int hopSize();
+        int windowSize();
+        void setSource(int);
+        void setPlacement(threadPlacement*);
+        void setSharedBus(featureShmPublisher*);
+        jitterStats audioJitter();
+        int setInputRate(double);
+        void setResampleQuality(int);
+        int prepareInput(double rate);
+        double getInputRate();
 
 
 
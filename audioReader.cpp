@@ -0,0 +1,258 @@
+#include "audioReader.h"
+#include "portAudioSession.h"
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <cstring>
+#include <algorithm>
+
+audioReader::audioReader(){
+    this->stream = NULL;
+    this->channelCount = 0;
+    this->sampleRate = 0.0;
+    this->converter = NULL;
+    this->ring = NULL;
+    this->running.store(false);
+    this->lost.store(0);
+    sem_init(&this->ready, 0, 0);
+}
+
+audioReader::~audioReader(){
+    this->close();
+    delete this->converter;
+    delete this->ring;
+    sem_destroy(&this->ready);
+}
+
+// PortAudio callback: convert if needed, queue whole frames, wake the reader
+int audioReader::callback(
+    const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer,
+    const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags,
+    void* userData
+) {
+    (void)outputBuffer;
+    (void)timeInfo;
+    (void)statusFlags;
+    audioReader* reader = (audioReader*)userData;
+    const float* in = (const float*)inputBuffer;
+    int channels = reader->channelCount;
+    if (in == NULL) {
+        reader->lost.fetch_add(framesPerBuffer, std::memory_order_relaxed);
+        return paContinue;
+    }
+
+    unsigned long done = 0;
+    while (done < framesPerBuffer) {
+        const float* samples = in + done * channels;
+        long frames = framesPerBuffer - done;
+        if (reader->converter != NULL) {
+            frames = std::min<long>(frames, reader->converter->maxInput());
+            done += frames;
+            frames = reader->converter->process(samples, (int)frames, &reader->converted[0]);
+            samples = &reader->converted[0];
+        } else {
+            done = framesPerBuffer;
+        }
+        // Whole frames only, so the ring never splits one across channels
+        long room = (long)((reader->ring->capacity() - reader->ring->size()) / channels);
+        long queued = std::min(frames, room);
+        reader->ring->write(samples, (size_t)queued * channels);
+        if (queued < frames) {
+            reader->lost.fetch_add(frames - queued, std::memory_order_relaxed);
+        }
+    }
+    sem_post(&reader->ready);
+    return paContinue;
+}
+
+// Opens `device` (-1 for the default input) and starts capturing. The ring
+// holds bufferSeconds of audio. Returns 1 on success.
+int audioReader::open(int device, int channels, double rate, double bufferSeconds){
+    if (this->isOpen()) {
+        printf("Reader is already open\n");
+        return 0;
+    }
+    if (channels < 1 || rate <= 0.0 || bufferSeconds <= 0.0) {
+        printf("Invalid reader format: %d channels at %.0f Hz, %.2f s buffered\n", channels, rate, bufferSeconds);
+        return 0;
+    }
+    if (!portAudioAcquire()) {
+        return 0;
+    }
+    if (device < 0) {
+        device = Pa_GetDefaultInputDevice();
+    }
+    const PaDeviceInfo* deviceInfo = device == paNoDevice ? NULL : Pa_GetDeviceInfo(device);
+    if (deviceInfo == NULL || deviceInfo->maxInputChannels < channels) {
+        printf("Device %d cannot capture %d channels\n", device, channels);
+        portAudioRelease();
+        return 0;
+    }
+
+    PaStreamParameters inputParameters;
+    memset(&inputParameters, 0, sizeof(inputParameters));
+    inputParameters.channelCount = channels;
+    inputParameters.device = device;
+    inputParameters.hostApiSpecificStreamInfo = NULL;
+    inputParameters.sampleFormat = paFloat32;
+    inputParameters.suggestedLatency = deviceInfo->defaultLowInputLatency;
+
+    // Capture at the rate asked for if the device does it, else natively and convert
+    double deviceRate = rate;
+    if (Pa_IsFormatSupported(&inputParameters, NULL, rate) != paFormatIsSupported) {
+        deviceRate = deviceInfo->defaultSampleRate;
+    }
+    delete this->converter;
+    this->converter = NULL;
+    if (deviceRate != rate) {
+        this->converter = new resampler(deviceRate, rate, channels, READER_FRAMES_PER_BUFFER);
+        this->converted.resize((size_t)this->converter->maxOutput(READER_FRAMES_PER_BUFFER) * channels);
+    }
+    delete this->ring;
+    this->ring = new spscRing<float>((size_t)(rate * bufferSeconds) * channels);
+    this->channelCount = channels;
+    this->sampleRate = rate;
+    this->lost.store(0);
+    while (sem_trywait(&this->ready) == 0) {
+    }
+
+    PaError err = Pa_OpenStream(&this->stream, &inputParameters, NULL, deviceRate,
+                                READER_FRAMES_PER_BUFFER, paNoFlag, audioReader::callback, this);
+    if (err == paNoError) {
+        err = Pa_StartStream(this->stream);
+    }
+    if (err != paNoError) {
+        printf("PortAudio error on device %d: %s\n", device, Pa_GetErrorText(err));
+        if (this->stream != NULL) {
+            Pa_CloseStream(this->stream);
+            this->stream = NULL;
+        }
+        portAudioRelease();
+        return 0;
+    }
+    this->running.store(true);
+    return 1;
+}
+
+// Stops capture and wakes a blocked reader. Queued audio stays readable
+// until the next open().
+void audioReader::close(){
+    if (!this->running.exchange(false)) {
+        return;
+    }
+    Pa_StopStream(this->stream);
+    Pa_CloseStream(this->stream);
+    this->stream = NULL;
+    portAudioRelease();
+    sem_post(&this->ready);
+}
+
+bool audioReader::isOpen(){
+    return this->running.load();
+}
+
+// Waits for the callback to queue more audio. Returns 0 once the deadline
+// (NULL for none) passes or the reader is closed.
+int audioReader::waitForData(const struct timespec* deadline){
+    while (this->running.load()) {
+        int result = deadline == NULL ? sem_wait(&this->ready) : sem_timedwait(&this->ready, deadline);
+        if (result == 0) {
+            return 1;
+        }
+        if (errno != EINTR) {
+            return 0;
+        }
+    }
+    return 0;
+}
+
+static struct timespec deadlineAfter(double seconds){
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long ns = deadline.tv_nsec + (long long)(seconds * 1e9);
+    deadline.tv_sec += ns / 1000000000LL;
+    deadline.tv_nsec = ns % 1000000000LL;
+    return deadline;
+}
+
+// Fills `out` with `frames` interleaved frames, waiting for the device as
+// long as it takes or until timeoutSeconds. Returns the frames read, fewer
+// on timeout or close, -1 if the reader was never opened.
+long audioReader::read(float* out, long frames, double timeoutSeconds){
+    if (this->ring == NULL) {
+        return -1;
+    }
+    struct timespec deadline = deadlineAfter(std::max(0.0, timeoutSeconds));
+    long done = 0;
+    while (true) {
+        done += this->tryRead(out + (size_t)done * this->channelCount, frames - done);
+        if (done == frames || !this->waitForData(timeoutSeconds < 0.0 ? NULL : &deadline)) {
+            break;
+        }
+    }
+    // The callback may have queued more just before the wait gave up
+    done += this->tryRead(out + (size_t)done * this->channelCount, frames - done);
+    return done;
+}
+
+// Whatever is queued, up to `frames`, without waiting
+long audioReader::tryRead(float* out, long frames){
+    if (this->ring == NULL) {
+        return -1;
+    }
+    long frameCount = std::min(frames, this->available());
+    if (frameCount <= 0) {
+        return 0;
+    }
+    this->ring->read(out, (size_t)frameCount * this->channelCount);
+    return frameCount;
+}
+
+// Waits until at least minFrames are queued (or the timeout), then takes
+// everything queued up to maxFrames in one go. For tools that process
+// audio in bulk and would rather not wake up for every callback.
+long audioReader::readBatch(float* out, long minFrames, long maxFrames, double timeoutSeconds){
+    if (this->ring == NULL) {
+        return -1;
+    }
+    minFrames = std::min(minFrames, std::min(maxFrames, (long)(this->ring->capacity() / this->channelCount)));
+    struct timespec deadline = deadlineAfter(std::max(0.0, timeoutSeconds));
+    while (this->available() < minFrames) {
+        if (!this->waitForData(timeoutSeconds < 0.0 ? NULL : &deadline)) {
+            break;
+        }
+    }
+    return this->tryRead(out, maxFrames);
+}
+
+// Frames queued and not read yet
+long audioReader::available(){
+    if (this->ring == NULL) {
+        return 0;
+    }
+    return (long)(this->ring->size() / this->channelCount);
+}
+
+// Drops everything queued so the next read starts with fresh audio.
+// Returns the frames dropped.
+long audioReader::discard(){
+    if (this->ring == NULL) {
+        return 0;
+    }
+    long frames = this->available();
+    this->ring->skip((size_t)frames * this->channelCount);
+    return frames;
+}
+
+int audioReader::channels(){
+    return this->channelCount;
+}
+
+double audioReader::rate(){
+    return this->sampleRate;
+}
+
+// Frames lost because the ring was full (the reader fell behind)
+unsigned long long audioReader::overruns(){
+    return this->lost.load(std::memory_order_relaxed);
+}
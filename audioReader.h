@@ -0,0 +1,64 @@
+#ifndef AUDIOREADER_H
+#define AUDIOREADER_H
+
+#include <atomic>
+#include <vector>
+#include <semaphore.h>
+#include <portaudio.h>
+#include "spscRing.h"
+#include "resampler.h"
+
+#define READER_FRAMES_PER_BUFFER 256  // Frames per PortAudio callback
+#define READER_BUFFER_SECONDS 4.0     // Audio held for a reader that falls behind
+#define READER_WAIT_FOREVER -1.0      // Timeout for read()/readBatch() that never gives up
+
+// Pull-mode capture for offline tools and experiments: one stream is opened
+// once and kept running, the callback copies every buffer into a lock-free
+// ring, and callers take samples out whenever they like instead of paying
+// Pa_Initialize and stream setup on every call.
+//
+//   audioReader reader;
+//   reader.open();                       // Default input, mono, 44.1 kHz
+//   float block[1024];
+//   reader.read(block, 1024, 0.5);       // Wait up to half a second
+//
+// Samples come out interleaved, at the rate asked for: a device that cannot
+// capture at that rate runs at its native rate and is converted. read() and
+// readBatch() must all be called from one thread at a time. A reader that
+// falls more than READER_BUFFER_SECONDS behind loses the newest audio; see
+// overruns(), and discard() to skip to the present. After close() whatever
+// was captured can still be read out.
+class audioReader{
+    private:
+        PaStream* stream;
+        int channelCount;
+        double sampleRate;
+        std::vector<float> converted; // Callback output of the resampler
+        resampler* converter;         // NULL when the device runs at sampleRate
+        spscRing<float>* ring;
+        sem_t ready;                  // Posted by the callback for every buffer queued
+        std::atomic<bool> running;
+        std::atomic<unsigned long long> lost;
+
+        static int callback(const void*, void*, unsigned long, const PaStreamCallbackTimeInfo*, PaStreamCallbackFlags, void*);
+        int waitForData(const struct timespec* deadline);
+    public:
+        audioReader();
+        ~audioReader();
+
+        int open(int device = -1, int channels = 1, double rate = 44100.0, double bufferSeconds = READER_BUFFER_SECONDS);
+        void close();
+        bool isOpen();
+
+        long read(float* out, long frames, double timeoutSeconds = READER_WAIT_FOREVER);
+        long tryRead(float* out, long frames);
+        long readBatch(float* out, long minFrames, long maxFrames, double timeoutSeconds = READER_WAIT_FOREVER);
+        long available();
+        long discard();
+
+        int channels();
+        double rate();
+        unsigned long long overruns();
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include "bassAnalyzer.h"
+#include <cmath>
+#include <cstring>
+
+bassAnalyzer::bassAnalyzer(double sampleRate) : front(sampleRate, BASS_DECIMATION){
+    this->frame.assign(BASS_FFT_SIZE, 0.0f);
+    this->magnitude.assign(BASS_FFT_SIZE / 2 + 1, 0.0);
+    this->window.resize(BASS_FFT_SIZE);
+    this->windowSum = 0.0;
+    for (int i = 0; i < BASS_FFT_SIZE; i++) {
+        this->window[i] = 0.5 - 0.5 * std::cos(2.0 * M_PI * i / BASS_FFT_SIZE); // Hann
+        this->windowSum += this->window[i];
+    }
+    this->in = (double*)fftw_malloc(sizeof(double) * BASS_FFT_SIZE);
+    this->out = (double*)fftw_malloc(sizeof(double) * BASS_FFT_SIZE);
+    this->plan = fftw_plan_r2r_1d(BASS_FFT_SIZE, this->in, this->out, FFTW_R2HC, FFTW_ESTIMATE);
+}
+
+bassAnalyzer::~bassAnalyzer(){
+    fftw_destroy_plan(this->plan);
+    fftw_free(this->in);
+    fftw_free(this->out);
+}
+
+double bassAnalyzer::binHz(){
+    return this->front.outputRate() / BASS_FFT_SIZE;
+}
+
+void bassAnalyzer::process(const float* samples, unsigned long frames, bassFeatures* result){
+    if (this->decimated.size() < frames / BASS_DECIMATION + 1) {
+        this->decimated.resize(frames / BASS_DECIMATION + 1);
+    }
+    int count = this->front.process(samples, (int)frames, &this->decimated[0]);
+
+    // Slide the new decimated samples into the analysis frame
+    if (count >= BASS_FFT_SIZE) {
+        memcpy(&this->frame[0], &this->decimated[count - BASS_FFT_SIZE], sizeof(float) * BASS_FFT_SIZE);
+    } else if (count > 0) {
+        memmove(&this->frame[0], &this->frame[count], sizeof(float) * (BASS_FFT_SIZE - count));
+        memcpy(&this->frame[BASS_FFT_SIZE - count], &this->decimated[0], sizeof(float) * count);
+    }
+
+    for (int i = 0; i < BASS_FFT_SIZE; i++) {
+        this->in[i] = this->frame[i] * this->window[i];
+    }
+    fftw_execute(this->plan);
+
+    // Half-complex output: out[k] is the real part, out[N - k] the imaginary part.
+    // Scaled so a full-scale sine centred on a bin reads as its amplitude.
+    double hz = this->binHz();
+    double scale = 2.0 / this->windowSum;
+    double sub = 0.0, bass = 0.0, peak = 0.0;
+    int peakBin = -1;
+    std::vector<double>& mag = this->magnitude;
+    for (int k = 1; k < BASS_FFT_SIZE / 2; k++) {
+        double re = this->out[k], im = this->out[BASS_FFT_SIZE - k];
+        double power = (re * re + im * im) * scale * scale;
+        mag[k] = std::sqrt(power);
+        double f = k * hz;
+        if (f >= BASS_SUB_LOW_HZ && f < BASS_SUB_HIGH_HZ) sub += power;
+        else if (f >= BASS_SUB_HIGH_HZ && f < BASS_HIGH_HZ) bass += power;
+        if (f >= BASS_PEAK_LOW_HZ && f <= BASS_PEAK_HIGH_HZ && mag[k] > peak) {
+            peak = mag[k];
+            peakBin = k;
+        }
+    }
+    result->subBass = std::sqrt(sub);
+    result->bass = std::sqrt(bass);
+    result->peakHz = 0.0f;
+
+    // Parabolic interpolation between the neighbouring bins
+    if (peakBin > 0 && peak > 1e-6) {
+        double a = mag[peakBin - 1], b = mag[peakBin], c = mag[peakBin + 1];
+        double denom = a - 2.0 * b + c;
+        double delta = denom != 0.0 ? 0.5 * (a - c) / denom : 0.0;
+        result->peakHz = (peakBin + delta) * hz;
+    }
+}
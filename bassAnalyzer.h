@@ -0,0 +1,45 @@
+#ifndef BASSANALYZER_H
+#define BASSANALYZER_H
+
+#include <vector>
+#include <fftw3.h>
+#include "decimator.h"
+
+#define BASS_DECIMATION 16  // 44.1 kHz -> 2756 Hz, still well above the 300 Hz we care about
+#define BASS_FFT_SIZE 256   // 10.8 Hz bins at the decimated rate (the main FFT has 43 Hz bins)
+
+#define BASS_SUB_LOW_HZ 20.0
+#define BASS_SUB_HIGH_HZ 60.0
+#define BASS_HIGH_HZ 250.0
+#define BASS_PEAK_LOW_HZ 30.0
+#define BASS_PEAK_HIGH_HZ 300.0
+
+typedef struct {
+    float subBass;  // Amplitude of 20-60 Hz content
+    float bass;     // Amplitude of 60-250 Hz content
+    float peakHz;   // Strongest frequency between 30 and 300 Hz (0 when silent)
+} bassFeatures;
+
+// Low-frequency analysis on a decimated copy of the signal: a small FFT at
+// 1/16 of the sample rate gives four times the bass resolution of the main
+// 1024 point FFT for a fraction of the work a longer full-rate FFT would need.
+class bassAnalyzer{
+    private:
+        decimator front;
+        std::vector<float> decimated;
+        std::vector<float> frame;   // Last BASS_FFT_SIZE decimated samples, oldest first
+        std::vector<double> window;
+        std::vector<double> magnitude;
+        double windowSum;
+        double* in;
+        double* out;
+        fftw_plan plan;
+    public:
+        bassAnalyzer(double sampleRate);
+        ~bassAnalyzer();
+
+        void process(const float*, unsigned long, bassFeatures*);
+        double binHz();
+};
+
+#endif
@@ -0,0 +1,42 @@
+#include "biquad.h"
+
+// Shared by all designs: w0 = 2*pi*f/fs, alpha = sin(w0)/(2q)
+static biquadCoeffs normalise(double b0, double b1, double b2, double a0, double a1, double a2){
+    biquadCoeffs c;
+    c.b0 = b0 / a0;
+    c.b1 = b1 / a0;
+    c.b2 = b2 / a0;
+    c.a1 = a1 / a0;
+    c.a2 = a2 / a0;
+    return c;
+}
+
+biquadCoeffs biquadLowpass(double sampleRate, double freq, double q){
+    double w0 = 2.0 * M_PI * freq / sampleRate;
+    double cw = std::cos(w0);
+    double alpha = std::sin(w0) / (2.0 * q);
+    return normalise((1.0 - cw) / 2.0, 1.0 - cw, (1.0 - cw) / 2.0,
+                     1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+
+biquadCoeffs biquadHighpass(double sampleRate, double freq, double q){
+    double w0 = 2.0 * M_PI * freq / sampleRate;
+    double cw = std::cos(w0);
+    double alpha = std::sin(w0) / (2.0 * q);
+    return normalise((1.0 + cw) / 2.0, -(1.0 + cw), (1.0 + cw) / 2.0,
+                     1.0 + alpha, -2.0 * cw, 1.0 - alpha);
+}
+
+biquadCoeffs biquadHighShelf(double sampleRate, double freq, double q, double gainDb){
+    double A = std::pow(10.0, gainDb / 40.0);
+    double w0 = 2.0 * M_PI * freq / sampleRate;
+    double cw = std::cos(w0);
+    double alpha = std::sin(w0) / (2.0 * q);
+    double sqA = 2.0 * std::sqrt(A) * alpha;
+    return normalise(A * ((A + 1.0) + (A - 1.0) * cw + sqA),
+                     -2.0 * A * ((A - 1.0) + (A + 1.0) * cw),
+                     A * ((A + 1.0) + (A - 1.0) * cw - sqA),
+                     (A + 1.0) - (A - 1.0) * cw + sqA,
+                     2.0 * ((A - 1.0) - (A + 1.0) * cw),
+                     (A + 1.0) - (A - 1.0) * cw - sqA);
+}
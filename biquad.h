@@ -0,0 +1,112 @@
+#ifndef BIQUAD_H
+#define BIQUAD_H
+
+#include <cmath>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h> // SSE: process four filters per instruction
+#endif
+
+// Normalised biquad coefficients (a0 == 1)
+typedef struct {
+    float b0, b1, b2;
+    float a1, a2;
+} biquadCoeffs;
+
+// RBJ cookbook designs. q = 0.7071 gives a Butterworth response; two in
+// series give a Linkwitz-Riley crossover.
+biquadCoeffs biquadLowpass(double sampleRate, double freq, double q);
+biquadCoeffs biquadHighpass(double sampleRate, double freq, double q);
+biquadCoeffs biquadHighShelf(double sampleRate, double freq, double q, double gainDb);
+
+// Four independent biquads advanced one sample at a time, one per SIMD lane.
+// Transposed direct form II. Kept in the header so the per-sample call
+// inlines into the caller's loop.
+class biquad4{
+    public:
+        alignas(16) float b0[4];
+        alignas(16) float b1[4];
+        alignas(16) float b2[4];
+        alignas(16) float a1[4];
+        alignas(16) float a2[4];
+        alignas(16) float z1[4];
+        alignas(16) float z2[4];
+
+        biquad4(){
+            // Every lane starts as a pass-through
+            biquadCoeffs identity = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+            for (int i = 0; i < 4; i++) {
+                setLane(i, identity);
+            }
+            reset();
+        }
+
+        void setLane(int lane, const biquadCoeffs& c){
+            b0[lane] = c.b0;
+            b1[lane] = c.b1;
+            b2[lane] = c.b2;
+            a1[lane] = c.a1;
+            a2[lane] = c.a2;
+        }
+
+        void reset(){
+            memset(z1, 0, sizeof(z1));
+            memset(z2, 0, sizeof(z2));
+        }
+
+#if defined(__SSE2__)
+        inline __m128 process(__m128 x){
+            __m128 s1 = _mm_load_ps(z1);
+            __m128 s2 = _mm_load_ps(z2);
+            __m128 y = _mm_add_ps(_mm_mul_ps(_mm_load_ps(b0), x), s1);
+            s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(_mm_load_ps(b1), x), _mm_mul_ps(_mm_load_ps(a1), y)), s2);
+            s2 = _mm_sub_ps(_mm_mul_ps(_mm_load_ps(b2), x), _mm_mul_ps(_mm_load_ps(a2), y));
+            _mm_store_ps(z1, s1);
+            _mm_store_ps(z2, s2);
+            return y;
+        }
+
+        // Coefficients and state held in registers for the length of a block.
+        // The per-sample process() above goes through memory every call,
+        // since its stores may alias the caller's input; a block loop loads
+        // once, steps these, and stores the state back at the end.
+        struct lanes{
+            __m128 b0, b1, b2, a1, a2, z1, z2;
+
+            inline __m128 process(__m128 x){
+                __m128 y = _mm_add_ps(_mm_mul_ps(b0, x), z1);
+                z1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(b1, x), _mm_mul_ps(a1, y)), z2);
+                z2 = _mm_sub_ps(_mm_mul_ps(b2, x), _mm_mul_ps(a2, y));
+                return y;
+            }
+        };
+
+        inline lanes load() const{
+            lanes l;
+            l.b0 = _mm_load_ps(b0);
+            l.b1 = _mm_load_ps(b1);
+            l.b2 = _mm_load_ps(b2);
+            l.a1 = _mm_load_ps(a1);
+            l.a2 = _mm_load_ps(a2);
+            l.z1 = _mm_load_ps(z1);
+            l.z2 = _mm_load_ps(z2);
+            return l;
+        }
+
+        inline void store(const lanes& l){
+            _mm_store_ps(z1, l.z1);
+            _mm_store_ps(z2, l.z2);
+        }
+#endif
+
+        // Portable version of the above, for targets without SSE
+        inline void process(const float* x, float* y){
+            for (int i = 0; i < 4; i++) {
+                y[i] = b0[i] * x[i] + z1[i];
+                z1[i] = b1[i] * x[i] - a1[i] * y[i] + z2[i];
+                z2[i] = b2[i] * x[i] - a2[i] * y[i];
+            }
+        }
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "constantQ.h"
+#include "simdKernels.h"
+#include <fftw3.h>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+constantQ::constantQ(double sampleRate, int fftSize, int binsPerOctave, double minHz, double maxHz){
+    this->fftSize = fftSize;
+    // Chroma folding needs whole semitones per bin group
+    this->binsPerOctave = std::max(12, (binsPerOctave + 6) / 12 * 12);
+    this->minHz = minHz;
+    maxHz = std::min(maxHz, sampleRate / 2.0 * 0.95);
+    this->bins = std::max(1, (int)std::floor(this->binsPerOctave * std::log2(maxHz / minHz)) + 1);
+
+    this->firstNote = (int)std::lround(69.0 + 12.0 * std::log2(minHz / 440.0));
+    this->pitchClass.resize(this->bins);
+    this->noteIndex.resize(this->bins);
+    this->notes = 0;
+    for (int k = 0; k < this->bins; k++) {
+        double hz = minHz * std::pow(2.0, (double)k / this->binsPerOctave);
+        int midi = (int)std::lround(69.0 + 12.0 * std::log2(hz / 440.0));
+        this->pitchClass[k] = ((midi % 12) + 12) % 12;
+        this->noteIndex[k] = std::min(midi - this->firstNote, CQT_MAX_NOTES - 1);
+        this->notes = std::max(this->notes, this->noteIndex[k] + 1);
+    }
+
+    this->spectrumRe.assign(fftSize / 2 + 1, 0.0f);
+    this->spectrumIm.assign(fftSize / 2 + 1, 0.0f);
+    this->cqRe.assign(this->bins, 0.0f);
+    this->cqIm.assign(this->bins, 0.0f);
+    this->buildKernel(sampleRate);
+}
+
+// Temporal kernel k: Hann-windowed complex exponential at the bin frequency,
+// as long as Q periods (capped at the FFT size) and aligned to the end of the
+// frame so it looks at the newest samples. Its FFT, thresholded, becomes row k.
+void constantQ::buildKernel(double sampleRate){
+    int n = this->fftSize;
+    double q = 1.0 / (std::pow(2.0, 1.0 / this->binsPerOctave) - 1.0);
+    double* tempRe = (double*)fftw_malloc(sizeof(double) * n);
+    double* tempIm = (double*)fftw_malloc(sizeof(double) * n);
+    double* specRe = (double*)fftw_malloc(sizeof(double) * n);
+    double* specIm = (double*)fftw_malloc(sizeof(double) * n);
+    fftw_plan planRe = fftw_plan_r2r_1d(n, tempRe, specRe, FFTW_R2HC, FFTW_ESTIMATE);
+    fftw_plan planIm = fftw_plan_r2r_1d(n, tempIm, specIm, FFTW_R2HC, FFTW_ESTIMATE);
+
+    std::vector<double> rowRe(n / 2 + 1), rowIm(n / 2 + 1);
+    this->rowStart.assign(1, 0);
+    for (int k = 0; k < this->bins; k++) {
+        double hz = this->minHz * std::pow(2.0, (double)k / this->binsPerOctave);
+        int length = std::min(n, (int)std::ceil(q * sampleRate / hz));
+        int offset = n - length;
+
+        memset(tempRe, 0, sizeof(double) * n);
+        memset(tempIm, 0, sizeof(double) * n);
+        double windowSum = 0.0;
+        for (int i = 0; i < length; i++) {
+            windowSum += 0.5 - 0.5 * std::cos(2.0 * M_PI * (i + 0.5) / length);
+        }
+        for (int i = 0; i < length; i++) {
+            double w = (0.5 - 0.5 * std::cos(2.0 * M_PI * (i + 0.5) / length)) / windowSum;
+            double phase = 2.0 * M_PI * hz * (offset + i) / sampleRate;
+            tempRe[offset + i] = w * std::cos(phase);
+            tempIm[offset + i] = w * std::sin(phase);
+        }
+        fftw_execute(planRe);
+        fftw_execute(planIm);
+
+        // FFT(re + i*im) = FFT(re) + i*FFT(im), each unpacked from half-complex.
+        // Scaled by 2 (process() scales the spectrum by 1/N) so a sine
+        // centred on the bin reads as its amplitude.
+        double peak = 0.0;
+        for (int j = 0; j <= n / 2; j++) {
+            double ar = specRe[j], ai = (j > 0 && j < n / 2) ? specRe[n - j] : 0.0;
+            double br = specIm[j], bi = (j > 0 && j < n / 2) ? specIm[n - j] : 0.0;
+            rowRe[j] = (ar - bi) * 2.0;
+            rowIm[j] = (ai + br) * 2.0;
+            peak = std::max(peak, std::hypot(rowRe[j], rowIm[j]));
+        }
+
+        int kept = 0;
+        for (int j = 0; j <= n / 2; j++) {
+            if (std::hypot(rowRe[j], rowIm[j]) >= CQT_KERNEL_THRESHOLD * peak) {
+                this->column.push_back(j);
+                this->kernelRe.push_back(rowRe[j]);
+                this->kernelIm.push_back(rowIm[j]);
+                kept++;
+            }
+        }
+        for (; kept % 8 != 0; kept++) { // Pad to whole AVX registers
+            this->column.push_back(0);
+            this->kernelRe.push_back(0.0f);
+            this->kernelIm.push_back(0.0f);
+        }
+        this->rowStart.push_back((int)this->column.size());
+    }
+
+    fftw_destroy_plan(planRe);
+    fftw_destroy_plan(planIm);
+    fftw_free(tempRe);
+    fftw_free(tempIm);
+    fftw_free(specRe);
+    fftw_free(specIm);
+}
+
+// halfComplex is an FFTW_R2HC frame of fftSize samples. chroma receives 12
+// values normalised so the strongest pitch class is 1; noteEnergy receives
+// noteCount() squared amplitudes, one per semitone from lowestNote().
+void constantQ::process(const double* halfComplex, float* chroma, float* noteEnergy){
+    int n = this->fftSize;
+    for (int j = 0; j <= n / 2; j++) {
+        this->spectrumRe[j] = halfComplex[j] / n;
+        this->spectrumIm[j] = (j > 0 && j < n / 2) ? halfComplex[n - j] / n : 0.0f;
+    }
+    sparseComplexMatVec(&this->rowStart[0], this->bins, &this->column[0], &this->kernelRe[0], &this->kernelIm[0],
+                        &this->spectrumRe[0], &this->spectrumIm[0], &this->cqRe[0], &this->cqIm[0]);
+
+    for (int c = 0; c < 12; c++) chroma[c] = 0.0f;
+    for (int i = 0; i < this->notes; i++) noteEnergy[i] = 0.0f;
+    for (int k = 0; k < this->bins; k++) {
+        float energy = this->cqRe[k] * this->cqRe[k] + this->cqIm[k] * this->cqIm[k];
+        chroma[this->pitchClass[k]] += energy;
+        noteEnergy[this->noteIndex[k]] += energy;
+    }
+    float strongest = *std::max_element(chroma, chroma + 12);
+    if (strongest > 1e-12f) {
+        for (int c = 0; c < 12; c++) chroma[c] /= strongest;
+    }
+}
+
+int constantQ::noteCount(){
+    return this->notes;
+}
+
+int constantQ::lowestNote(){
+    return this->firstNote;
+}
+
+// Stored (padded) kernel entries, i.e. complex multiply-adds per frame
+int constantQ::kernelSize(){
+    return (int)this->column.size();
+}
@@ -0,0 +1,53 @@
+#ifndef CONSTANTQ_H
+#define CONSTANTQ_H
+
+#include <vector>
+
+#define CQT_BINS_PER_OCTAVE 12  // Must be a multiple of 12 for the chroma folding
+#define CQT_MIN_HZ 130.81       // C3
+#define CQT_MAX_HZ 4186.01      // C8
+#define CQT_MAX_NOTES 96        // Eight octaves of semitones
+#define CQT_KERNEL_THRESHOLD 0.0054 // Spectral kernel entries below this (relative to the row peak) are dropped
+
+// Constant-Q transform computed from an existing FFT frame using a
+// precomputed sparse spectral kernel (Brown & Puckette). The temporal kernels
+// are transformed once at construction; each frame then costs one sparse
+// complex matrix-vector product over the FFT bins, roughly one extra FFT.
+//
+// Kernels longer than the FFT are truncated to it, so with the analyzer's
+// 1024 point frame the lowest octaves get less than their nominal Q.
+class constantQ{
+    private:
+        int fftSize;
+        int binsPerOctave;
+        int bins;
+        double minHz;
+        int firstNote;         // MIDI note of the lowest bin
+
+        // CSR sparse kernel, rows padded to multiples of 8
+        std::vector<int> rowStart;
+        std::vector<int> column;
+        std::vector<float> kernelRe;
+        std::vector<float> kernelIm;
+
+        std::vector<int> pitchClass; // 0 = C
+        std::vector<int> noteIndex;  // Semitones above firstNote
+        int notes;
+
+        std::vector<float> spectrumRe; // FFT frame unpacked to complex
+        std::vector<float> spectrumIm;
+        std::vector<float> cqRe;
+        std::vector<float> cqIm;
+
+        void buildKernel(double sampleRate);
+    public:
+        constantQ(double sampleRate, int fftSize,
+                  int binsPerOctave = CQT_BINS_PER_OCTAVE, double minHz = CQT_MIN_HZ, double maxHz = CQT_MAX_HZ);
+
+        void process(const double* halfComplex, float* chroma, float* noteEnergy);
+        int noteCount();
+        int lowestNote();
+        int kernelSize();
+};
+
+#endif
@@ -0,0 +1,151 @@
+#include "decimator.h"
+#include "simdKernels.h"
+#include <cmath>
+#include <algorithm>
+
+#define DECIMATOR_STOPBAND_DB 80.0 // Alias rejection of every stage
+#define DECIMATOR_PASSBAND 0.35    // Flat up to this fraction of the final sample rate
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double besselI0(double x){
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum) break;
+    }
+    return sum;
+}
+
+firDecimator::firDecimator(int factor, int taps, double cutoff){
+    this->factor = factor;
+    this->taps = taps;
+    this->coeffs.resize(taps);
+
+    // Kaiser windowed sinc, normalised to unity DC gain
+    double beta = 0.1102 * (DECIMATOR_STOPBAND_DB - 8.7);
+    double centre = (taps - 1) / 2.0;
+    double sum = 0.0;
+    for (int i = 0; i < taps; i++) {
+        double t = i - centre;
+        double sinc = t == 0.0 ? 2.0 * cutoff : std::sin(2.0 * M_PI * cutoff * t) / (M_PI * t);
+        double r = t / centre;
+        double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+        this->coeffs[taps - 1 - i] = sinc * window;
+        sum += sinc * window;
+    }
+    for (int i = 0; i < taps; i++) {
+        this->coeffs[i] /= sum;
+    }
+    this->history.resize(2 * taps);
+    this->reset();
+}
+
+void firDecimator::reset(){
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    this->pos = 0;
+    this->phase = 0;
+}
+
+// Returns how many output samples were written
+int firDecimator::process(const float* in, int n, float* out){
+    int written = 0;
+    for (int i = 0; i < n; i++) {
+        this->history[this->pos] = in[i];
+        this->history[this->pos + this->taps] = in[i];
+        this->pos = this->pos + 1 == this->taps ? 0 : this->pos + 1;
+        if (++this->phase == this->factor) {
+            this->phase = 0;
+            out[written++] = dotProduct(&this->history[this->pos], &this->coeffs[0], this->taps);
+        }
+    }
+    return written;
+}
+
+int firDecimator::getTaps(){
+    return this->taps;
+}
+
+int firDecimator::getFactor(){
+    return this->factor;
+}
+
+decimator::decimator(double sampleRate, int factor){
+    this->inputRate = sampleRate;
+    this->totalFactor = factor;
+
+    double finalRate = sampleRate / factor;
+    double passband = DECIMATOR_PASSBAND * finalRate;
+    double rate = sampleRate;
+    int remaining = factor;
+    while (remaining > 1) {
+        int stageFactor = remaining % 4 == 0 ? 4 : 2;
+        if (remaining % stageFactor != 0) {
+            stageFactor = remaining; // Odd leftover, take it in one go
+        }
+        double outRate = rate / stageFactor;
+
+        // Everything that would fold back onto [0, passband] must be gone,
+        // so the transition runs from the passband to outRate - passband
+        double transition = (outRate - 2.0 * passband) / rate;
+        int taps = (int)std::ceil((DECIMATOR_STOPBAND_DB - 8.0) / (2.285 * 2.0 * M_PI * transition)) + 1;
+        taps = (taps + 7) & ~7; // Whole SIMD registers
+        this->stages.push_back(new firDecimator(stageFactor, taps, 0.5 / stageFactor));
+
+        rate = outRate;
+        remaining /= stageFactor;
+    }
+}
+
+decimator::~decimator(){
+    for (size_t i = 0; i < this->stages.size(); i++) {
+        delete this->stages[i];
+    }
+}
+
+void decimator::reset(){
+    for (size_t i = 0; i < this->stages.size(); i++) {
+        this->stages[i]->reset();
+    }
+}
+
+// `out` must hold at least n / factor() + 1 samples. Returns how many were written.
+int decimator::process(const float* in, int n, float* out){
+    if (this->stages.empty()) {
+        std::copy(in, in + n, out);
+        return n;
+    }
+    if ((int)this->scratchA.size() < n) {
+        this->scratchA.resize(n);
+        this->scratchB.resize(n);
+    }
+    const float* src = in;
+    int count = n;
+    for (size_t i = 0; i < this->stages.size(); i++) {
+        bool last = i + 1 == this->stages.size();
+        float* dst = last ? out : (i % 2 == 0 ? &this->scratchA[0] : &this->scratchB[0]);
+        count = this->stages[i]->process(src, count, dst);
+        src = dst;
+    }
+    return count;
+}
+
+double decimator::outputRate(){
+    return this->inputRate / this->totalFactor;
+}
+
+int decimator::factor(){
+    return this->totalFactor;
+}
+
+// Cost of the whole cascade in multiply-adds per full-rate input sample
+int decimator::macsPerInputSample(){
+    double macs = 0.0;
+    int decimatedSoFar = 1;
+    for (size_t i = 0; i < this->stages.size(); i++) {
+        // Stage i produces one output for every decimatedSoFar * factor inputs
+        decimatedSoFar *= this->stages[i]->getFactor();
+        macs += (double)this->stages[i]->getTaps() / decimatedSoFar;
+    }
+    return (int)std::ceil(macs);
+}
@@ -0,0 +1,47 @@
+#ifndef DECIMATOR_H
+#define DECIMATOR_H
+
+#include <vector>
+
+// One decimation stage: low-pass FIR that only evaluates every factor-th
+// output (the polyphase form of filter-then-discard). The history is written
+// twice so the newest `taps` samples are always contiguous and the dot
+// product can use the SIMD kernel directly.
+class firDecimator{
+    private:
+        int factor;
+        int taps;
+        std::vector<float> coeffs;  // Time-reversed impulse response
+        std::vector<float> history; // 2 * taps, every sample stored at pos and pos + taps
+        int pos;
+        int phase;
+    public:
+        firDecimator(int factor, int taps, double cutoff);
+
+        void reset();
+        int process(const float*, int, float*);
+        int getTaps();
+        int getFactor();
+};
+
+// Cascade of firDecimator stages (factors of 4, then 2) that takes the
+// full-rate signal down by 8, 16, ... for analysis that only needs bass.
+class decimator{
+    private:
+        std::vector<firDecimator*> stages;
+        std::vector<float> scratchA;
+        std::vector<float> scratchB;
+        int totalFactor;
+        double inputRate;
+    public:
+        decimator(double sampleRate, int factor);
+        ~decimator();
+
+        void reset();
+        int process(const float*, int, float*);
+        double outputRate();
+        int factor();
+        int macsPerInputSample();
+};
+
+#endif
@@ -0,0 +1,436 @@
+#include "deviceManager.h"
+#include "portAudioSession.h"
+#include "spscRing.h"
+#include "logger.h"
+#include <pthread.h>
+#include <semaphore.h>
+#include <algorithm>
+#include <thread>
+
+struct captureInput{
+    int device;
+    int channels;
+    int core;
+    std::atomic<float> weight;
+    audioAnalyzer* analyzer;
+    spscRing<captureBlock> ring;
+    sem_t ready;                   // Posted by the callback for every queued block
+    std::atomic<unsigned long> dropped;
+    PaStream* stream;
+    std::thread worker;
+    threadPlacement* placement;
+    bool placed;                   // Callback thread placed yet
+    threadJitter callbackJitter;   // Callback wakeups against the buffer period
+    threadJitter workerLatency;    // Block queued to worker running
+    unsigned long long lastMerged; // frameIndex of the analyzer's frame the last merge saw
+
+    captureInput() : ring(DEVICE_RING_BLOCKS) {}
+};
+
+// PortAudio callback: copy and hand off, nothing else. sem_post is safe to
+// call from the audio thread.
+static int captureCallback(
+    const void* inputBuffer, void* outputBuffer, unsigned long framesPerBuffer,
+    const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags,
+    void* userData
+) {
+    (void)outputBuffer;
+    (void)timeInfo;
+    (void)statusFlags;
+    captureInput* input = (captureInput*)userData;
+    if (!input->placed) {
+        input->placed = true;
+        if (input->placement != NULL) {
+            input->placement->apply(THREAD_AUDIO);
+        }
+    }
+    input->callbackJitter.tick();
+    captureBlock* block = input->ring.claim();
+    if (block == NULL || framesPerBuffer != FRAMES_PER_BUFFER) {
+        input->dropped++;
+        return paContinue;
+    }
+    size_t bytes = sizeof(float) * framesPerBuffer * input->channels;
+    if (inputBuffer != NULL) {
+        memcpy(block->samples, inputBuffer, bytes);
+    } else {
+        memset(block->samples, 0, bytes);
+    }
+    block->queuedNs = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    input->ring.commit();
+    sem_post(&input->ready);
+    return paContinue;
+}
+
+deviceManager::deviceManager(){
+    this->mergedFrames = 0;
+    this->following = 0;
+    this->policy.store(MERGE_LOUDEST);
+    this->deck.store(0);
+    this->running.store(false);
+    this->lowBeatLatch.store(false);
+    this->highBeatLatch.store(false);
+    this->placement = NULL;
+    this->shared = NULL;
+}
+
+deviceManager::~deviceManager(){
+    this->stop();
+    for (size_t i = 0; i < this->inputs.size(); i++) {
+        sem_destroy(&this->inputs[i]->ready);
+        delete this->inputs[i]->analyzer;
+        delete this->inputs[i];
+    }
+}
+
+// Registers a capture device before start(). core -1 spreads the workers
+// over cores 1, 2, ... and leaves core 0 to the renderer. Returns the new
+// input's source index, or -1 if it cannot be added.
+int deviceManager::addDevice(int device, int channels, float weight, int core){
+    if (this->running.load()) {
+        printf("Inputs can only be added while the device manager is stopped\n");
+        return -1;
+    }
+    if (this->inputs.size() >= MAX_INPUTS) {
+        printf("At most %d inputs are supported\n", MAX_INPUTS);
+        return -1;
+    }
+    captureInput* input = new captureInput();
+    input->analyzer = new audioAnalyzer();
+    if (!input->analyzer->setChannels(channels)) {
+        delete input->analyzer;
+        delete input;
+        return -1;
+    }
+    int source = (int)this->inputs.size();
+    input->analyzer->setSource(source);
+    input->device = device;
+    input->channels = channels;
+    input->weight.store(weight);
+    unsigned cores = std::max(1u, std::thread::hardware_concurrency());
+    input->core = core >= 0 ? core : (int)((source + 1) % cores);
+    input->dropped.store(0);
+    input->stream = NULL;
+    input->placement = NULL;
+    input->placed = false;
+    input->lastMerged = 0;
+    sem_init(&input->ready, 0, 0);
+    this->inputs.push_back(input);
+    return source;
+}
+
+int deviceManager::start(){
+    if (this->running.load()) {
+        return 1;
+    }
+    if (this->inputs.empty()) {
+        printf("No inputs to start\n");
+        return 0;
+    }
+    if (!portAudioAcquire()) {
+        return 0;
+    }
+    this->running.store(true);
+
+    for (size_t i = 0; i < this->inputs.size(); i++) {
+        captureInput* input = this->inputs[i];
+        const PaDeviceInfo* deviceInfo = Pa_GetDeviceInfo(input->device);
+        if (deviceInfo == NULL || deviceInfo->maxInputChannels < input->channels) {
+            printf("Device %d cannot capture %d channels\n", input->device, input->channels);
+            this->stop();
+            return 0;
+        }
+        // Native rate unless the input's analyzer was given one; the
+        // analyzer converts to SAMPLE_RATE itself
+        double rate = input->analyzer->getInputRate() > 0.0 ? input->analyzer->getInputRate() : deviceInfo->defaultSampleRate;
+        if (!input->analyzer->initAnalysis() || !input->analyzer->prepareInput(rate)) {
+            this->stop();
+            return 0;
+        }
+        input->placement = this->placement;
+        input->placed = false;
+        input->callbackJitter.setPeriod(FRAMES_PER_BUFFER / rate);
+        input->worker = std::thread(&deviceManager::work, this, input);
+
+        PaStreamParameters inputParameters;
+        memset(&inputParameters, 0, sizeof(inputParameters));
+        inputParameters.channelCount = input->channels;
+        inputParameters.device = input->device;
+        inputParameters.hostApiSpecificStreamInfo = NULL;
+        inputParameters.sampleFormat = paFloat32;
+        inputParameters.suggestedLatency = deviceInfo->defaultLowInputLatency;
+        PaError err = Pa_OpenStream(&input->stream, &inputParameters, NULL, rate,
+                                    FRAMES_PER_BUFFER, paNoFlag, captureCallback, input);
+        if (err == paNoError) {
+            err = Pa_StartStream(input->stream);
+        }
+        if (err != paNoError) {
+            printf("PortAudio error on device %d: %s\n", input->device, Pa_GetErrorText(err));
+            this->stop();
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Safe to call at any time, including part way through a failed start()
+void deviceManager::stop(){
+    if (!this->running.load()) {
+        return;
+    }
+    for (size_t i = 0; i < this->inputs.size(); i++) {
+        captureInput* input = this->inputs[i];
+        if (input->stream != NULL) {
+            Pa_StopStream(input->stream);
+            Pa_CloseStream(input->stream);
+            input->stream = NULL;
+        }
+    }
+    this->running.store(false);
+    for (size_t i = 0; i < this->inputs.size(); i++) {
+        captureInput* input = this->inputs[i];
+        if (input->worker.joinable()) {
+            sem_post(&input->ready);
+            input->worker.join();
+        }
+        while (input->ring.front() != NULL) {
+            input->ring.release();
+        }
+        while (sem_trywait(&input->ready) == 0) {
+        }
+        input->analyzer->endSession();
+    }
+    portAudioRelease();
+}
+
+// Analysis worker for one input, pinned to its core unless the placement
+// gives the analysis threads cores of their own
+void deviceManager::work(captureInput* input){
+    if (input->placement == NULL || input->placement->get(THREAD_ANALYSIS).cpus == 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(input->core, &cpus);
+        if (pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus) != 0) {
+            logWarn("Could not pin device %d's worker to core %d", input->device, input->core);
+        }
+    }
+    if (input->placement != NULL) {
+        input->placement->apply(THREAD_ANALYSIS);
+    }
+
+    while (this->running.load()) {
+        sem_wait(&input->ready);
+        captureBlock* block;
+        while ((block = input->ring.front()) != NULL) {
+            long long now = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+            input->workerLatency.record((now - block->queuedNs) / 1e9);
+            input->analyzer->process(block->samples, FRAMES_PER_BUFFER);
+            input->ring.release();
+            this->merge();
+        }
+    }
+}
+
+// Analyses one buffer of interleaved samples for input `source` on the
+// calling thread and merges, as the input's worker would. For offline
+// drivers such as the soak test: the manager must be stopped and the
+// input's analyzer given a session (analyzer(source)->initAnalysis()).
+int deviceManager::process(int source, const float* samples, unsigned long frames){
+    if (this->running.load() || source < 0 || source >= (int)this->inputs.size()) {
+        return 0;
+    }
+    int ok = this->inputs[source]->analyzer->process(samples, frames);
+    this->merge();
+    return ok;
+}
+
+// Beats and onsets are per buffer: only an input's frame that no merge has
+// seen yet may report them, or every other input's merge would repeat them
+static void clearBeats(featureFrame* frame){
+    frame->lowBeatDetected = false;
+    frame->highBeatDetected = false;
+    memset(frame->percussiveOnset, 0, sizeof(frame->percussiveOnset));
+}
+
+// Level-type features averaged across inputs in MERGE_WEIGHTED. Pitch, tempo
+// and loudness in LUFS do not average meaningfully and come from the loudest input.
+static void blendInto(float* out, const float* in, int count, float w, bool first){
+    for (int i = 0; i < count; i++) {
+        out[i] = first ? w * in[i] : out[i] + w * in[i];
+    }
+}
+
+void deviceManager::merge(){
+    std::lock_guard<std::mutex> guard(this->mergeLock);
+    int count = (int)this->inputs.size();
+    featureFrame frames[MAX_INPUTS];
+    int loudest = 0;
+    for (int i = 0; i < count; i++) {
+        frames[i] = this->inputs[i]->analyzer->getFeatures();
+        if (frames[i].frameIndex == this->inputs[i]->lastMerged) {
+            clearBeats(&frames[i]);
+        }
+        this->inputs[i]->lastMerged = frames[i].frameIndex;
+        if (frames[i].loudnessMomentary > frames[loudest].loudnessMomentary) {
+            loudest = i;
+        }
+    }
+    if (this->following >= count
+        || frames[loudest].loudnessMomentary > frames[this->following].loudnessMomentary + LOUDEST_HYSTERESIS_DB) {
+        this->following = loudest;
+    }
+
+    featureFrame out;
+    switch (this->policy.load()) {
+        case MERGE_PER_DECK: {
+            int deck = this->deck.load();
+            out = frames[deck >= 0 && deck < count ? deck : 0];
+            break;
+        }
+        case MERGE_WEIGHTED: {
+            out = frames[this->following];
+            clearBeats(&out);
+            float total = 0.0f;
+            for (int i = 0; i < count; i++) {
+                total += std::max(0.0f, this->inputs[i]->weight.load());
+            }
+            bool first = true;
+            for (int i = 0; i < count && total > 0.0f; i++) {
+                float w = std::max(0.0f, this->inputs[i]->weight.load()) / total;
+                if (w == 0.0f) {
+                    continue;
+                }
+                const featureFrame& f = frames[i];
+                blendInto(out.bandEnvelope, f.bandEnvelope, 3, w, first);
+                blendInto(&out.subBass, &f.subBass, 1, w, first);
+                blendInto(&out.bass, &f.bass, 1, w, first);
+                blendInto(out.chroma, f.chroma, 12, w, first);
+                blendInto(out.harmonic, f.harmonic, 3, w, first);
+                blendInto(out.percussive, f.percussive, 3, w, first);
+                blendInto(&out.rms, &f.rms, 1, w, first);
+                blendInto(&out.peak, &f.peak, 1, w, first);
+                blendInto(&out.energy, &f.energy, 1, w, first);
+                blendInto(out.normalized, f.normalized, NORM_COUNT, w, first);
+                out.lowBeatDetected = out.lowBeatDetected || f.lowBeatDetected;
+                out.highBeatDetected = out.highBeatDetected || f.highBeatDetected;
+                for (int b = 0; b < 3; b++) {
+                    out.percussiveOnset[b] = out.percussiveOnset[b] || f.percussiveOnset[b];
+                }
+                first = false;
+            }
+            out.source = -1;
+            break;
+        }
+        default:
+            out = frames[this->following];
+            break;
+    }
+    // The merge keeps a latch of its own; the inputs' latches are cleared
+    // with it when the renderer takes the beat
+    if (out.lowBeatDetected) {
+        this->lowBeatLatch.store(true);
+    }
+    if (out.highBeatDetected) {
+        this->highBeatLatch.store(true);
+    }
+    out.lowBeat = this->lowBeatLatch.load();
+    out.highBeat = this->highBeatLatch.load();
+    out.frameIndex = ++this->mergedFrames;
+    this->merged.publish(out);
+    if (this->shared != NULL) {
+        this->shared->publish(out);
+    }
+}
+
+void deviceManager::setPolicy(int policy){
+    this->policy.store(policy);
+}
+
+// Input MERGE_PER_DECK shows, e.g. following the mixer's crossfader
+void deviceManager::setDeck(int source){
+    this->deck.store(source);
+}
+
+void deviceManager::setWeight(int source, float weight){
+    if (source >= 0 && source < (int)this->inputs.size()) {
+        this->inputs[source]->weight.store(weight);
+    }
+}
+
+// The merged view; frame.source says which input it came from (-1 for a blend)
+featureFrame deviceManager::getFeatures(){
+    return this->merged.latest();
+}
+
+// A beat in the merged view since the renderer last cleared it, as
+// audioAnalyzer::lowBeat() is for one input
+bool deviceManager::lowBeat(){
+    return this->lowBeatLatch.load();
+}
+
+bool deviceManager::highBeat(){
+    return this->highBeatLatch.load();
+}
+
+// Clears the merged latch and every input's, so a beat one deck reported
+// does not stay set on that input once the merged view has shown it
+void deviceManager::setLowBeat(bool){
+    this->lowBeatLatch.store(false);
+    for (size_t i = 0; i < this->inputs.size(); i++) {
+        this->inputs[i]->analyzer->setLowBeat(false);
+    }
+}
+
+void deviceManager::setHighBeat(bool){
+    this->highBeatLatch.store(false);
+    for (size_t i = 0; i < this->inputs.size(); i++) {
+        this->inputs[i]->analyzer->setHighBeat(false);
+    }
+}
+
+featureFrame deviceManager::getFeatures(int source){
+    return this->inputs[source]->analyzer->getFeatures();
+}
+
+// For per-input configuration (tone bank bins, constant-Q range, ...)
+audioAnalyzer* deviceManager::analyzer(int source){
+    return this->inputs[source]->analyzer;
+}
+
+int deviceManager::sourceCount(){
+    return (int)this->inputs.size();
+}
+
+// Scheduling for the callback (THREAD_AUDIO) and worker (THREAD_ANALYSIS)
+// threads, from the next start(). Must outlive the manager's sessions.
+void deviceManager::setPlacement(threadPlacement* placement){
+    this->placement = placement;
+}
+
+// Also publish the merged frames to other processes (see featureShm.h).
+// Set before start(); merge() runs under mergeLock, so the publisher still
+// has one writer at a time.
+void deviceManager::setSharedBus(featureShmPublisher* shared){
+    this->shared = shared;
+}
+
+// How regularly the input's callback has been woken since the last call
+jitterStats deviceManager::captureJitter(int source){
+    jitterStats stats = this->inputs[source]->callbackJitter.stats();
+    this->inputs[source]->callbackJitter.reset();
+    return stats;
+}
+
+// How long queued buffers waited for the input's worker since the last call
+jitterStats deviceManager::workerLatency(int source){
+    jitterStats stats = this->inputs[source]->workerLatency.stats();
+    this->inputs[source]->workerLatency.reset();
+    return stats;
+}
+
+// Buffers the callback had to drop because the worker fell behind
+unsigned long deviceManager::droppedBuffers(int source){
+    return this->inputs[source]->dropped.load();
+}
@@ -0,0 +1,85 @@
+#ifndef DEVICEMANAGER_H
+#define DEVICEMANAGER_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "audioAnalyzer.h"
+
+#define MAX_INPUTS 8              // Capture streams one manager runs
+#define DEVICE_RING_BLOCKS 32     // Buffers queued per input (~0.75 s) before capture starts dropping
+#define LOUDEST_HYSTERESIS_DB 3.0 // Another input must be this much louder to take over
+
+// What the renderer sees when several inputs are live
+enum {
+    MERGE_LOUDEST = 0,   // The loudest input (momentary LUFS), with hysteresis
+    MERGE_WEIGHTED,      // Level-type features blended by per-input weight, beats from any input
+    MERGE_PER_DECK       // Whichever input setDeck() selected
+};
+
+// One buffer as PortAudio delivered it: FRAMES_PER_BUFFER interleaved frames
+// at the device's rate, which the input's analyzer converts if it must
+typedef struct {
+    long long queuedNs;   // steady_clock time the callback queued it, for the worker's wakeup latency
+    float samples[FRAMES_PER_BUFFER * MAX_CHANNELS];
+} captureBlock;
+
+struct captureInput;
+
+// Runs several capture streams at once (two DJ decks and an ambient mic,
+// say), each with its own audioAnalyzer. The PortAudio callback only copies
+// the buffer into the input's lock-free ring; a worker thread pinned to its
+// own core drains the ring through the analyzer, so a slow analysis on one
+// input never stalls another input's audio thread.
+//
+// After every analysed buffer the manager merges the latest frame of each
+// input according to the merge policy and publishes the result, tagged with
+// the source it came from, on one featureBus the renderer reads. Beats are
+// merged per buffer, each reported once, into a latch of the manager's own
+// (lowBeat()/setLowBeat()); clearing it clears the inputs' latches too.
+class deviceManager{
+    private:
+        std::vector<captureInput*> inputs;
+        featureBus merged;
+        std::mutex mergeLock;      // Workers take turns publishing the merge
+        unsigned long long mergedFrames;
+        int following;             // Input MERGE_LOUDEST currently shows
+        std::atomic<int> policy;
+        std::atomic<int> deck;
+        std::atomic<bool> running;
+        std::atomic<bool> lowBeatLatch;   // Set by a merged beat, cleared by the renderer
+        std::atomic<bool> highBeatLatch;
+        threadPlacement* placement;
+        featureShmPublisher* shared;
+
+        void work(captureInput*);
+        void merge();
+    public:
+        deviceManager();
+        ~deviceManager();
+
+        int addDevice(int device, int channels = NUM_CHANNELS, float weight = 1.0f, int core = -1);
+        int start();
+        void stop();
+        int process(int source, const float*, unsigned long);
+
+        void setPolicy(int);
+        void setDeck(int source);
+        void setWeight(int source, float weight);
+        void setPlacement(threadPlacement*);
+        void setSharedBus(featureShmPublisher*);
+
+        featureFrame getFeatures();
+        featureFrame getFeatures(int source);
+        bool lowBeat();
+        bool highBeat();
+        void setLowBeat(bool);
+        void setHighBeat(bool);
+        audioAnalyzer* analyzer(int source);
+        int sourceCount();
+        unsigned long droppedBuffers(int source);
+        jitterStats captureJitter(int source);
+        jitterStats workerLatency(int source);
+};
+
+#endif
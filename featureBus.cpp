@@ -0,0 +1,32 @@
+#include "featureBus.h"
+
+featureBus::featureBus(){
+    this->sequence.store(0);
+    memset(&this->frame, 0, sizeof(featureFrame));
+}
+
+// Odd sequence numbers mean a write is in progress
+void featureBus::publish(const featureFrame& next){
+    unsigned seq = this->sequence.load(std::memory_order_relaxed);
+    this->sequence.store(seq + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(&this->frame, &next, sizeof(featureFrame));
+    this->sequence.store(seq + 2, std::memory_order_release);
+}
+
+// Retries until it gets a copy no writer touched while it was being taken
+featureFrame featureBus::latest(){
+    featureFrame copy;
+    unsigned before, after;
+    do {
+        before = this->sequence.load(std::memory_order_acquire);
+        memcpy(&copy, &this->frame, sizeof(featureFrame));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        after = this->sequence.load(std::memory_order_relaxed);
+    } while (before != after || (before & 1));
+    return copy;
+}
+
+unsigned long long featureBus::published(){
+    return this->latest().frameIndex;
+}
@@ -0,0 +1,105 @@
+#ifndef FEATUREBUS_H
+#define FEATUREBUS_H
+
+#include <atomic>
+#include <cstring>
+#include "transientDetector.h" // NUM_BANDS
+#include "slidingDft.h"        // SDFT_MAX_BINS
+#include "constantQ.h"         // CQT_MAX_NOTES
+
+#define MAX_CHANNELS 8        // Widest input one analyzer takes (8-channel stems)
+
+// Features published a second time normalised to [0, 1] (featureNormalizer),
+// as indices into featureFrame::normalized
+enum {
+    NORM_FREQ = 0,
+    NORM_SUB_BASS,
+    NORM_BASS,
+    NORM_RMS,
+    NORM_LOUDNESS,
+    NORM_PERCUSSIVE_LOW,
+    NORM_PERCUSSIVE_MID,
+    NORM_PERCUSSIVE_HIGH,
+    NORM_HARMONIC_LOW,
+    NORM_HARMONIC_MID,
+    NORM_HARMONIC_HIGH,
+    NORM_COUNT
+};
+
+// Everything the analyzer computed for one audio buffer. Written by the
+// analysis thread, read by the renderer and by tools such as the soak test.
+typedef struct {
+    unsigned long long frameIndex; // Buffers analysed since the analyzer was created
+    int source;                    // Input that produced the frame (deviceManager), -1 for a blend
+    float bpm;                     // Running BPM estimate
+    float freq;                    // Last sampled FFT magnitude (what getCurrentFrequency returns)
+    bool lowBeat;                  // Latched: stays set until the renderer clears it
+    bool highBeat;
+    bool lowBeatDetected;          // A beat was detected in this buffer
+    bool highBeatDetected;
+    float maxLowBeat;
+    float maxHighBeat;
+
+    // Time-domain path (transientDetector), indexed low/mid/high
+    float bandEnvelope[NUM_BANDS];  // Envelope of each crossover band at the end of the buffer
+    int transientOffset[NUM_BANDS]; // Sample in the buffer where a transient started, -1 if none
+
+    // Decimated low-frequency path (bassAnalyzer)
+    float subBass;          // 20-60 Hz amplitude
+    float bass;             // 60-250 Hz amplitude
+    float bassPeakHz;       // Strongest bass frequency, 0 when silent
+
+    // Sliding DFT bins (slidingDft), latest control-rate tick in this buffer
+    int toneCount;
+    float toneMagnitude[SDFT_MAX_BINS];
+
+    // Constant-Q path (constantQ), from the same FFT frame as freq
+    float chroma[12];       // Pitch-class energy, C first, strongest = 1
+    int lowestNote;         // MIDI note of noteEnergy[0]
+    int noteCount;
+    float noteEnergy[CQT_MAX_NOTES]; // Squared amplitude per semitone
+
+    // Harmonic/percussive split of the FFT frame (harmonicPercussive), low/mid/high
+    float harmonic[NUM_BANDS];      // Sustained energy, drives colour
+    float percussive[NUM_BANDS];    // Broadband/transient energy
+    bool percussiveOnset[NUM_BANDS];// What lowBeat/highBeat are now derived from
+
+    // Loudness and dynamics (loudnessMeter)
+    float loudnessMomentary; // K-weighted LUFS, 400 ms
+    float loudnessShortTerm; // K-weighted LUFS, 3 s
+    float rms;
+    float peak;
+    float crestFactor;       // dB
+    float energy;            // Momentary loudness on [0, 1], what visuals should scale by
+
+    // Per input channel (the first `channels` entries) and the front pair as mid/side
+    int channels;
+    float channelLoudness[MAX_CHANNELS]; // Momentary LUFS
+    float channelRms[MAX_CHANNELS];
+    float channelPeak[MAX_CHANNELS];
+    bool channelLowBeat[MAX_CHANNELS];   // Time-domain transient in the channel's low band
+    bool channelHighBeat[MAX_CHANNELS];
+    float midLoudness;        // LUFS
+    float sideLoudness;
+    float stereoWidth;        // Side RMS over mid RMS, 0 for mono
+    float correlation;        // Left/right correlation over the buffer, 1 for mono
+
+    // The raw values above rescaled against their own recent range, indexed by NORM_*
+    float normalized[NORM_COUNT];
+} featureFrame;
+
+// Single-writer, many-reader snapshot of the latest featureFrame.
+// Uses a sequence lock so the audio side never waits on a reader.
+class featureBus{
+    private:
+        std::atomic<unsigned> sequence;
+        featureFrame frame;
+    public:
+        featureBus();
+
+        void publish(const featureFrame&);
+        featureFrame latest();
+        unsigned long long published();
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "featureNormalizer.h"
+#include <cmath>
+#include <algorithm>
+
+featureNormalizer::featureNormalizer(int features, double updatesPerSecond, double decaySeconds){
+    this->high.resize(features);
+    this->low.resize(features);
+    this->minSpan.assign(features, 1e-6f);
+    this->seeded.resize(features);
+    this->release = 1.0 - std::exp(-1.0 / (decaySeconds * updatesPerSecond));
+    this->reset();
+}
+
+// For a new feature rate; the learned ranges carry over
+void featureNormalizer::setUpdateRate(double updatesPerSecond, double decaySeconds){
+    this->release = 1.0 - std::exp(-1.0 / (decaySeconds * updatesPerSecond));
+}
+
+// Keeps quiet, steady signals (where max and min converge) from having
+// their noise stretched to full scale
+void featureNormalizer::setMinSpan(int feature, float span){
+    this->minSpan[feature] = span;
+}
+
+void featureNormalizer::reset(){
+    std::fill(this->high.begin(), this->high.end(), 0.0f);
+    std::fill(this->low.begin(), this->low.end(), 0.0f);
+    std::fill(this->seeded.begin(), this->seeded.end(), false);
+}
+
+// Returns value mapped onto [0, 1] against the feature's current range.
+// Non-finite values are ignored and read as 0.
+float featureNormalizer::update(int feature, float value){
+    if (!std::isfinite(value)) {
+        return 0.0f;
+    }
+    float& hi = this->high[feature];
+    float& lo = this->low[feature];
+    if (!this->seeded[feature]) {
+        hi = lo = value;
+        this->seeded[feature] = true;
+    }
+    hi = value > hi ? value : hi + this->release * (value - hi);
+    lo = value < lo ? value : lo + this->release * (value - lo);
+
+    float span = std::max(hi - lo, this->minSpan[feature]);
+    return std::min(1.0f, std::max(0.0f, (value - lo) / span));
+}
@@ -0,0 +1,30 @@
+#ifndef FEATURENORMALIZER_H
+#define FEATURENORMALIZER_H
+
+#include <vector>
+
+#define NORM_DECAY_SECONDS 10.0 // How long a loud moment keeps stretching the range
+
+// Maps each of a fixed set of features onto [0, 1] using a range that adapts
+// to the material. Each feature keeps an exponential max and min: a new
+// extreme is taken immediately, then the bound relaxes back towards the
+// signal over NORM_DECAY_SECONDS. One transient therefore only compresses the
+// response for a few seconds, and the same visuals work in a quiet bar and a
+// loud club. Two floats of state per feature, O(1) per update.
+class featureNormalizer{
+    private:
+        std::vector<float> high;
+        std::vector<float> low;
+        std::vector<float> minSpan;  // Below this range the output is not stretched further
+        std::vector<bool> seeded;
+        float release;               // Per-update relaxation coefficient
+    public:
+        featureNormalizer(int features, double updatesPerSecond, double decaySeconds = NORM_DECAY_SECONDS);
+
+        void setMinSpan(int feature, float span);
+        void setUpdateRate(double updatesPerSecond, double decaySeconds = NORM_DECAY_SECONDS);
+        void reset();
+        float update(int feature, float value);
+};
+
+#endif
@@ -0,0 +1,175 @@
+#ifndef FEATURESHM_H
+#define FEATURESHM_H
+
+/*
+ * Shared-memory feature bus: the visualiser publishes every analysed frame
+ * and every beat into a POSIX shared-memory object, and any number of local
+ * processes (lighting, LED walls) map it read-only and follow along at
+ * audio rate. After featureShmOpen() a read is a few loads and one copy out
+ * of the mapping, with no system call and no lock; the writer never waits
+ * for a reader.
+ *
+ * Layout: a header, then FEATURE_SHM_FRAMES frame slots, then
+ * FEATURE_SHM_EVENTS beat event slots, each at the offset and stride the
+ * header gives. Every slot carries its own sequence lock (odd while being
+ * written) and the ring position it holds, so a reader can tell a torn or
+ * overwritten slot from a good one. The shared fields a writer updates are
+ * read with __atomic builtins (GCC and Clang), so this header works from
+ * C99 and C++ alike.
+ *
+ * Versioning: readers refuse a different FEATURE_SHM_VERSION_MAJOR. Minor
+ * versions only append fields to featureShmFrame / featureShmEvent, and a
+ * reader copies only the bytes it knows.
+ *
+ * Client use (link featureShmClient.c, or libfeatureshm.a):
+ *
+ *   featureShmClient* bus = featureShmOpen(NULL);
+ *   featureShmFrame frame;
+ *   featureShmEvent beat;
+ *   while (featureShmAlive(bus)) {
+ *       while (featureShmNextEvent(bus, &beat)) { flash(beat.kind, beat.strength); }
+ *       if (featureShmLatest(bus, &frame)) { setLevels(frame.normalized); }
+ *   }
+ *   featureShmClose(bus);
+ *
+ * A read gives up after FEATURE_SHM_READ_ATTEMPTS torn slots and returns 0
+ * as if there were nothing new. A publisher that dies mid-write leaves its
+ * slot torn for good, so a client that keeps getting 0 should check
+ * featureShmAlive() and, once it is 0, close and featureShmOpen() again.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define FEATURE_SHM_NAME "/fractal-features"
+#define FEATURE_SHM_MAGIC 0x46425553u   /* "FBUS" */
+#define FEATURE_SHM_VERSION_MAJOR 1
+#define FEATURE_SHM_VERSION_MINOR 0
+#define FEATURE_SHM_FRAMES 256          /* ~6 s of frames at a 1024 hop */
+#define FEATURE_SHM_EVENTS 256
+#define FEATURE_SHM_CHANNELS 8
+#define FEATURE_SHM_NORMALIZED 16
+#define FEATURE_SHM_READ_ATTEMPTS 64    /* Torn slots a read retries before returning 0 */
+
+/* featureShmFrame.beats and featureShmEvent.kind */
+#define FEATURE_SHM_LOW_BEAT 0x01
+#define FEATURE_SHM_HIGH_BEAT 0x02
+#define FEATURE_SHM_ONSET_LOW 0x04
+#define FEATURE_SHM_ONSET_MID 0x08
+#define FEATURE_SHM_ONSET_HIGH 0x10
+
+/* Indices into featureShmFrame.normalized, each on [0, 1] */
+enum {
+    FEATURE_SHM_NORM_FREQ = 0,
+    FEATURE_SHM_NORM_SUB_BASS,
+    FEATURE_SHM_NORM_BASS,
+    FEATURE_SHM_NORM_RMS,
+    FEATURE_SHM_NORM_LOUDNESS,
+    FEATURE_SHM_NORM_PERCUSSIVE_LOW,
+    FEATURE_SHM_NORM_PERCUSSIVE_MID,
+    FEATURE_SHM_NORM_PERCUSSIVE_HIGH,
+    FEATURE_SHM_NORM_HARMONIC_LOW,
+    FEATURE_SHM_NORM_HARMONIC_MID,
+    FEATURE_SHM_NORM_HARMONIC_HIGH,
+    FEATURE_SHM_NORM_COUNT
+};
+
+/* One analysed buffer. Bands are low/mid/high. */
+typedef struct {
+    uint64_t frameIndex;        /* Buffers the analyzer has analysed */
+    int64_t timeNs;             /* CLOCK_MONOTONIC when published */
+    int32_t source;             /* Input that produced it, -1 for a blend */
+    uint32_t beats;             /* FEATURE_SHM_* beat bits */
+    float bpm;
+    float freq;
+    float energy;               /* Momentary loudness on [0, 1] */
+    float loudnessMomentary;    /* LUFS */
+    float loudnessShortTerm;
+    float rms;
+    float peak;
+    float crestFactor;          /* dB */
+    float subBass;
+    float bass;
+    float bassPeakHz;
+    float bandEnvelope[3];
+    int32_t transientOffset[3]; /* Sample in the buffer a transient started, -1 if none */
+    float harmonic[3];
+    float percussive[3];
+    float chroma[12];           /* C first, strongest = 1 */
+    int32_t channels;
+    float channelLoudness[FEATURE_SHM_CHANNELS];
+    float channelRms[FEATURE_SHM_CHANNELS];
+    float stereoWidth;
+    float correlation;
+    int32_t normalizedCount;
+    float normalized[FEATURE_SHM_NORMALIZED];
+} featureShmFrame;
+
+/* One beat or onset, as it was detected */
+typedef struct {
+    uint64_t frameIndex;        /* Frame it came from */
+    int64_t timeNs;             /* CLOCK_MONOTONIC */
+    int32_t source;
+    uint32_t kind;              /* One FEATURE_SHM_* beat bit */
+    float strength;             /* Band envelope (beats) or percussive energy (onsets) */
+    int32_t offset;             /* Sample in the buffer, -1 if unknown */
+} featureShmEvent;
+
+typedef struct {
+    uint32_t sequence;          /* Odd while the writer is in the slot */
+    uint32_t reserved;
+    uint64_t position;          /* Ring position held, FEATURE_SHM_FRAMES apart per lap */
+    featureShmFrame frame;
+} featureShmFrameSlot;
+
+typedef struct {
+    uint32_t sequence;
+    uint32_t reserved;
+    uint64_t position;
+    featureShmEvent event;
+} featureShmEventSlot;
+
+typedef struct {
+    uint32_t magic;             /* Written last; a reader that sees it sees the rest */
+    uint16_t versionMajor;
+    uint16_t versionMinor;
+    uint32_t headerBytes;
+    uint32_t frameBytes;        /* sizeof(featureShmFrame) as the writer built it */
+    uint32_t eventBytes;
+    uint32_t frameSlots;
+    uint32_t eventSlots;
+    uint32_t frameOffset;       /* Byte offset of the first frame slot */
+    uint32_t frameStride;
+    uint32_t eventOffset;
+    uint32_t eventStride;
+    int32_t publisherPid;
+    uint64_t framesWritten;     /* Next frame position; the latest is framesWritten - 1 */
+    uint64_t eventsWritten;
+    int64_t heartbeatNs;        /* CLOCK_MONOTONIC of the last publish */
+    uint32_t closed;            /* Set when the publisher shuts down cleanly */
+    uint32_t reserved;
+} featureShmHeader;
+
+/* Client library (featureShmClient.c) */
+typedef struct featureShmClient featureShmClient;
+
+featureShmClient* featureShmOpen(const char* name);   /* NULL name for FEATURE_SHM_NAME; NULL if absent or incompatible */
+void featureShmClose(featureShmClient*);
+int featureShmAlive(featureShmClient*);               /* Publisher running and published in the last second */
+int featureShmLatest(featureShmClient*, featureShmFrame* out);   /* 1 with the newest frame, 0 if none yet or torn */
+int featureShmNext(featureShmClient*, featureShmFrame* out);     /* Every frame in order; 0 when caught up or torn */
+int featureShmNextEvent(featureShmClient*, featureShmEvent* out);
+uint64_t featureShmMissed(featureShmClient*);         /* Frames and events overwritten before this client read them */
+
+/* Zero-copy: read fields straight from the slot, then check nothing changed */
+const featureShmFrame* featureShmPeek(featureShmClient*, uint64_t* ticket);
+int featureShmValid(featureShmClient*, uint64_t ticket);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,203 @@
+/* Reader side of the shared-memory feature bus; see featureShm.h */
+#include "featureShm.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <stddef.h>
+
+#define FEATURE_SHM_STALE_NS 1000000000LL /* No publish for this long means the publisher is gone */
+
+struct featureShmClient {
+    const unsigned char* base;
+    size_t bytes;
+    const featureShmHeader* header;
+    size_t frameCopy;           /* Bytes of a frame both sides know about */
+    size_t eventCopy;
+    uint64_t nextFrame;         /* Ring positions this client reads next */
+    uint64_t nextEvent;
+    uint64_t missed;
+};
+
+enum { SLOT_OK = 0, SLOT_TORN, SLOT_OVERWRITTEN };
+
+/* Both slot types: sequence, reserved, position, then the payload */
+#define SLOT_PAYLOAD 16
+typedef char frameSlotLayout[offsetof(featureShmFrameSlot, frame) == SLOT_PAYLOAD ? 1 : -1];
+typedef char eventSlotLayout[offsetof(featureShmEventSlot, event) == SLOT_PAYLOAD ? 1 : -1];
+
+/* Copies the payload of a slot holding ring position `position` */
+static int readSlot(const unsigned char* slot, uint64_t position, void* out, size_t copy, size_t outBytes){
+    const uint32_t* sequence = (const uint32_t*)slot;
+    const uint64_t* held = (const uint64_t*)(slot + 8);
+    uint32_t before = __atomic_load_n(sequence, __ATOMIC_ACQUIRE);
+    if (before & 1) {
+        return SLOT_TORN;
+    }
+    uint64_t at = __atomic_load_n(held, __ATOMIC_RELAXED);
+    memcpy(out, slot + SLOT_PAYLOAD, copy);
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(sequence, __ATOMIC_RELAXED) != before) {
+        return SLOT_TORN;
+    }
+    if (at != position) {
+        return at > position ? SLOT_OVERWRITTEN : SLOT_TORN;
+    }
+    memset((unsigned char*)out + copy, 0, outBytes - copy);
+    return SLOT_OK;
+}
+
+static const unsigned char* frameSlot(const featureShmClient* client, uint64_t position){
+    const featureShmHeader* h = client->header;
+    return client->base + h->frameOffset + (position % h->frameSlots) * h->frameStride;
+}
+
+static const unsigned char* eventSlot(const featureShmClient* client, uint64_t position){
+    const featureShmHeader* h = client->header;
+    return client->base + h->eventOffset + (position % h->eventSlots) * h->eventStride;
+}
+
+featureShmClient* featureShmOpen(const char* name){
+    int fd = shm_open(name != NULL ? name : FEATURE_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat info;
+    if (fstat(fd, &info) != 0 || (size_t)info.st_size < sizeof(featureShmHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t bytes = (size_t)info.st_size;
+    void* address = mmap(NULL, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+
+    const featureShmHeader* h = (const featureShmHeader*)address;
+    int usable = __atomic_load_n(&h->magic, __ATOMIC_ACQUIRE) == FEATURE_SHM_MAGIC
+        && h->versionMajor == FEATURE_SHM_VERSION_MAJOR
+        && h->frameSlots > 0 && h->eventSlots > 0
+        && h->frameStride >= SLOT_PAYLOAD + h->frameBytes && h->eventStride >= SLOT_PAYLOAD + h->eventBytes
+        && (size_t)h->frameOffset + (size_t)h->frameStride * h->frameSlots <= bytes
+        && (size_t)h->eventOffset + (size_t)h->eventStride * h->eventSlots <= bytes;
+    featureShmClient* client = usable ? (featureShmClient*)calloc(1, sizeof(featureShmClient)) : NULL;
+    if (client == NULL) {
+        munmap(address, bytes);
+        return NULL;
+    }
+    client->base = (const unsigned char*)address;
+    client->bytes = bytes;
+    client->header = h;
+    client->frameCopy = h->frameBytes < sizeof(featureShmFrame) ? h->frameBytes : sizeof(featureShmFrame);
+    client->eventCopy = h->eventBytes < sizeof(featureShmEvent) ? h->eventBytes : sizeof(featureShmEvent);
+    /* Start from now rather than replaying the ring */
+    client->nextFrame = __atomic_load_n(&h->framesWritten, __ATOMIC_ACQUIRE);
+    client->nextEvent = __atomic_load_n(&h->eventsWritten, __ATOMIC_ACQUIRE);
+    return client;
+}
+
+void featureShmClose(featureShmClient* client){
+    if (client == NULL) {
+        return;
+    }
+    munmap((void*)client->base, client->bytes);
+    free(client);
+}
+
+int featureShmAlive(featureShmClient* client){
+    if (client == NULL || __atomic_load_n(&client->header->closed, __ATOMIC_ACQUIRE)) {
+        return 0;
+    }
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t nowNs = (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+    return nowNs - __atomic_load_n(&client->header->heartbeatNs, __ATOMIC_RELAXED) < FEATURE_SHM_STALE_NS;
+}
+
+/* Both readers retry a torn slot, which the publisher is normally done
+   with within microseconds, but only so often: one that died mid-write
+   never finishes */
+int featureShmLatest(featureShmClient* client, featureShmFrame* out){
+    int attempt;
+    for (attempt = 0; attempt < FEATURE_SHM_READ_ATTEMPTS; attempt++) {
+        uint64_t written = __atomic_load_n(&client->header->framesWritten, __ATOMIC_ACQUIRE);
+        if (written == 0) {
+            return 0;
+        }
+        if (readSlot(frameSlot(client, written - 1), written - 1, out, client->frameCopy, sizeof(*out)) == SLOT_OK) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Generic in-order reader for either ring */
+static int readNext(featureShmClient* client, const uint64_t* writtenAt, uint32_t slots, uint64_t* next,
+                    const unsigned char* (*slotAt)(const featureShmClient*, uint64_t), void* out, size_t copy, size_t outBytes){
+    int attempt;
+    for (attempt = 0; attempt < FEATURE_SHM_READ_ATTEMPTS; attempt++) {
+        uint64_t written = __atomic_load_n(writtenAt, __ATOMIC_ACQUIRE);
+        if (*next >= written) {
+            return 0;
+        }
+        /* Lapped: the oldest slot may be mid-write, so resume one past it */
+        if (written - *next >= slots) {
+            uint64_t resume = written - slots + 1;
+            client->missed += resume - *next;
+            *next = resume;
+        }
+        int result = readSlot(slotAt(client, *next), *next, out, copy, outBytes);
+        if (result == SLOT_OK) {
+            (*next)++;
+            return 1;
+        }
+        if (result == SLOT_OVERWRITTEN) {
+            client->missed++;
+            (*next)++;
+        }
+    }
+    return 0;
+}
+
+int featureShmNext(featureShmClient* client, featureShmFrame* out){
+    return readNext(client, &client->header->framesWritten, client->header->frameSlots, &client->nextFrame,
+                    frameSlot, out, client->frameCopy, sizeof(*out));
+}
+
+int featureShmNextEvent(featureShmClient* client, featureShmEvent* out){
+    return readNext(client, &client->header->eventsWritten, client->header->eventSlots, &client->nextEvent,
+                    eventSlot, out, client->eventCopy, sizeof(*out));
+}
+
+uint64_t featureShmMissed(featureShmClient* client){
+    return client->missed;
+}
+
+/* The newest frame, in place, or NULL if there is none or it is being
+   written. The ticket identifies the slot and its sequence number. Only
+   valid if the publisher's frame layout matches this header's exactly. */
+const featureShmFrame* featureShmPeek(featureShmClient* client, uint64_t* ticket){
+    uint64_t written = __atomic_load_n(&client->header->framesWritten, __ATOMIC_ACQUIRE);
+    if (written == 0 || client->header->frameBytes != sizeof(featureShmFrame)) {
+        return NULL;
+    }
+    uint64_t slotIndex = (written - 1) % client->header->frameSlots;
+    const unsigned char* slot = frameSlot(client, written - 1);
+    uint32_t sequence = __atomic_load_n((const uint32_t*)slot, __ATOMIC_ACQUIRE);
+    if (sequence & 1) {
+        return NULL;
+    }
+    *ticket = (slotIndex << 32) | sequence;
+    return (const featureShmFrame*)(slot + SLOT_PAYLOAD);
+}
+
+/* 1 if nothing was written to the peeked slot since featureShmPeek */
+int featureShmValid(featureShmClient* client, uint64_t ticket){
+    const unsigned char* slot = client->base + client->header->frameOffset + (ticket >> 32) * client->header->frameStride;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    return __atomic_load_n((const uint32_t*)slot, __ATOMIC_RELAXED) == (uint32_t)ticket;
+}
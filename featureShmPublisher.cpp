@@ -0,0 +1,196 @@
+#include "featureShmPublisher.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <algorithm>
+
+static_assert((int)NORM_COUNT == (int)FEATURE_SHM_NORM_COUNT && (int)NORM_HARMONIC_HIGH == (int)FEATURE_SHM_NORM_HARMONIC_HIGH,
+              "featureShm.h's normalized indices must follow NORM_* in featureBus.h");
+static_assert(NORM_COUNT <= FEATURE_SHM_NORMALIZED, "FEATURE_SHM_NORMALIZED is too small");
+
+// Slots start on their own cache lines so a reader never shares one with the slot being written
+static size_t cacheAligned(size_t bytes){
+    return (bytes + 63) / 64 * 64;
+}
+
+static int64_t monotonicNs(){
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (int64_t)now.tv_sec * 1000000000LL + now.tv_nsec;
+}
+
+featureShmPublisher::featureShmPublisher(){
+    this->base = NULL;
+    this->bytes = 0;
+    this->header = NULL;
+}
+
+featureShmPublisher::~featureShmPublisher(){
+    this->close();
+}
+
+// Creates and maps the shared object. Returns 1 on success.
+int featureShmPublisher::open(const char* name){
+    if (this->isOpen()) {
+        return 1;
+    }
+    size_t frameOffset = cacheAligned(sizeof(featureShmHeader));
+    size_t frameStride = cacheAligned(sizeof(featureShmFrameSlot));
+    size_t eventOffset = frameOffset + frameStride * FEATURE_SHM_FRAMES;
+    size_t eventStride = cacheAligned(sizeof(featureShmEventSlot));
+    size_t bytes = eventOffset + eventStride * FEATURE_SHM_EVENTS;
+
+    // A fresh object rather than resizing a stale one under its readers
+    shm_unlink(name);
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) {
+        printf("Could not create shared memory %s: %s\n", name, strerror(errno));
+        return 0;
+    }
+    if (ftruncate(fd, bytes) != 0) {
+        printf("Could not size shared memory %s: %s\n", name, strerror(errno));
+        ::close(fd);
+        shm_unlink(name);
+        return 0;
+    }
+    void* address = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (address == MAP_FAILED) {
+        printf("Could not map shared memory %s: %s\n", name, strerror(errno));
+        shm_unlink(name);
+        return 0;
+    }
+    // Fault every page in now rather than on the audio thread's first publish
+    memset(address, 0, bytes);
+
+    this->name = name;
+    this->base = (unsigned char*)address;
+    this->bytes = bytes;
+    this->header = (featureShmHeader*)address;
+    featureShmHeader* h = this->header;
+    h->versionMajor = FEATURE_SHM_VERSION_MAJOR;
+    h->versionMinor = FEATURE_SHM_VERSION_MINOR;
+    h->headerBytes = sizeof(featureShmHeader);
+    h->frameBytes = sizeof(featureShmFrame);
+    h->eventBytes = sizeof(featureShmEvent);
+    h->frameSlots = FEATURE_SHM_FRAMES;
+    h->eventSlots = FEATURE_SHM_EVENTS;
+    h->frameOffset = frameOffset;
+    h->frameStride = frameStride;
+    h->eventOffset = eventOffset;
+    h->eventStride = eventStride;
+    h->publisherPid = getpid();
+    h->heartbeatNs = monotonicNs();
+    __atomic_store_n(&h->magic, FEATURE_SHM_MAGIC, __ATOMIC_RELEASE);
+    return 1;
+}
+
+// Marks the bus closed for readers and removes the name; readers keep
+// their mappings until they close them
+void featureShmPublisher::close(){
+    if (!this->isOpen()) {
+        return;
+    }
+    __atomic_store_n(&this->header->closed, 1u, __ATOMIC_RELEASE);
+    munmap(this->base, this->bytes);
+    shm_unlink(this->name.c_str());
+    this->base = NULL;
+    this->header = NULL;
+    this->bytes = 0;
+}
+
+bool featureShmPublisher::isOpen(){
+    return this->base != NULL;
+}
+
+void featureShmPublisher::writeEvent(const featureShmFrame& frame, uint32_t kind, float strength, int32_t offset){
+    uint64_t position = __atomic_load_n(&this->header->eventsWritten, __ATOMIC_RELAXED);
+    featureShmEventSlot* slot = (featureShmEventSlot*)(this->base + this->header->eventOffset
+        + (position % FEATURE_SHM_EVENTS) * this->header->eventStride);
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    slot->position = position;
+    slot->event.frameIndex = frame.frameIndex;
+    slot->event.timeNs = frame.timeNs;
+    slot->event.source = frame.source;
+    slot->event.kind = kind;
+    slot->event.strength = strength;
+    slot->event.offset = offset;
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&this->header->eventsWritten, position + 1, __ATOMIC_RELEASE);
+}
+
+void featureShmPublisher::publish(const featureFrame& in){
+    if (!this->isOpen()) {
+        return;
+    }
+    uint64_t position = __atomic_load_n(&this->header->framesWritten, __ATOMIC_RELAXED);
+    featureShmFrameSlot* slot = (featureShmFrameSlot*)(this->base + this->header->frameOffset
+        + (position % FEATURE_SHM_FRAMES) * this->header->frameStride);
+    uint32_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    featureShmFrame& out = slot->frame;
+    slot->position = position;
+    out.frameIndex = in.frameIndex;
+    out.timeNs = monotonicNs();
+    out.source = in.source;
+    out.beats = (in.lowBeatDetected ? FEATURE_SHM_LOW_BEAT : 0)
+              | (in.highBeatDetected ? FEATURE_SHM_HIGH_BEAT : 0)
+              | (in.percussiveOnset[0] ? FEATURE_SHM_ONSET_LOW : 0)
+              | (in.percussiveOnset[1] ? FEATURE_SHM_ONSET_MID : 0)
+              | (in.percussiveOnset[2] ? FEATURE_SHM_ONSET_HIGH : 0);
+    out.bpm = in.bpm;
+    out.freq = in.freq;
+    out.energy = in.energy;
+    out.loudnessMomentary = in.loudnessMomentary;
+    out.loudnessShortTerm = in.loudnessShortTerm;
+    out.rms = in.rms;
+    out.peak = in.peak;
+    out.crestFactor = in.crestFactor;
+    out.subBass = in.subBass;
+    out.bass = in.bass;
+    out.bassPeakHz = in.bassPeakHz;
+    static_assert(sizeof(out.bandEnvelope) == sizeof(in.bandEnvelope) && sizeof(out.harmonic) == sizeof(in.harmonic)
+        && sizeof(out.chroma) == sizeof(in.chroma), "featureShmFrame out of step with featureFrame");
+    for (int b = 0; b < NUM_BANDS; b++) {
+        out.bandEnvelope[b] = in.bandEnvelope[b];
+        out.transientOffset[b] = in.transientOffset[b];
+        out.harmonic[b] = in.harmonic[b];
+        out.percussive[b] = in.percussive[b];
+    }
+    memcpy(out.chroma, in.chroma, sizeof(out.chroma));
+    out.channels = std::min(in.channels, FEATURE_SHM_CHANNELS);
+    for (int c = 0; c < FEATURE_SHM_CHANNELS; c++) {
+        out.channelLoudness[c] = c < out.channels ? in.channelLoudness[c] : 0.0f;
+        out.channelRms[c] = c < out.channels ? in.channelRms[c] : 0.0f;
+    }
+    out.stereoWidth = in.stereoWidth;
+    out.correlation = in.correlation;
+    out.normalizedCount = NORM_COUNT;
+    for (int n = 0; n < FEATURE_SHM_NORMALIZED; n++) {
+        out.normalized[n] = n < NORM_COUNT ? in.normalized[n] : 0.0f;
+    }
+    __atomic_store_n(&slot->sequence, sequence + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&this->header->framesWritten, position + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&this->header->heartbeatNs, out.timeNs, __ATOMIC_RELAXED);
+
+    // Beats after the frame, so a reader that sees an event can find its
+    // frame. Only the buffer that detected a beat reports it; the latched
+    // lowBeat/highBeat stay set until the renderer takes them.
+    const featureShmFrame& frame = slot->frame;
+    if (in.lowBeatDetected) this->writeEvent(frame, FEATURE_SHM_LOW_BEAT, in.bandEnvelope[0], in.transientOffset[0]);
+    if (in.highBeatDetected) this->writeEvent(frame, FEATURE_SHM_HIGH_BEAT, in.bandEnvelope[2], in.transientOffset[2]);
+    for (int b = 0; b < 3; b++) {
+        if (in.percussiveOnset[b]) {
+            this->writeEvent(frame, FEATURE_SHM_ONSET_LOW << b, in.percussive[b], -1);
+        }
+    }
+}
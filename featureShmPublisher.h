@@ -0,0 +1,35 @@
+#ifndef FEATURESHMPUBLISHER_H
+#define FEATURESHMPUBLISHER_H
+
+#include <string>
+#include "featureBus.h"
+#include "featureShm.h"
+
+// Writer side of the shared-memory feature bus (layout and client library
+// in featureShm.h). Every published featureFrame goes into the frame ring,
+// and each beat or onset in it into the event ring. Publishing is a few
+// hundred bytes of stores into the mapping: no lock, no system call and no
+// allocation, so it runs on the analysis thread right after featureBus.
+//
+// One thread publishes at a time. open() replaces any object of the same
+// name a crashed run left behind; readers still mapping the old one see it
+// stop beating and reopen.
+class featureShmPublisher{
+    private:
+        std::string name;
+        unsigned char* base;
+        size_t bytes;
+        featureShmHeader* header;
+
+        void writeEvent(const featureShmFrame&, uint32_t kind, float strength, int32_t offset);
+    public:
+        featureShmPublisher();
+        ~featureShmPublisher();
+
+        int open(const char* name = FEATURE_SHM_NAME);
+        void close();
+        bool isOpen();
+        void publish(const featureFrame&);
+};
+
+#endif
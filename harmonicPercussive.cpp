@@ -0,0 +1,167 @@
+#include "harmonicPercussive.h"
+#include "simdKernels.h"
+#include <cmath>
+#include <algorithm>
+
+// Replaces one occurrence of oldValue in the sorted array with newValue,
+// shifting only the elements between the two positions. N > 0 is the
+// array's length known at compile time, so the search and the shifts run
+// against a fixed bound; N = 0 takes any n.
+template <int N>
+static void replaceSorted(float* sorted, int n, float oldValue, float newValue){
+    if (N > 0) {
+        n = N;
+    }
+    int i = (int)(std::lower_bound(sorted, sorted + n, oldValue) - sorted);
+    if (newValue > oldValue) {
+        while (i + 1 < n && sorted[i + 1] < newValue) {
+            sorted[i] = sorted[i + 1];
+            i++;
+        }
+    } else {
+        while (i > 0 && sorted[i - 1] > newValue) {
+            sorted[i] = sorted[i - 1];
+            i--;
+        }
+    }
+    sorted[i] = newValue;
+}
+
+harmonicPercussive::harmonicPercussive(double sampleRate, int fftSize, int hop){
+    this->fftSize = fftSize;
+    this->bins = fftSize / 2 + 1;
+    double binHz = sampleRate / fftSize;
+    this->band[0] = std::min(this->bins, (int)std::ceil(CROSSOVER_LOW_HZ / binHz));
+    this->band[1] = std::min(this->bins, (int)std::ceil(CROSSOVER_HIGH_HZ / binHz));
+
+    double hopSeconds = hop / sampleRate;
+    int frames = std::min(HPSS_MAX_TIME_FRAMES, std::max(3, (int)std::lround(HPSS_TIME_SECONDS / hopSeconds)));
+    this->timeFrames = frames | 1;
+    // The row lengths hops of 2048, 1024 and 512 or less come to at 44.1 kHz
+    switch (this->timeFrames) {
+        case 9: this->replaceTime = replaceSorted<9>; break;
+        case 17: this->replaceTime = replaceSorted<17>; break;
+        case HPSS_MAX_TIME_FRAMES: this->replaceTime = replaceSorted<HPSS_MAX_TIME_FRAMES>; break;
+        default: this->replaceTime = replaceSorted<0>; break;
+    }
+
+    // Padded by half the frequency window on both sides for median9()
+    this->magnitude.assign(this->bins + HPSS_FREQ_BINS - 1, 0.0f);
+    this->freqMedian.assign(this->bins, 0.0f);
+    this->history.resize(this->bins * this->timeFrames);
+    this->sortedTime.resize(this->bins * this->timeFrames);
+
+    this->meanCoeff = 1.0 - std::exp(-hopSeconds / HPSS_MEAN_SECONDS);
+    this->refractoryFrames = std::max(1, (int)std::lround(HPSS_REFRACTORY / hopSeconds));
+    this->reset();
+}
+
+void harmonicPercussive::reset(){
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    std::fill(this->sortedTime.begin(), this->sortedTime.end(), 0.0f);
+    this->historyPos = 0;
+    this->warmup = this->timeFrames / 2 + 1;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        this->mean[b] = 0.0f;
+        this->previous[b] = 0.0f;
+        this->sinceOnset[b] = this->refractoryFrames;
+    }
+}
+
+// Bin k of a half-complex frame, using X[-k] = conj(X[k]) and X[N/2 + j] = conj(X[N/2 - j])
+inline double harmonicPercussive::real(const double* halfComplex, int k){
+    if (k < 0) k = -k;
+    if (k > this->fftSize / 2) k = this->fftSize - k;
+    return halfComplex[k];
+}
+
+inline double harmonicPercussive::imag(const double* halfComplex, int k){
+    int n = this->fftSize;
+    if (k < 0) return -this->imag(halfComplex, -k);
+    if (k > n / 2) return -this->imag(halfComplex, n - k);
+    return (k > 0 && k < n / 2) ? halfComplex[n - k] : 0.0;
+}
+
+// halfComplex is an FFTW_R2HC frame of fftSize samples, one per hop.
+void harmonicPercussive::process(const double* halfComplex, hpssResult* result){
+    // The analyzer's FFT is unwindowed; apply a Hann window here as the
+    // three-tap convolution 0.5 X[k] - 0.25 (X[k-1] + X[k+1]) so leakage from
+    // strong low notes does not smear across the spectrum and read as
+    // broadband (percussive) energy. Scaled so a sine reads as its amplitude.
+    int n = this->fftSize;
+    float scale = 4.0f / n;
+    int half = HPSS_FREQ_BINS / 2;
+    float* mag = &this->magnitude[half];
+    for (int k = 0; k <= n / 2; k++) {
+        double re, im;
+        if (k >= 2 && k <= n / 2 - 2) {
+            // Neither neighbour needs mirroring
+            re = 0.5 * halfComplex[k] - 0.25 * (halfComplex[k - 1] + halfComplex[k + 1]);
+            im = 0.5 * halfComplex[n - k] - 0.25 * (halfComplex[n - k + 1] + halfComplex[n - k - 1]);
+        } else {
+            re = 0.5 * this->real(halfComplex, k) - 0.25 * (this->real(halfComplex, k - 1) + this->real(halfComplex, k + 1));
+            im = 0.5 * this->imag(halfComplex, k) - 0.25 * (this->imag(halfComplex, k - 1) + this->imag(halfComplex, k + 1));
+        }
+        mag[k] = std::sqrt(re * re + im * im) * scale;
+    }
+
+    // Percussive estimates for every bin in one pass over the frame, edges
+    // replicated into the padding
+    for (int i = 1; i <= half; i++) {
+        mag[-i] = mag[0];
+        mag[this->bins - 1 + i] = mag[this->bins - 1];
+    }
+    static_assert(HPSS_FREQ_BINS == 9, "the percussive median is the median9() kernel");
+    median9(&this->magnitude[0], &this->freqMedian[0], this->bins);
+
+    float harmonic[NUM_BANDS] = {0.0f, 0.0f, 0.0f};
+    float percussive[NUM_BANDS] = {0.0f, 0.0f, 0.0f};
+    int bandIndex = BAND_LOW;
+    for (int k = 0; k < this->bins; k++) {
+        float* row = &this->sortedTime[k * this->timeFrames];
+        float* past = &this->history[k * this->timeFrames];
+        this->replaceTime(row, this->timeFrames, past[this->historyPos], mag[k]);
+        past[this->historyPos] = mag[k];
+
+        float h = row[this->timeFrames / 2];
+        float p = this->freqMedian[k];
+
+        while (bandIndex < BAND_HIGH && k >= this->band[bandIndex]) {
+            bandIndex++;
+        }
+        if (k == 0) {
+            continue; // DC carries no musical content
+        }
+        float hh = h * h, pp = p * p;
+        float total = hh + pp;
+        if (total <= 0.0f) {
+            continue;
+        }
+        float energy = mag[k] * mag[k];
+        harmonic[bandIndex] += energy * hh / total;
+        percussive[bandIndex] += energy * pp / total;
+    }
+    this->historyPos = (this->historyPos + 1) % this->timeFrames;
+    if (this->warmup > 0) {
+        this->warmup--;
+    }
+
+    // Onsets: percussive energy jumping well above its own recent level and
+    // making up a real part of the band, not just leakage around a held note
+    for (int b = 0; b < NUM_BANDS; b++) {
+        float e = percussive[b];
+        bool onset = this->warmup == 0
+            && e > HPSS_ONSET_FLOOR
+            && e > HPSS_ONSET_SHARE * (e + harmonic[b])
+            && e > HPSS_ONSET_RATIO * this->mean[b]
+            && e > this->previous[b]
+            && this->sinceOnset[b] >= this->refractoryFrames;
+        this->sinceOnset[b] = onset ? 1 : this->sinceOnset[b] + 1;
+        this->mean[b] += this->meanCoeff * (e - this->mean[b]);
+        this->previous[b] = e;
+
+        result->harmonic[b] = harmonic[b];
+        result->percussive[b] = e;
+        result->onset[b] = onset;
+    }
+}
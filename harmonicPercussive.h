@@ -0,0 +1,66 @@
+#ifndef HARMONICPERCUSSIVE_H
+#define HARMONICPERCUSSIVE_H
+
+#include <vector>
+#include "transientDetector.h" // Band layout and crossover frequencies
+
+#define HPSS_TIME_SECONDS 0.4 // Harmonic median length (17 frames at a 1024 sample hop)
+#define HPSS_MAX_TIME_FRAMES 33 // ...but never more frames than this, which bounds the cost at small hops
+#define HPSS_FREQ_BINS 9      // Percussive median length in FFT bins (~390 Hz at 43 Hz bins); fixed by median9()
+#define HPSS_ONSET_RATIO 2.0  // Percussive energy over its running mean that counts as an onset
+#define HPSS_ONSET_FLOOR 1e-4 // Ignore percussive energy below this (amplitude^2)
+#define HPSS_ONSET_SHARE 0.3  // ...or below this fraction of the band (held low notes leak some)
+#define HPSS_MEAN_SECONDS 0.25 // Time constant of that running mean
+#define HPSS_REFRACTORY 0.09  // Minimum seconds between onsets in one band
+
+// Split of one FFT frame into harmonic and percussive parts, per band
+typedef struct {
+    float harmonic[NUM_BANDS];   // Energy (amplitude^2) of the sustained component
+    float percussive[NUM_BANDS]; // Energy of the broadband/transient component
+    bool onset[NUM_BANDS];       // Percussive onset in this frame
+} hpssResult;
+
+// Streaming harmonic/percussive separation on the analyzer's FFT frames
+// (Fitzgerald's median filtering). A sustained tone is steady across time
+// but narrow in frequency, a drum hit is the opposite, so per bin:
+//   harmonic estimate   = median of the bin over the last HPSS_TIME_SECONDS
+//   percussive estimate = median of the frame over HPSS_FREQ_BINS neighbouring bins
+// and soft (Wiener) masks built from the two split the bin's energy.
+// The time median is causal so nothing waits on future frames.
+//
+// The time median is kept incrementally: each bin's window is held sorted
+// and a new frame replaces one value in place, O(window) per bin instead of
+// a sort, specialised for the row lengths of the common hops. The frequency
+// median is a fixed median-of-9 network run across the frame a register of
+// bins at a time (median9() in simdKernels).
+class harmonicPercussive{
+    private:
+        int fftSize;
+        int bins;
+        int band[2];                    // First bin of the mid and high bands
+
+        std::vector<float> magnitude;   // Current frame, edge-padded for the frequency median
+        int timeFrames;                 // Odd, so the median is one element
+        std::vector<float> history;     // bins x timeFrames ring of past magnitudes
+        std::vector<float> sortedTime;  // Same values, each row kept sorted
+        void (*replaceTime)(float*, int, float, float); // Row update, specialised for the row length
+        int historyPos;
+        int warmup;                     // Frames until the time medians are meaningful
+        std::vector<float> freqMedian;  // Percussive estimate per bin of the current frame
+
+        float meanCoeff;
+        int refractoryFrames;
+        float mean[NUM_BANDS];
+        float previous[NUM_BANDS];
+        int sinceOnset[NUM_BANDS];
+
+        inline double real(const double*, int);
+        inline double imag(const double*, int);
+    public:
+        harmonicPercussive(double sampleRate, int fftSize, int hop);
+
+        void reset();
+        void process(const double* halfComplex, hpssResult*);
+};
+
+#endif
@@ -1,15 +1,12 @@
 const char* fragmentShaderSource2 = R"(
 #version 330 core
 out vec4 FragColor;
-uniform vec2 u_resolution;
-uniform vec2 u_offset;
-uniform float u_zoom;
-uniform vec2 u_c;
-const int MAX_ITER = 200;
-const int NUM_SAMPLES = 4; // Ensure this matches your supersampling setup
-uniform float c_parameter_r;
-uniform float c_parameter_g;
-uniform float c_parameter_b;
+#ifndef MAX_ITER
+#define MAX_ITER 200
+#endif
+#ifndef NUM_SAMPLES
+#define NUM_SAMPLES 4 // Ensure this matches your supersampling setup
+#endif
 
 int julia(vec2 z) {
     int iterations = 0;
@@ -37,7 +34,7 @@ void main() {
     //     vec2(-0.125, 0.125), vec2(0.125, 0.125),
     //     vec2(-0.375, 0.375), vec2(0.375, 0.375)
     // );
-    vec2 offsets[NUM_SAMPLES] = vec2[](
+    vec2 offsets[4] = vec2[](
         vec2(-0.25, -0.25), vec2(0.25, -0.25),
         vec2(-0.25, 0.25), vec2(0.25, 0.25)
     );
@@ -1,17 +1,12 @@
 const char* fragmentShaderSource6 = R"(
 #version 330 core
 out vec4 FragColor;
-uniform vec2 u_resolution;
-uniform vec2 u_offset;
-uniform float u_zoom;
-uniform vec2 u_c;
-const int MAX_ITER = 200;
-const int NUM_SAMPLES = 4;
-uniform float c_parameter_r;
-uniform float c_parameter_g;
-uniform float c_parameter_b;
-uniform float amplitude;
-uniform float continuous_time;
+#ifndef MAX_ITER
+#define MAX_ITER 200
+#endif
+#ifndef NUM_SAMPLES
+#define NUM_SAMPLES 4
+#endif
 
 float hash1( float n ) { return fract(sin(n)*43758.5453); }
 vec2  hash2( vec2  p ) { 
@@ -114,7 +109,7 @@ void main() {
     col *= smoothstep(0.003, 0.005, abs(p.x - c))/2;
     col = pow(col, vec3(2.0)); // Apply gamma correction to intensify color differences
     // Supersampling offsets
-    vec2 offsets[NUM_SAMPLES] = vec2[](
+    vec2 offsets[4] = vec2[](
         vec2(-0.25, -0.25), vec2(0.25, -0.25),
         vec2(-0.25, 0.25), vec2(0.25, 0.25)
     );
@@ -2,18 +2,8 @@ const char* fragmentShaderSource5 = R"(
 #version 330 core
 
 out vec4 FragColor;
-uniform vec2 u_resolution;
-uniform vec2 u_offset;
-uniform float u_zoom;
-uniform vec2 u_c;
 const int MAX_ITER = 2000;
 const int NUM_SAMPLES = 4;
-uniform float c_parameter_r;
-uniform float c_parameter_g;
-uniform float c_parameter_b;
-uniform float amplitude;
-uniform float u_time;
-uniform float continuous_time;
 
 float hash1( float n ) { return fract(sin(n)*43758.5453); }
 vec2  hash2( vec2  p ) { 
@@ -0,0 +1,263 @@
+#include "logger.h"
+#include "spscRing.h"
+#include <string.h>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <vector>
+#include <algorithm>
+
+typedef struct {
+    spscRing<logRecord>* ring;
+    std::atomic<bool> owned;      // False once the writing thread has exited
+} logThreadRing;
+
+// Registered rings only ever grow in number; a ring whose thread exited is
+// handed to the next new thread, which carries on producing after the
+// records still queued in it (there is still only one producer at a time)
+static logThreadRing threadRings[LOG_MAX_THREADS];
+static std::atomic<int> ringCount(0);
+static std::mutex registerLock;
+
+static std::atomic<unsigned long long> dropped(0);
+static std::atomic<bool> running(false);
+static std::thread* flusher = NULL;     // Never destroyed while running, so exit() with it live is fine
+static FILE* output = stdout;
+static long long startNs = logNow();
+
+std::atomic<int> logThreshold(LOG_LEVEL_INFO);
+
+// Ties a ring to the thread using it and gives it back when the thread exits
+typedef struct logThreadSlot {
+    logThreadRing* slot;
+    bool failed;                  // Registration already failed, don't retry on every call
+    logThreadSlot(){ this->slot = NULL; this->failed = false; }
+    ~logThreadSlot(){
+        if (this->slot != NULL) {
+            this->slot->owned.store(false, std::memory_order_release);
+        }
+    }
+} logThreadSlot;
+
+static thread_local logThreadSlot current;
+
+long long logNow(){
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Only on a thread's first record, so the lock and allocation stay off the hot path after that
+static logThreadRing* registerThread(){
+    std::lock_guard<std::mutex> lock(registerLock);
+    int count = ringCount.load(std::memory_order_relaxed);
+    for (int i = 0; i < count; i++) {
+        if (!threadRings[i].owned.load(std::memory_order_acquire)) {
+            threadRings[i].owned.store(true, std::memory_order_relaxed);
+            return &threadRings[i];
+        }
+    }
+    if (count == LOG_MAX_THREADS) {
+        return NULL;
+    }
+    threadRings[count].ring = new spscRing<logRecord>(LOG_RING_RECORDS);
+    threadRings[count].owned.store(true, std::memory_order_relaxed);
+    ringCount.store(count + 1, std::memory_order_release);
+    return &threadRings[count];
+}
+
+// The calling thread's next free record, or NULL (counted as dropped) if its ring is full
+logRecord* logClaim(){
+    if (current.slot == NULL) {
+        if (current.failed) {
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+        current.slot = registerThread();
+        if (current.slot == NULL) {
+            current.failed = true;
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return NULL;
+        }
+    }
+    logRecord* record = current.slot->ring->claim();
+    if (record == NULL) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+    }
+    return record;
+}
+
+void logCommit(){
+    current.slot->ring->commit();
+}
+
+// Appends one printf conversion. Integer conversions are rewritten to take
+// a long long and mismatched argument types are converted, so a record can
+// never make snprintf read the wrong type.
+static int formatArgument(const logRecord* record, int index, const char* spec, int specLength, char conversion, char* out, size_t size){
+    char format[32];
+    int length = 0;
+    // Flags, width and precision; length modifiers are dropped
+    for (int i = 0; i < specLength && length < 24; i++) {
+        if (strchr("hlLqjzt", spec[i]) == NULL) {
+            format[length++] = spec[i];
+        }
+    }
+    if (index >= record->count) {
+        return snprintf(out, size, "%.*s%c", specLength, spec, conversion);
+    }
+    int type = record->types[index];
+    const logArg& arg = record->args[index];
+
+    if (strchr("diouxXc", conversion) != NULL) {
+        long long value = type == LOG_ARG_DOUBLE ? (long long)arg.d : arg.i;
+        if (conversion == 'c') {
+            format[length++] = 'c';
+            format[length] = '\0';
+            return snprintf(out, size, format, (int)value);
+        }
+        format[length++] = 'l';
+        format[length++] = 'l';
+        format[length++] = conversion;
+        format[length] = '\0';
+        return snprintf(out, size, format, value);
+    }
+    if (strchr("fFeEgGaA", conversion) != NULL) {
+        double value = type == LOG_ARG_DOUBLE ? arg.d : (double)arg.i;
+        format[length++] = conversion;
+        format[length] = '\0';
+        return snprintf(out, size, format, value);
+    }
+    format[length++] = conversion;
+    format[length] = '\0';
+    if (conversion == 's') {
+        return snprintf(out, size, format, type == LOG_ARG_TEXT ? &record->text[arg.i] : "?");
+    }
+    if (conversion == 'p') {
+        return snprintf(out, size, format, type == LOG_ARG_POINTER ? arg.p : NULL);
+    }
+    return snprintf(out, size, "%.*s%c", specLength, spec, conversion);
+}
+
+// One line: seconds since the program started, level, message, newline
+static void formatRecord(const logRecord* record, std::vector<char>& out){
+    static const char levels[] = {'D', 'I', 'W', 'E'};
+    char line[1024];
+    size_t used = snprintf(line, sizeof(line), "[%9.3f] %c ",
+        (record->timeNs - startNs) / 1e9, levels[std::min<int>(record->level, LOG_LEVEL_ERROR)]);
+
+    int index = 0;
+    const char* p = record->format;
+    while (*p != '\0' && used < sizeof(line) - 1) {
+        if (*p != '%') {
+            line[used++] = *p++;
+            continue;
+        }
+        p++;
+        if (*p == '%') {
+            line[used++] = *p++;
+            continue;
+        }
+        const char* spec = p - 1;
+        while (*p != '\0' && strchr("-+ #0123456789.hlLqjzt", *p) != NULL) {
+            p++;
+        }
+        if (*p == '\0') {
+            break;
+        }
+        int written = formatArgument(record, index++, spec, (int)(p - spec), *p, &line[used], sizeof(line) - used);
+        p++;
+        if (written > 0) {
+            used = std::min(used + written, sizeof(line) - 1);
+        }
+    }
+    // Messages carry their own newline as printf's did; add one if not
+    if (used == 0 || line[used - 1] != '\n') {
+        line[used < sizeof(line) - 1 ? used++ : used - 1] = '\n';
+    }
+    out.insert(out.end(), line, line + used);
+}
+
+// Empties every ring and writes the records in time order across threads, in one go
+static void flushRings(){
+    static std::vector<logRecord> pending;
+    static std::vector<char> text;
+    pending.clear();
+    int count = ringCount.load(std::memory_order_acquire);
+    for (int r = 0; r < count; r++) {
+        spscRing<logRecord>* ring = threadRings[r].ring;
+        logRecord* record;
+        while ((record = ring->front()) != NULL) {
+            pending.push_back(*record);
+            ring->release();
+        }
+    }
+    unsigned long long lost = dropped.exchange(0, std::memory_order_relaxed);
+    if (pending.empty() && lost == 0) {
+        return;
+    }
+    std::stable_sort(pending.begin(), pending.end(),
+        [](const logRecord& a, const logRecord& b){ return a.timeNs < b.timeNs; });
+    text.clear();
+    for (size_t i = 0; i < pending.size(); i++) {
+        formatRecord(&pending[i], text);
+    }
+    fwrite(text.data(), 1, text.size(), output);
+    if (lost > 0) {
+        fprintf(output, "[%9.3f] W logger: %llu records dropped (ring full)\n", (logNow() - startNs) / 1e9, lost);
+    }
+    fflush(output);
+}
+
+static void flushLoop(){
+    while (running.load(std::memory_order_acquire)) {
+        flushRings();
+        std::this_thread::sleep_for(std::chrono::milliseconds(LOG_FLUSH_MS));
+    }
+    flushRings();
+}
+
+// Starts the background thread writing to `sink`. Records logged before
+// this wait in their rings (and are dropped once those fill).
+int logStart(FILE* sink){
+    if (running.load()) {
+        return 1;
+    }
+    output = sink != NULL ? sink : stdout;
+    running.store(true);
+    flusher = new std::thread(flushLoop);
+    return 1;
+}
+
+// Writes out whatever is still queued and stops the background thread
+void logStop(){
+    if (!running.exchange(false)) {
+        return;
+    }
+    flusher->join();
+    delete flusher;
+    flusher = NULL;
+}
+
+void logSetLevel(int level){
+    logThreshold.store(level, std::memory_order_relaxed);
+}
+
+// Records lost to full rings that have not been reported yet
+unsigned long long logDropped(){
+    return dropped.load(std::memory_order_relaxed);
+}
+
+logLimiter::logLimiter(double seconds){
+    this->intervalNs = (long long)(seconds * 1e9);
+    this->next.store(0);
+}
+
+bool logLimiter::allow(){
+    long long now = logNow();
+    long long due = this->next.load(std::memory_order_relaxed);
+    if (now < due) {
+        return false;
+    }
+    // Whoever moves the deadline first gets to log
+    return this->next.compare_exchange_strong(due, now + this->intervalNs, std::memory_order_relaxed);
+}
@@ -0,0 +1,162 @@
+#ifndef LOGGER_H
+#define LOGGER_H
+
+#include <stdio.h>
+#include <atomic>
+
+#define LOG_MAX_ARGS 6          // Arguments one record carries; more are dropped
+#define LOG_TEXT_BYTES 64       // Room for copies of %s arguments, per record
+#define LOG_RING_RECORDS 512    // Per thread; a full ring drops new records
+#define LOG_MAX_THREADS 32      // Threads with a ring at once (a ring is reused after its thread exits)
+#define LOG_FLUSH_MS 20         // How often the background thread drains the rings
+
+enum {
+    LOG_LEVEL_DEBUG = 0,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_WARN,
+    LOG_LEVEL_ERROR
+};
+
+enum {
+    LOG_ARG_INT = 0,
+    LOG_ARG_DOUBLE,
+    LOG_ARG_TEXT,
+    LOG_ARG_POINTER
+};
+
+typedef union {
+    long long i;
+    double d;
+    const void* p;
+} logArg;
+
+// One log call as recorded by the calling thread: the format is kept by
+// pointer (it must be a string literal), numbers by value and strings as
+// copies, so nothing is formatted until the background thread gets to it.
+typedef struct {
+    long long timeNs;                 // steady_clock
+    const char* format;
+    unsigned char level;
+    unsigned char count;
+    unsigned char textUsed;
+    unsigned char types[LOG_MAX_ARGS];
+    logArg args[LOG_MAX_ARGS];        // LOG_ARG_TEXT holds an offset into text
+    char text[LOG_TEXT_BYTES];
+} logRecord;
+
+// Logging that is safe from the audio callback and the render loop. Each
+// thread writes binary records into its own lock-free ring (the first call
+// from a thread registers the ring, every later call is a level check, a
+// few stores and no system call). A background thread started by logStart()
+// merges the rings in time order, formats them printf-style and writes
+// them out, so no hot path ever waits on a terminal or file. When a ring is
+// full the record is dropped and counted instead.
+//
+//   logInfo("Capturing device %d at %.0f Hz", device, rate);
+//   LOG_EVERY(1.0, LOG_LEVEL_DEBUG, "amp %f", amp);   // At most once a second
+int logStart(FILE* sink = stdout);
+void logStop();
+void logSetLevel(int level);
+unsigned long long logDropped();
+
+logRecord* logClaim();
+void logCommit();
+long long logNow();
+
+extern std::atomic<int> logThreshold;
+
+inline void logPackArg(logRecord* record, long long value){
+    if (record->count < LOG_MAX_ARGS) {
+        record->types[record->count] = LOG_ARG_INT;
+        record->args[record->count++].i = value;
+    }
+}
+inline void logPackArg(logRecord* record, int value){ logPackArg(record, (long long)value); }
+inline void logPackArg(logRecord* record, unsigned value){ logPackArg(record, (long long)value); }
+inline void logPackArg(logRecord* record, long value){ logPackArg(record, (long long)value); }
+inline void logPackArg(logRecord* record, unsigned long value){ logPackArg(record, (long long)value); }
+inline void logPackArg(logRecord* record, unsigned long long value){ logPackArg(record, (long long)value); }
+inline void logPackArg(logRecord* record, bool value){ logPackArg(record, (long long)value); }
+inline void logPackArg(logRecord* record, double value){
+    if (record->count < LOG_MAX_ARGS) {
+        record->types[record->count] = LOG_ARG_DOUBLE;
+        record->args[record->count++].d = value;
+    }
+}
+inline void logPackArg(logRecord* record, const void* value){
+    if (record->count < LOG_MAX_ARGS) {
+        record->types[record->count] = LOG_ARG_POINTER;
+        record->args[record->count++].p = value;
+    }
+}
+// Strings are copied (truncated to what is left of the text area)
+inline void logPackArg(logRecord* record, const char* value){
+    if (record->count >= LOG_MAX_ARGS) {
+        return;
+    }
+    int start = record->textUsed;
+    int end = start;
+    while (value != NULL && value[end - start] != '\0' && end < LOG_TEXT_BYTES - 1) {
+        record->text[end] = value[end - start];
+        end++;
+    }
+    record->text[end] = '\0';
+    record->textUsed = end < LOG_TEXT_BYTES - 1 ? end + 1 : end;
+    record->types[record->count] = LOG_ARG_TEXT;
+    record->args[record->count++].i = start;
+}
+inline void logPackArg(logRecord* record, char* value){ logPackArg(record, (const char*)value); }
+
+inline void logPackArgs(logRecord*){}
+
+template <typename T, typename... Rest>
+inline void logPackArgs(logRecord* record, T first, Rest... rest){
+    logPackArg(record, first);
+    logPackArgs(record, rest...);
+}
+
+template <typename... Args>
+void logWrite(int level, const char* format, Args... args){
+    if (level < logThreshold.load(std::memory_order_relaxed)) {
+        return;
+    }
+    logRecord* record = logClaim();
+    if (record == NULL) {
+        return;
+    }
+    record->timeNs = logNow();
+    record->format = format;
+    record->level = (unsigned char)level;
+    record->count = 0;
+    record->textUsed = 0;
+    logPackArgs(record, args...);
+    logCommit();
+}
+
+template <typename... Args>
+void logDebug(const char* format, Args... args){ logWrite(LOG_LEVEL_DEBUG, format, args...); }
+template <typename... Args>
+void logInfo(const char* format, Args... args){ logWrite(LOG_LEVEL_INFO, format, args...); }
+template <typename... Args>
+void logWarn(const char* format, Args... args){ logWrite(LOG_LEVEL_WARN, format, args...); }
+template <typename... Args>
+void logError(const char* format, Args... args){ logWrite(LOG_LEVEL_ERROR, format, args...); }
+
+// Lets one call site through at most once per `seconds`, from any thread
+class logLimiter{
+    private:
+        long long intervalNs;
+        std::atomic<long long> next;
+    public:
+        logLimiter(double seconds);
+        bool allow();
+};
+
+#define LOG_EVERY(seconds, level, ...) do { \
+        static logLimiter logEveryLimiter(seconds); \
+        if (level >= logThreshold.load(std::memory_order_relaxed) && logEveryLimiter.allow()) { \
+            logWrite(level, __VA_ARGS__); \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,174 @@
+#include "loudnessMeter.h"
+#include "simdKernels.h"
+#include <cmath>
+#include <algorithm>
+
+// BS.1770 K-weighting stages, re-derived for any sample rate from the
+// analogue prototypes behind the 48 kHz coefficients in the standard. The
+// RBJ designs in biquad.cpp have a slightly different shelf shape, which
+// reads a quarter dB low at 1 kHz.
+static biquadCoeffs kWeightingShelf(double sampleRate){
+    const double f0 = 1681.974450955533, gainDb = 3.999843853973347, q = 0.7071752369554196;
+    double k = std::tan(M_PI * f0 / sampleRate);
+    double vh = std::pow(10.0, gainDb / 20.0);
+    double vb = std::pow(vh, 0.4996667741545416);
+    double a0 = 1.0 + k / q + k * k;
+    biquadCoeffs c;
+    c.b0 = (vh + vb * k / q + k * k) / a0;
+    c.b1 = 2.0 * (k * k - vh) / a0;
+    c.b2 = (vh - vb * k / q + k * k) / a0;
+    c.a1 = 2.0 * (k * k - 1.0) / a0;
+    c.a2 = (1.0 - k / q + k * k) / a0;
+    return c;
+}
+
+static biquadCoeffs kWeightingHighpass(double sampleRate){
+    const double f0 = 38.13547087602444, q = 0.5003270373238773;
+    double k = std::tan(M_PI * f0 / sampleRate);
+    double a0 = 1.0 + k / q + k * k;
+    biquadCoeffs c;
+    c.b0 = 1.0f;
+    c.b1 = -2.0f;
+    c.b2 = 1.0f;
+    c.a1 = 2.0 * (k * k - 1.0) / a0;
+    c.a2 = (1.0 - k / q + k * k) / a0;
+    return c;
+}
+
+loudnessMeter::loudnessMeter(double sampleRate){
+    // Lane 0 is the +4 dB shelf, lane 1 the RLB high-pass fed by lane 0's
+    // previous output (one sample of latency buys both stages in one biquad4)
+    this->kWeighting.setLane(0, kWeightingShelf(sampleRate));
+    this->kWeighting.setLane(1, kWeightingHighpass(sampleRate));
+
+    this->subblockSamples = std::max(1, (int)std::lround(LOUDNESS_SUBBLOCK * sampleRate));
+    this->momentaryBlocks = (int)std::lround(LOUDNESS_MOMENTARY / LOUDNESS_SUBBLOCK);
+    this->shortBlocks = (int)std::lround(LOUDNESS_SHORT_TERM / LOUDNESS_SUBBLOCK);
+    this->weightedRing.resize(this->shortBlocks);
+    this->plainRing.resize(this->momentaryBlocks);
+    this->peakRing.resize(this->momentaryBlocks);
+    this->reset();
+}
+
+void loudnessMeter::reset(){
+    this->kWeighting.reset();
+    this->shelfPipe = 0.0f;
+    this->subblockFill = 0;
+    this->weightedAcc = 0.0;
+    this->plainAcc = 0.0;
+    this->peakAcc = 0.0f;
+    std::fill(this->weightedRing.begin(), this->weightedRing.end(), 0.0);
+    std::fill(this->plainRing.begin(), this->plainRing.end(), 0.0);
+    std::fill(this->peakRing.begin(), this->peakRing.end(), 0.0f);
+    this->shortPos = 0;
+    this->momentaryPos = 0;
+    this->momentarySum = 0.0;
+    this->shortSum = 0.0;
+    this->plainSum = 0.0;
+
+    this->current.momentary = LOUDNESS_SILENCE;
+    this->current.shortTerm = LOUDNESS_SILENCE;
+    this->current.rms = 0.0f;
+    this->current.peak = 0.0f;
+    this->current.crestFactor = 0.0f;
+    this->current.energy = 0.0f;
+}
+
+static float toLufs(double meanSquare){
+    return meanSquare > 1e-10 ? (float)(-0.691 + 10.0 * std::log10(meanSquare)) : (float)LOUDNESS_SILENCE;
+}
+
+// Slides both windows forward by one sub-block and refreshes the readings
+void loudnessMeter::finishSubblock(){
+    // The sub-block leaving the momentary window sits momentaryBlocks behind
+    // the one being written in the short-term ring
+    int leaving = (this->shortPos - this->momentaryBlocks + this->shortBlocks) % this->shortBlocks;
+    this->momentarySum += this->weightedAcc - this->weightedRing[leaving];
+    this->shortSum += this->weightedAcc - this->weightedRing[this->shortPos];
+    this->weightedRing[this->shortPos] = this->weightedAcc;
+    this->shortPos = (this->shortPos + 1) % this->shortBlocks;
+
+    this->plainSum += this->plainAcc - this->plainRing[this->momentaryPos];
+    this->plainRing[this->momentaryPos] = this->plainAcc;
+    this->peakRing[this->momentaryPos] = this->peakAcc;
+    this->momentaryPos = (this->momentaryPos + 1) % this->momentaryBlocks;
+
+    // Running sums can drift a hair below zero after long silences
+    this->momentarySum = std::max(0.0, this->momentarySum);
+    this->shortSum = std::max(0.0, this->shortSum);
+    this->plainSum = std::max(0.0, this->plainSum);
+
+    double momentarySamples = (double)this->momentaryBlocks * this->subblockSamples;
+    double shortSamples = (double)this->shortBlocks * this->subblockSamples;
+    loudnessResult& r = this->current;
+    r.momentary = toLufs(this->momentarySum / momentarySamples);
+    r.shortTerm = toLufs(this->shortSum / shortSamples);
+    r.rms = (float)std::sqrt(this->plainSum / momentarySamples);
+    r.peak = *std::max_element(this->peakRing.begin(), this->peakRing.end());
+    r.crestFactor = r.rms > 1e-6f && r.peak > 0.0f ? 20.0f * std::log10(r.peak / r.rms) : 0.0f;
+    r.energy = (float)std::min(1.0, std::max(0.0, (r.momentary - LOUDNESS_ENERGY_FLOOR) / -LOUDNESS_ENERGY_FLOOR));
+
+    this->weightedAcc = 0.0;
+    this->plainAcc = 0.0;
+    this->peakAcc = 0.0f;
+    this->subblockFill = 0;
+}
+
+// Readings change once per finished sub-block; the result reflects the
+// newest one at the end of the buffer.
+void loudnessMeter::process(const float* in, unsigned long frames, loudnessResult* result){
+    typedef void (loudnessMeter::*blockKernel)(const float*, unsigned long);
+    static const blockKernel kernels[] = SIZED_KERNELS(&loudnessMeter::processBlock);
+    (this->*kernels[sizeSlot((int)frames)])(in, frames);
+    *result = this->current;
+}
+
+// The filter and the sub-block sums stay in locals, handed to the members
+// only when a sub-block finishes and at the end of the block
+template <int N>
+void loudnessMeter::processBlock(const float* in, unsigned long frames){
+    const unsigned long count = N > 0 ? N : frames;
+    double weightedAcc = this->weightedAcc;
+    double plainAcc = this->plainAcc;
+    float peakAcc = this->peakAcc;
+    int subblockFill = this->subblockFill;
+    float shelfPipe = this->shelfPipe;
+#if defined(__SSE2__)
+    biquad4::lanes kWeighting = this->kWeighting.load();
+#endif
+    for (unsigned long i = 0; i < count; i++) {
+        float x = in[i];
+        float weighted;
+#if defined(__SSE2__)
+        __m128 y = kWeighting.process(_mm_set_ps(0.0f, 0.0f, shelfPipe, x));
+        shelfPipe = _mm_cvtss_f32(y);
+        weighted = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(1, 1, 1, 1)));
+#else
+        float lanesIn[4] = {x, shelfPipe, 0.0f, 0.0f};
+        float lanesOut[4];
+        this->kWeighting.process(lanesIn, lanesOut);
+        shelfPipe = lanesOut[0];
+        weighted = lanesOut[1];
+#endif
+        weightedAcc += weighted * weighted;
+        plainAcc += x * x;
+        peakAcc = std::max(peakAcc, std::fabs(x));
+        if (++subblockFill == this->subblockSamples) {
+            this->weightedAcc = weightedAcc;
+            this->plainAcc = plainAcc;
+            this->peakAcc = peakAcc;
+            this->finishSubblock();
+            weightedAcc = plainAcc = 0.0;
+            peakAcc = 0.0f;
+            subblockFill = 0;
+        }
+    }
+#if defined(__SSE2__)
+    this->kWeighting.store(kWeighting);
+#endif
+    this->weightedAcc = weightedAcc;
+    this->plainAcc = plainAcc;
+    this->peakAcc = peakAcc;
+    this->subblockFill = subblockFill;
+    this->shelfPipe = shelfPipe;
+}
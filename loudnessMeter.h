@@ -0,0 +1,63 @@
+#ifndef LOUDNESSMETER_H
+#define LOUDNESSMETER_H
+
+#include <vector>
+#include "biquad.h"
+
+#define LOUDNESS_SUBBLOCK 0.010      // Seconds per accumulated sub-block
+#define LOUDNESS_MOMENTARY 0.4       // EBU R128 momentary window (seconds)
+#define LOUDNESS_SHORT_TERM 3.0      // EBU R128 short-term window (seconds)
+#define LOUDNESS_SILENCE -100.0      // Reported instead of -inf LUFS
+#define LOUDNESS_ENERGY_FLOOR -60.0  // Momentary LUFS that maps to energy 0 (0 LUFS maps to 1)
+
+typedef struct {
+    float momentary;   // K-weighted loudness over the last 400 ms (LUFS)
+    float shortTerm;   // ...over the last 3 s (LUFS)
+    float rms;         // Unweighted RMS over the momentary window
+    float peak;        // Largest absolute sample over the momentary window
+    float crestFactor; // peak / rms in dB, 0 when silent
+    float energy;      // Momentary loudness mapped onto [0, 1]
+} loudnessResult;
+
+// Streaming loudness in the style of EBU R128 / ITU-R BS.1770 for one channel.
+// The K-weighting filter (high shelf + RLB high-pass) runs as two lanes of a
+// biquad4, the high-pass lane pipelined one sample behind the shelf. Squared
+// samples are summed into 10 ms sub-blocks, and the 400 ms and 3 s windows
+// are running sums over a ring of those, so each window costs O(1) per
+// sub-block no matter how long it is. Blocks of the analyzer's common hop
+// sizes run a loop specialised for that size (SIZED_KERNELS).
+class loudnessMeter{
+    private:
+        biquad4 kWeighting;
+        float shelfPipe;   // Shelf output carried into the next sample's high-pass lane
+
+        int subblockSamples;
+        int subblockFill;
+        double weightedAcc;
+        double plainAcc;
+        float peakAcc;
+
+        // Rings of finished sub-blocks; each position is the next slot to overwrite
+        std::vector<double> weightedRing;   // Short-term window worth
+        std::vector<double> plainRing;      // Momentary window worth
+        std::vector<float> peakRing;        // Momentary window worth
+        int shortBlocks;
+        int momentaryBlocks;
+        int shortPos;
+        int momentaryPos;
+        double momentarySum;
+        double shortSum;
+        double plainSum;
+
+        loudnessResult current;
+
+        void finishSubblock();
+        template <int N> void processBlock(const float*, unsigned long);
+    public:
+        loudnessMeter(double sampleRate);
+
+        void reset();
+        void process(const float*, unsigned long, loudnessResult*);
+};
+
+#endif
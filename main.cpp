@@ -2,9 +2,19 @@
 #include <GLFW/glfw3.h> // For GLFW window and input handling
 #include <iostream>
 #include "audioAnalyzer.h"
+#include "deviceManager.h"
+#include "logger.h"
+#include "shaderParams.h"
+#include "shaderLibrary.h"
+#include "sceneManager.h"
+#include "resolutionScaler.h"
+#include "shaderQuality.h"
 #include <ctime>    // For time()
 #include <thread>
 #include <chrono>
+#include <atomic>
+#include <string>
+#include <vector>
 #include "juliaChill.h"
 #include "juliaTrippy.h"
 #include "juliaNoisy.h"
@@ -18,6 +28,11 @@
 #define RESOLUTION_W 2560
 #define RESOLUTION_H 1080
 #define RESOLUTION_F 1920.0f
+#define DEFAULT_SCENE "menger"
+#define SHADER_FILE "shader/fragment.glsl" // Scene "fragment", reloaded whenever it is saved
+#define THREAD_CONFIG "threads.conf" // Optional thread placement (see threadPlacement.h)
+#define JITTER_REPORT_FRAMES 600     // Frames between scheduling jitter reports
+#define TRACE_SECONDS 1.0            // Shortest gap between repeats of a per-frame debug line
 const float swayAmplitude = 100.0f; // Controls how much the stars sway left and right
 const float swayFrequency = 0.5f;   // Controls how fast the sway oscillates
 
@@ -38,25 +53,93 @@ void threadFunction(audioAnalyzer* anal) {
     }
 }
 
-// Check for shader compile errors
-void checkShaderCompileError(GLuint shader) {
-    GLint success;
-    GLchar infoLog[512];
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (!success) {
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        std::cerr << "ERROR::SHADER::COMPILATION_FAILED\n" << infoLog << std::endl;
+// The same with raw PCM from a pipe instead of a device, until the writer is done
+void pipeThreadFunction(audioAnalyzer* anal, pcmPipe* input, std::atomic<bool>* done) {
+    while (anal->initAnalysis() && anal->startPipeSession(30, input)) {
     }
+    logInfo("Pipe input ended, %llu buffers arrived late", input->underruns());
+    done->store(true);
 }
 
-// Check for shader program link errors
-void checkProgramLinkError(GLuint program) {
-    GLint success;
-    GLchar infoLog[512];
-    glGetProgramiv(program, GL_LINK_STATUS, &success);
-    if (!success) {
-        glGetProgramInfoLog(program, 512, NULL, infoLog);
-        std::cerr << "ERROR::PROGRAM::LINKING_FAILED\n" << infoLog << std::endl;
+static int usage(const char* name){
+    std::cerr << "usage: " << name << " [--scene name] [--shader file.glsl]... [--target-ms ms] [--min-scale s] [--max-scale s] [--quality auto|low|medium|high|ultra] [--pipe path|-] [--pipe-format s16le|s24le|s32le|f32le] [--pipe-rate Hz] [--pipe-channels N] [--input device[:channels[:weight]]]... [--merge loudest|weighted|deck] [--deck N]" << std::endl;
+    return 2;
+}
+
+// One --input: a PortAudio device index for the device manager
+typedef struct {
+    int device;
+    int channels;
+    float weight;
+} inputOption;
+
+// "device[:channels[:weight]]"; returns 0 if it does not parse
+static int parseInput(const char* text, inputOption* input){
+    input->channels = NUM_CHANNELS;
+    input->weight = 1.0f;
+    return sscanf(text, "%d:%d:%f", &input->device, &input->channels, &input->weight) >= 1;
+}
+
+// MERGE_* for a --merge name, -1 if there is none
+static int mergePolicy(const std::string& name){
+    if (name == "loudest") return MERGE_LOUDEST;
+    if (name == "weighted") return MERGE_WEIGHTED;
+    if (name == "deck") return MERGE_PER_DECK;
+    return -1;
+}
+
+// What the renderer draws from: the device manager's merged view when
+// --input added devices, otherwise the one analyzer
+static featureFrame latestFeatures(audioAnalyzer* anal, deviceManager* devices){
+    return devices != NULL ? devices->getFeatures() : anal->getFeatures();
+}
+
+static bool lowBeat(audioAnalyzer* anal, deviceManager* devices){
+    return devices != NULL ? devices->lowBeat() : anal->lowBeat();
+}
+
+static void clearLowBeat(audioAnalyzer* anal, deviceManager* devices){
+    if (devices != NULL) {
+        devices->setLowBeat(false);
+    } else {
+        anal->setLowBeat(false);
+    }
+}
+
+// A built-in scene at every quality tier it has; one with no loop bounds
+// to scale is only the default tier, rather than the same program four times
+void addScene(shaderLibrary* library, const char* name, const char* source) {
+    std::string shader = shaderParams::inject(source);
+    for (int tier = 0; tier < QUALITY_TIERS; tier++) {
+        if (tier == QUALITY_DEFAULT || qualitySpecialize(shader, tier) != qualitySpecialize(shader, QUALITY_DEFAULT)) {
+            library->add(name, shader, tier);
+        }
+    }
+}
+
+// The same for a scene read from a file, which may gain loop bounds while it is edited
+void addSceneFile(shaderLibrary* library, const char* name, const char* path) {
+    for (int tier = 0; tier < QUALITY_TIERS; tier++) {
+        library->addFile(name, path, shaderParams::inject, tier);
+    }
+}
+
+// Every scene the visualiser can show, by the name --scene takes. Scenes
+// from files are named after the file and reloaded when it is saved.
+void registerScenes(shaderLibrary* library, const std::vector<const char*>& files) {
+    addScene(library, "chill", fragmentShaderSource);
+    addScene(library, "trippy", fragmentShaderSource2);
+    addScene(library, "noisy", fragmentShaderSource3);
+    addScene(library, "dark", fragmentShaderSource4);
+    addScene(library, "kaleidoscope", fragmentShaderSource5);
+    addScene(library, "worley", fragmentShaderSource6);
+    addScene(library, "menger", fragmentShaderSource7);
+    addSceneFile(library, "fragment", SHADER_FILE);
+    for (size_t i = 0; i < files.size(); i++) {
+        std::string name = files[i];
+        name = name.substr(name.rfind('/') + 1);
+        name = name.substr(0, name.find('.'));
+        addSceneFile(library, name.c_str(), files[i]);
     }
 }
 
@@ -80,13 +163,113 @@ void initializeRandomSeed()
     std::srand(static_cast<unsigned int>(std::time(0)));
 }
 
-int main() {
+int main(int argc, char** argv) {
+    // With --pipe, audio comes from stdin ("-") or a FIFO instead of a sound card
+    const char* scene = DEFAULT_SCENE;
+    std::vector<const char*> shaderFiles;
+    // Dynamic resolution: the render scale that holds targetMs of GPU time
+    double targetMs = SCALER_TARGET_MS;
+    float minScale = SCALER_MIN_SCALE;
+    float maxScale = SCALER_MAX_SCALE;
+    // Quality tier of every scene: fixed, or "auto" to start at the default
+    // and move each scene a tier when scaling alone cannot hold targetMs
+    const char* quality = "auto";
+    const char* pipePath = NULL;
+    int pipeSampleFormat = PIPE_S16LE;
+    double pipeRate = SAMPLE_RATE;
+    int pipeChannels = NUM_CHANNELS;
+    // With --input (repeatable), each device gets an analyzer of its own and
+    // the renderer follows their merge instead of the default device
+    std::vector<inputOption> inputs;
+    int merge = MERGE_LOUDEST;
+    int deck = 0;
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--scene" && hasValue) scene = argv[++i];
+        else if (arg == "--shader" && hasValue) shaderFiles.push_back(argv[++i]);
+        else if (arg == "--pipe" && hasValue) pipePath = argv[++i];
+        else if (arg == "--pipe-format" && hasValue) pipeSampleFormat = pipeFormat(argv[++i]);
+        else if (arg == "--pipe-rate" && hasValue) pipeRate = atof(argv[++i]);
+        else if (arg == "--pipe-channels" && hasValue) pipeChannels = atoi(argv[++i]);
+        else if (arg == "--target-ms" && hasValue) targetMs = atof(argv[++i]);
+        else if (arg == "--min-scale" && hasValue) minScale = atof(argv[++i]);
+        else if (arg == "--max-scale" && hasValue) maxScale = atof(argv[++i]);
+        else if (arg == "--quality" && hasValue) quality = argv[++i];
+        else if (arg == "--input" && hasValue) {
+            inputOption input;
+            if (!parseInput(argv[++i], &input)) return usage(argv[0]);
+            inputs.push_back(input);
+        }
+        else if (arg == "--merge" && hasValue) merge = mergePolicy(argv[++i]);
+        else if (arg == "--deck" && hasValue) deck = atoi(argv[++i]);
+        else return usage(argv[0]);
+    }
+    bool adaptive = std::string(quality) == "auto";
+    int tier = adaptive ? QUALITY_DEFAULT : qualityTier(quality);
+    if (pipeSampleFormat < 0 || tier < 0 || merge < 0 || (pipePath != NULL && !inputs.empty())) {
+        return usage(argv[0]);
+    }
+
+    // Per-frame and audio-thread messages go through the logger so neither
+    // loop ever waits on the terminal; LOG_LEVEL_DEBUG shows the trace lines
+    logStart(stdout);
+
+    // Real-time priority and core placement for the audio path, if configured
+    threadPlacement placement;
+    if (placement.load(THREAD_CONFIG)) {
+        std::cout << "Thread placement from " << THREAD_CONFIG << std::endl;
+    }
+    placement.applyProcess();
+
     //INITIALIZE MUSIC ANALYZER
     audioAnalyzer anal;
+    anal.setPlacement(&placement);
+
+    // With --input, several capture devices at once, merged (see deviceManager.h)
+    deviceManager manager;
+    deviceManager* devices = inputs.empty() ? NULL : &manager;
+    for (size_t i = 0; i < inputs.size(); i++) {
+        if (manager.addDevice(inputs[i].device, inputs[i].channels, inputs[i].weight) < 0) {
+            return 2;
+        }
+    }
+    manager.setPolicy(merge);
+    manager.setDeck(deck);
+    manager.setPlacement(&placement);
+
+    // Lighting and other local processes can follow the analysis through
+    // shared memory (featureShm.h); the visualiser runs fine without it
+    featureShmPublisher sharedBus;
+    if (!sharedBus.open()) {
+        std::cout << "Feature sharing disabled" << std::endl;
+    } else if (devices != NULL) {
+        manager.setSharedBus(&sharedBus);
+    } else {
+        anal.setSharedBus(&sharedBus);
+    }
 
-    std::thread myThread(threadFunction, &anal);
+    pcmPipe input;
+    std::atomic<bool> inputDone(false);
+    std::thread myThread;
+    if (devices != NULL) {
+        if (!manager.start()) {
+            return 2;
+        }
+    } else if (pipePath != NULL) {
+        if (!anal.setChannels(pipeChannels) || !anal.setInputRate(pipeRate)
+            || !input.open(pipePath, pipeSampleFormat, pipeChannels, pipeRate)) {
+            return 2;
+        }
+        myThread = std::thread(pipeThreadFunction, &anal, &input, &inputDone);
+    } else {
+        myThread = std::thread(threadFunction, &anal);
+    }
+    placement.apply(THREAD_RENDER);
+    threadJitter renderJitter;
+    int jitterFrames = 0;
 
-    float bpm = anal.getCurrentBPM();//detect_shouldReturnTheBpmAndTheBeat("./mangalam.mp3", PcmAudioFrameFormat::Float);
+    float bpm = latestFeatures(&anal, devices).bpm;//detect_shouldReturnTheBpmAndTheBeat("./mangalam.mp3", PcmAudioFrameFormat::Float);
     // return 0;
     // Initialize GLFW
     if (!glfwInit()) {
@@ -159,30 +342,50 @@ int main() {
     glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
     glEnableVertexAttribArray(0);
 
-    // Create and compile vertex shader
-    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
-    glShaderSource(vertexShader, 1, &vertexShaderSource, NULL);
-    glCompileShader(vertexShader);
-    checkShaderCompileError(vertexShader);
-
-    // Create and compile fragment shader
-    GLuint fragmentShader = glCreateShader(GL_FRAGMENT_SHADER);
-    glShaderSource(fragmentShader, 1, &fragmentShaderSource7, NULL); /////////////////////////////////////////////////////// CHANGE HERE FOR DIFFERENT SHADER
-    glCompileShader(fragmentShader);
-    checkShaderCompileError(fragmentShader);
-
-    // Link shaders to create a program
-    GLuint shaderProgram = glCreateProgram();
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    glLinkProgram(shaderProgram);
-    checkProgramLinkError(shaderProgram);
+    // A hidden window whose context shares objects with this one, for
+    // building scenes on the scene manager's loader thread
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    GLFWwindow* loader = glfwCreateWindow(1, 1, "Scene loader", NULL, window);
+    if (!loader) {
+        std::cerr << "No shared context; building every scene up front" << std::endl;
+    }
 
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
+    // One uniform buffer carries every shader parameter, uploaded once a frame
+    shaderParams params;
+    if (!params.init()) {
+        std::cerr << "Shader parameters could not be set up" << std::endl;
+        return -1;
+    }
+    params.setResolution(RESOLUTION_W, RESOLUTION_H);
+
+    // The first scene is built now (from the program cache when it is warm),
+    // the others in the background
+    shaderLibrary library(vertexShaderSource);
+    registerScenes(&library, shaderFiles);
+    if (library.find(scene) < 0) {
+        std::cerr << "Unknown scene " << scene << "; choose from";
+        for (int i = 0; i < library.count(); i++) {
+            if (library.find(library.name(i)) == i) std::cerr << " " << library.name(i);
+        }
+        std::cerr << std::endl;
+        return 2;
+    }
+    double buildStart = glfwGetTime();
+    sceneManager scenes;
+    if (!scenes.init(&library, &params, VAO, loader, scene, tier, RESOLUTION_W, RESOLUTION_H)) {
+        std::cerr << "Scene " << scene << " could not be set up" << std::endl;
+        return -1;
+    }
+    std::cout << "Scene " << scene << " ready at " << qualityName(tier) << " quality in " << (glfwGetTime() - buildStart) * 1000.0 << " ms" << std::endl;
 
-    // Use the shader program
-    glUseProgram(shaderProgram);
+    // Scenes are drawn at a scale of the window that follows the GPU's
+    // frame time, then sharpened up to full size
+    resolutionScaler scaler;
+    if (!scaler.init(VAO, RESOLUTION_W, RESOLUTION_H, targetMs, minScale, maxScale)) {
+        std::cerr << "Resolution scaling could not be set up" << std::endl;
+        return -1;
+    }
+    bool nextHeld = false;
 
 
 
@@ -227,7 +430,7 @@ int main() {
     float startValueB = b;
     float endValueB= b-getRandomFloat();
 
-    float amp = sin(anal.getCurrentFrequency() * swayAmplitude) * sin(anal.getCurrentFrequency() * swayAmplitude);
+    float amp = latestFeatures(&anal, devices).energy; // Normalised K-weighted loudness
     float startAmp = b;
     float endAmp= amp+getRandomFloat();
 
@@ -235,9 +438,14 @@ int main() {
     auto startTime = std::chrono::steady_clock::now();
     int counter = 0;
 
-    cout << "amp -> " << amp << endl;
-    cout << anal.getCurrentFrequency() << " - " << anal.maxLowBeat() << (anal.getCurrentFrequency()/anal.maxLowBeat()) << endl;
+    logDebug("amp -> %f", amp);
+    featureFrame initial = latestFeatures(&anal, devices);
+    logDebug("%f - %f %f", initial.freq, initial.maxLowBeat, initial.freq / initial.maxLowBeat);
     while (!glfwWindowShouldClose(window)) {
+        if (inputDone.load()) {
+            // End of the pipeline's audio is the end of the show
+            glfwSetWindowShouldClose(window, GLFW_TRUE);
+        }
         // std::cout << r << ", " << g << ", " << b << std::endl;
         
         
@@ -252,7 +460,7 @@ int main() {
         t = t > 1.0f ? 1.0f : t; // Clamp t to a maximum of 1.0f
         // Automatically zoom in slowly
         zoom *= zoomSpeed;
-        cout << change << endl;
+        LOG_EVERY(TRACE_SECONDS, LOG_LEVEL_DEBUG, "change %f", change);
 
     // if(cX > -0.77f && decrease){ // shader chill
     if(cX > -0.77f && decrease){
@@ -381,6 +589,14 @@ int main() {
         if (glfwGetKey(window, GLFW_KEY_K) == GLFW_PRESS) g -= 0.1f;  // Decrease imaginary part of c
         if (glfwGetKey(window, GLFW_KEY_L) == GLFW_PRESS) b -= 0.1f;  // Increase imaginary part of c
 
+        // Scenes: 1-9 pick one by its place in registerScenes(), N steps to the next
+        for (int key = GLFW_KEY_1; key <= GLFW_KEY_9 && key - GLFW_KEY_1 < scenes.count(); key++) {
+            if (glfwGetKey(window, key) == GLFW_PRESS) scenes.switchTo(key - GLFW_KEY_1);
+        }
+        bool nextPressed = glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS;
+        if (nextPressed && !nextHeld) scenes.switchTo((scenes.scene() + 1) % scenes.count());
+        nextHeld = nextPressed;
+
         // if(r > threshold_color){
         //     r = threshold_color;
         // }else if(r < 0.0f){
@@ -400,26 +616,46 @@ int main() {
         // }
 
         // Send uniform values to the shader
-        glUniform2f(glGetUniformLocation(shaderProgram, "u_resolution"), RESOLUTION_W, RESOLUTION_H);
-        glUniform2f(glGetUniformLocation(shaderProgram, "u_offset"), offsetX, offsetY);
-        glUniform1f(glGetUniformLocation(shaderProgram, "u_zoom"), zoom);
-        glUniform2f(glGetUniformLocation(shaderProgram, "u_c"), cX, cY);  // Send the complex constant c
-        glUniform1f(glGetUniformLocation(shaderProgram, "c_parameter_r"), r);  // red
-        glUniform1f(glGetUniformLocation(shaderProgram, "c_parameter_g"), g);  // red
-        glUniform1f(glGetUniformLocation(shaderProgram, "c_parameter_b"), b);  // red
-        glUniform1f(glGetUniformLocation(shaderProgram, "amplitude"), amp);  // red
-
-        glUniform1f(glGetUniformLocation(shaderProgram, "continuous_time"), currentTime);
-        glUniform1f(glGetUniformLocation(shaderProgram, "u_time"), durationBeat);
-
-        // Clear the screen and draw the quad
-        glClear(GL_COLOR_BUFFER_BIT);
-        glBindVertexArray(VAO);
-        glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+        scaler.begin();
+        params.setResolution(scaler.width(), scaler.height());
+        params.setOffset(offsetX, offsetY);
+        params.setZoom(zoom);
+        params.setC(cX, cY);  // Send the complex constant c
+        params.setColor(r, g, b);
+        params.setAmplitude(amp);
+        params.setTime(currentTime);
+        params.setBeatDuration(durationBeat);
+        params.upload();
+
+        // Draw the scene, or crossfade to the next one from a beat on
+        scenes.render(lowBeat(&anal, devices), durationBeat);
+        scaler.end();
+        if (adaptive) scenes.quality(scaler.pressure());
 
         // Swap buffers and poll for events
         glfwSwapBuffers(window);
         glfwPollEvents();
+        renderJitter.tick();
+        if (++jitterFrames == JITTER_REPORT_FRAMES) {
+            jitterFrames = 0;
+            jitterStats render = renderJitter.stats();
+            renderJitter.reset();
+            if (devices != NULL) {
+                for (int i = 0; i < devices->sourceCount(); i++) {
+                    jitterStats audio = devices->captureJitter(i);
+                    jitterStats worker = devices->workerLatency(i);
+                    logInfo("input %d jitter audio mean %.0f us worst %.0f us late %llu | worker wait mean %.0f us worst %.0f us | %lu dropped",
+                        i, audio.meanUs, audio.worstUs, audio.late, worker.meanUs, worker.worstUs, devices->droppedBuffers(i));
+                }
+                logInfo("jitter render mean %.0f us worst %.0f us late %llu", render.meanUs, render.worstUs, render.late);
+            } else {
+                jitterStats audio = anal.audioJitter();
+                logInfo("jitter audio mean %.0f us worst %.0f us late %llu | render mean %.0f us worst %.0f us late %llu",
+                    audio.meanUs, audio.worstUs, audio.late, render.meanUs, render.worstUs, render.late);
+            }
+            logInfo("render scale %.2f (%dx%d), GPU %.2f ms for %.2f ms, %s quality", scaler.scale(), scaler.width(), scaler.height(), scaler.gpuMs(), targetMs,
+                qualityName(scenes.tier()));
+        }
         // Convert float seconds to a duration
         
 
@@ -432,7 +668,9 @@ int main() {
         std::chrono::duration<float> duration(durationBeat);
         if(std::chrono::steady_clock::now() - startTime < duration){
             startTime = std::chrono::steady_clock::now();
-            bpm = anal.getCurrentBPM();//detect_shouldReturnTheBpmAndTheBeat("./mangalam.mp3", PcmAudioFrameFormat::Float);
+            // One snapshot of the analysis for everything this beat update reads
+            featureFrame features = latestFeatures(&anal, devices);
+            bpm = features.bpm;//detect_shouldReturnTheBpmAndTheBeat("./mangalam.mp3", PcmAudioFrameFormat::Float);
             if((int)bpm <= 0){ // initialize to a safe value until valid bpm value
                 bpm = 120.0;
             }
@@ -440,7 +678,7 @@ int main() {
             float currentAmp= lerp(startAmp, endAmp, t);
             amp = currentAmp;
             startAmp = amp;
-            endAmp= sin(anal.getCurrentFrequency() * swayAmplitude) * sin(anal.getCurrentFrequency() * swayAmplitude);
+            endAmp= features.energy;
 
             // startAmp = currentAmp;
             // endAmp = anal.getCurrentFrequency();
@@ -449,20 +687,15 @@ int main() {
             // startAmp = amp;
             // endAmp= sin(anal.getCurrentFrequency() * swayAmplitude) * sin(anal.getCurrentFrequency() * swayAmplitude);
 
-            cout << "amp -> " << amp << endl;
-            cout << anal.getCurrentFrequency() << " - " << anal.maxLowBeat() << (anal.getCurrentFrequency()/anal.maxLowBeat()) << endl;
+            LOG_EVERY(TRACE_SECONDS, LOG_LEVEL_DEBUG, "amp -> %f", amp);
+            LOG_EVERY(TRACE_SECONDS, LOG_LEVEL_DEBUG, "%f - %f %f", features.freq, features.maxLowBeat, features.freq / features.maxLowBeat);
 
             durationBeat = 60.0f / bpm; // Duration of one beat in seconds
-            cout << (int)bpm << endl;
+            LOG_EVERY(TRACE_SECONDS, LOG_LEVEL_DEBUG, "bpm %d", (int)bpm);
             if(counter == 20){
-                change = (anal.getCurrentFrequency()/anal.maxLowBeat()) > 0.0002 ? 0.0002 : (anal.getCurrentFrequency()/anal.maxLowBeat());
-                if(change > 0.0002){
-                    change = 0.0002;
-                }else if (change < -0.0002){
-                    change = -0.0002;
-                }else if((int)change < -10){
-                    change = 0.0002;
-                }
+                // Against the recent range rather than the all-time maximum,
+                // so one loud hit no longer freezes the motion for good
+                change = 0.0002f * (0.25f + 0.75f * features.normalized[NORM_FREQ]);
                 counter = 0;
             }else{
                 counter += 1;
@@ -470,13 +703,20 @@ int main() {
 
 
 
-            if(anal.lowBeat()){
+            // The harmonic (sustained) part sets the hue: bass notes push red,
+            // mids green, highs blue. Percussive onsets (lowBeat) set the timing.
+            float harmonicTotal = features.harmonic[BAND_LOW] + features.harmonic[BAND_MID] + features.harmonic[BAND_HIGH] + 1e-9f;
+            float tintR = 0.5f + features.harmonic[BAND_LOW] / harmonicTotal;
+            float tintG = 0.5f + features.harmonic[BAND_MID] / harmonicTotal;
+            float tintB = 0.5f + features.harmonic[BAND_HIGH] / harmonicTotal;
+
+            if(lowBeat(&anal, devices)){
                 
-                r = r > threshold_color ? threshold_color + getRandomFloat() : r + amp * sin(M_PI*r + getRandomFloat()*100);
-                g = g > threshold_color ? threshold_color + getRandomFloat() : g + amp * sin(M_PI*g + getRandomFloat()*100);
-                b = b > threshold_color ? threshold_color + getRandomFloat() : b + amp * sin(M_PI*b + getRandomFloat()*100);
+                r = r > threshold_color ? threshold_color + getRandomFloat() : r + tintR * amp * sin(M_PI*r + getRandomFloat()*100);
+                g = g > threshold_color ? threshold_color + getRandomFloat() : g + tintG * amp * sin(M_PI*g + getRandomFloat()*100);
+                b = b > threshold_color ? threshold_color + getRandomFloat() : b + tintB * amp * sin(M_PI*b + getRandomFloat()*100);
 
-                anal.setLowBeat(false);
+                clearLowBeat(&anal, devices);
             }else{
                 if(r>0.05)
                     r -= 0.01+getRandomFloat()/100;
@@ -491,19 +731,32 @@ int main() {
                 else
                     b = 0.5;  
             }
-            cout << "R: " << r << " - G: " << g << " - B: " << b << endl;
+            LOG_EVERY(TRACE_SECONDS, LOG_LEVEL_DEBUG, "R: %f - G: %f - B: %f", r, g, b);
 
             
         }
-        cout << cX << " - " << cY << endl;
+        LOG_EVERY(TRACE_SECONDS, LOG_LEVEL_DEBUG, "%f - %f", cX, cY);
     }
 
         // Cleanup
         glDeleteVertexArrays(1, &VAO);
         glDeleteBuffers(1, &VBO);
         glDeleteBuffers(1, &EBO);
-        glDeleteProgram(shaderProgram);
+        scenes.release();
+        scaler.release();
+        library.release();
+        params.release();
 
+        if (loader) {
+            glfwDestroyWindow(loader);
+        }
         glfwTerminate();
+        if (pipePath != NULL) {
+            input.stop();
+            myThread.join();
+        }
+        manager.stop();
+        sharedBus.close();
+        logStop();
         return 0;
 }
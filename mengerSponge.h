@@ -3,19 +3,16 @@ const char* fragmentShaderSource7 = R"(
 #version 330 core
 layout(location = 0) out vec4 fragColor;
 
-uniform vec2 u_resolution;
-uniform float continuous_time;
 
-uniform vec2 u_offset;
-uniform float u_zoom;
-uniform vec2 u_c;
-uniform float c_parameter_r;
-uniform float c_parameter_g;
-uniform float c_parameter_b;
-uniform float amplitude;
-
-
-const int MAX_STEPS = 300;
+#ifndef MAX_STEPS
+#define MAX_STEPS 300
+#endif
+#ifndef REFLECT_STEPS
+#define REFLECT_STEPS 15
+#endif
+#ifndef AO_SAMPLES
+#define AO_SAMPLES 10
+#endif
 const float MAX_DIST = 50;
 float EPSILON = 0.01*amplitude;
 const float PI = acos(-1.0);
@@ -108,11 +105,10 @@ vec4 rayMarch(vec3 ro, vec3 rd, int steps) {
 
 
 float getAO(vec3 pos, vec3 norm) {
-    float AO_SAMPLES = 10.0;
     float AO_FACTOR = 1.0;
     float result = 1.0;
-    float s = -AO_SAMPLES;
-    float unit = 1.0 / AO_SAMPLES;
+    float s = -10.0;
+    float unit = 1.0 / float(AO_SAMPLES);
     for (float i = unit; i < 1.0; i += unit) {
         result -= pow(1.6, i * s) * (i - map(pos + i * norm).w);
     }
@@ -151,7 +147,7 @@ vec3 render(vec2 uv) {
 
         // reflections
         vec3 ref_col;
-        vec4 ref_res = rayMarch(p + normal * 0.05, ref, 15);
+        vec4 ref_res = rayMarch(p + normal * 0.05, ref, REFLECT_STEPS);
         vec3 ref_p = p + ref * ref_res.w;
         vec3 ref_normal = getNormal(ref_p);
         ref_col = ref_res.rgb * max(0.0, dot(-ref, ref_normal));
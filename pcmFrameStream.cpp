@@ -0,0 +1,213 @@
+#include "pcmFrameStream.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <cstring>
+#include <strings.h>
+#include <algorithm>
+
+using introlab::PcmAudioFrame;
+using introlab::PcmAudioFrameFormat;
+
+pcmFrameStream::pcmFrameStream(const std::string& path, PcmAudioFrameFormat format, size_t frameSampleCount, int poolFrames)
+    : freeFrames(poolFrames), filledFrames(poolFrames + 1) {
+    this->path = path;
+    this->format = format;
+    this->frameSampleCount = frameSampleCount;
+    this->current = -1;
+    this->ended = false;
+    this->stopping.store(false);
+    this->rate = 0;
+    this->fd = -1;
+    this->mapped = NULL;
+    this->mappedBytes = 0;
+    this->decoder = NULL;
+
+    // The only frames this stream ever allocates
+    this->pool.reserve(poolFrames);
+    for (int i = 0; i < poolFrames; i++) {
+        this->pool.push_back(PcmAudioFrame(format, 1, frameSampleCount));
+        this->freeFrames.push(i);
+    }
+    sem_init(&this->freeReady, 0, poolFrames);
+    sem_init(&this->filledReady, 0, 0);
+
+    bool compressed = path.size() > 4 && strcasecmp(path.c_str() + path.size() - 4, ".mp3") == 0;
+    if (compressed ? this->openDecoder() : this->openRaw()) {
+        this->producer = std::thread(&pcmFrameStream::produce, this);
+    } else {
+        this->filledFrames.push(-1);
+        sem_post(&this->filledReady);
+    }
+}
+
+pcmFrameStream::~pcmFrameStream(){
+    this->stopping.store(true);
+    sem_post(&this->freeReady);
+    if (this->producer.joinable()) {
+        this->producer.join();
+    }
+    if (this->mapped != NULL) {
+        munmap((void*)this->mapped, this->mappedBytes);
+    }
+    if (this->fd >= 0) {
+        close(this->fd);
+    }
+    if (this->decoder != NULL) {
+        mpg123_close(this->decoder);
+        mpg123_delete(this->decoder);
+    }
+    sem_destroy(&this->freeReady);
+    sem_destroy(&this->filledReady);
+}
+
+// Maps the whole file read-only; the kernel pages it in ahead of the
+// producer and the producer drops what it has read
+int pcmFrameStream::openRaw(){
+    this->fd = open(this->path.c_str(), O_RDONLY);
+    struct stat info;
+    if (this->fd < 0 || fstat(this->fd, &info) != 0) {
+        printf("Could not open %s: %s\n", this->path.c_str(), strerror(errno));
+        return 0;
+    }
+    this->mappedBytes = (size_t)info.st_size;
+    if (this->mappedBytes == 0) {
+        return 1;
+    }
+    void* address = mmap(NULL, this->mappedBytes, PROT_READ, MAP_PRIVATE, this->fd, 0);
+    if (address == MAP_FAILED) {
+        printf("Could not map %s: %s\n", this->path.c_str(), strerror(errno));
+        this->mappedBytes = 0;
+        return 0;
+    }
+    madvise(address, this->mappedBytes, MADV_SEQUENTIAL);
+    this->mapped = (const unsigned char*)address;
+    return 1;
+}
+
+// mpg123 decodes mono in the frame's own sample format, so nothing is
+// converted after it
+int pcmFrameStream::openDecoder(){
+    int encoding;
+    switch (this->format) {
+        case PcmAudioFrameFormat::Signed16: encoding = MPG123_ENC_SIGNED_16; break;
+        case PcmAudioFrameFormat::Signed32: encoding = MPG123_ENC_SIGNED_32; break;
+        case PcmAudioFrameFormat::Float: encoding = MPG123_ENC_FLOAT_32; break;
+        case PcmAudioFrameFormat::Double: encoding = MPG123_ENC_FLOAT_64; break;
+        default:
+            printf("MP3 can only be decoded to Signed16, Signed32, Float or Double frames\n");
+            return 0;
+    }
+    mpg123_init();
+    int err = MPG123_OK;
+    this->decoder = mpg123_new(NULL, &err);
+    if (this->decoder == NULL) {
+        printf("Could not create an MP3 decoder: %s\n", mpg123_plain_strerror(err));
+        return 0;
+    }
+    // Mono only: mpg123 mixes stereo down itself
+    static const long rates[] = {8000, 11025, 12000, 16000, 22050, 24000, 32000, 44100, 48000};
+    mpg123_format_none(this->decoder);
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        mpg123_format(this->decoder, rates[i], MPG123_MONO, encoding);
+    }
+    int channels;
+    if (mpg123_open(this->decoder, this->path.c_str()) != MPG123_OK
+        || mpg123_getformat(this->decoder, &this->rate, &channels, &encoding) != MPG123_OK) {
+        printf("Could not decode %s: %s\n", this->path.c_str(), mpg123_strerror(this->decoder));
+        return 0;
+    }
+    return 1;
+}
+
+// Fills one frame from the file and zero-pads the tail of the last one.
+// Returns the bytes that came from the file, 0 at the end.
+size_t pcmFrameStream::fill(PcmAudioFrame& frame, size_t& offset, size_t& released){
+    unsigned char* out = frame.data();
+    size_t size = frame.size();
+    size_t got = 0;
+    if (this->decoder == NULL) {
+        got = std::min(size, this->mappedBytes - offset);
+        memcpy(out, this->mapped + offset, got);
+        offset += got;
+        // Give back pages already read so a long file never stays resident
+        size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        size_t done = offset / page * page;
+        if (done - released >= PCM_RELEASE_BYTES) {
+            madvise((void*)(this->mapped + released), done - released, MADV_DONTNEED);
+            released = done;
+        }
+    } else {
+        while (got < size) {
+            size_t decoded = 0;
+            int err = mpg123_read(this->decoder, out + got, size - got, &decoded);
+            got += decoded;
+            if (err == MPG123_DONE) {
+                break;
+            }
+            if (err != MPG123_OK && err != MPG123_NEW_FORMAT) {
+                printf("Decoding %s stopped: %s\n", this->path.c_str(), mpg123_strerror(this->decoder));
+                break;
+            }
+        }
+    }
+    memset(out + got, 0, size - got);
+    return got;
+}
+
+// Producer thread: fill free frames in file order until the file or the
+// consumer runs out
+void pcmFrameStream::produce(){
+    size_t offset = 0;
+    size_t released = 0;
+    while (true) {
+        while (sem_wait(&this->freeReady) != 0 && errno == EINTR) {
+        }
+        int index;
+        if (this->stopping.load() || !this->freeFrames.pop(index)) {
+            break;
+        }
+        if (this->fill(this->pool[index], offset, released) == 0) {
+            break;
+        }
+        this->filledFrames.push(index);
+        sem_post(&this->filledReady);
+    }
+    this->filledFrames.push(-1);
+    sem_post(&this->filledReady);
+}
+
+bool pcmFrameStream::isOpen(){
+    return this->producer.joinable();
+}
+
+// Rate of a decoded file; raw PCM carries none, so 0
+long pcmFrameStream::sampleRate(){
+    return this->rate;
+}
+
+// The next frame in file order, or NULL at the end. The frame is only
+// valid until the following call, which hands it back to the pool.
+const PcmAudioFrame* pcmFrameStream::next(){
+    if (this->current >= 0) {
+        this->freeFrames.push(this->current);
+        sem_post(&this->freeReady);
+        this->current = -1;
+    }
+    if (this->ended) {
+        return NULL;
+    }
+    while (sem_wait(&this->filledReady) != 0 && errno == EINTR) {
+    }
+    int index;
+    this->filledFrames.pop(index);
+    if (index < 0) {
+        this->ended = true;
+        return NULL;
+    }
+    this->current = index;
+    return &this->pool[index];
+}
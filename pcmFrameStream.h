@@ -0,0 +1,68 @@
+#ifndef PCMFRAMESTREAM_H
+#define PCMFRAMESTREAM_H
+
+#include <MusicBeatDetector/MusicBeatDetector.h>
+#include <mpg123.h>
+#include <semaphore.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include "spscRing.h"
+
+#define PCM_POOL_FRAMES 8                 // Frames decoded ahead of the consumer
+#define PCM_RELEASE_BYTES (4 * 1024 * 1024) // Mapped input dropped from memory in steps of this once read
+
+// Hands a file to MusicBeatDetector one PcmAudioFrame at a time instead of
+// materialising the whole file as a vector of frames. A producer thread
+// fills a small pool of frames ahead of the consumer, so reading and
+// decoding overlap with detection, and memory stays at PCM_POOL_FRAMES
+// frames whatever the file's length.
+//
+// Raw PCM (any file not ending in .mp3) is memory-mapped and copied
+// straight from the mapping into the pooled frame; pages already read are
+// released as the stream moves on. MP3 goes through mpg123, which decodes
+// directly into the pooled frame, mixed down to mono.
+//
+//   pcmFrameStream stream(path, PcmAudioFrameFormat::Float, 512);
+//   const PcmAudioFrame* frame;
+//   while ((frame = stream.next()) != NULL) {
+//       detector.detect(*frame);      // Valid until the next call to next()
+//   }
+class pcmFrameStream{
+    private:
+        std::string path;
+        introlab::PcmAudioFrameFormat format;
+        size_t frameSampleCount;
+        std::vector<introlab::PcmAudioFrame> pool;
+        spscRing<int> freeFrames;     // Pool indices the producer may fill
+        spscRing<int> filledFrames;   // Filled indices in file order, -1 at the end
+        sem_t freeReady;
+        sem_t filledReady;
+        int current;                  // Index the consumer holds, -1 for none
+        bool ended;                   // The consumer has seen the end marker
+        std::atomic<bool> stopping;
+        std::thread producer;
+        long rate;
+
+        // Raw PCM
+        int fd;
+        const unsigned char* mapped;
+        size_t mappedBytes;
+        // MP3
+        mpg123_handle* decoder;
+
+        int openRaw();
+        int openDecoder();
+        size_t fill(introlab::PcmAudioFrame& frame, size_t& offset, size_t& released);
+        void produce();
+    public:
+        pcmFrameStream(const std::string& path, introlab::PcmAudioFrameFormat format, size_t frameSampleCount, int poolFrames = PCM_POOL_FRAMES);
+        ~pcmFrameStream();
+
+        bool isOpen();
+        long sampleRate();
+        const introlab::PcmAudioFrame* next();
+};
+
+#endif
@@ -0,0 +1,325 @@
+#include "pcmPipe.h"
+#include "logger.h"
+#include <stdio.h>
+#include <errno.h>
+#include <string.h>
+#include <time.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <stdint.h>
+#include <algorithm>
+
+#define PIPE_POLL_MS 100 // Longest the reader thread sleeps before checking for close()
+
+static const int formatBytes[PIPE_FORMAT_COUNT] = { 2, 3, 4, 4 };
+static const char* formatNames[PIPE_FORMAT_COUNT] = { "s16le", "s24le", "s32le", "f32le" };
+
+int pipeFormat(const char* name){
+    for (int f = 0; f < PIPE_FORMAT_COUNT; f++) {
+        if (strcmp(name, formatNames[f]) == 0) {
+            return f;
+        }
+    }
+    return -1;
+}
+
+static struct timespec deadlineAfter(double seconds){
+    struct timespec deadline;
+    clock_gettime(CLOCK_REALTIME, &deadline);
+    long long ns = deadline.tv_nsec + (long long)(seconds * 1e9);
+    deadline.tv_sec += ns / 1000000000LL;
+    deadline.tv_nsec = ns % 1000000000LL;
+    return deadline;
+}
+
+pcmPipe::pcmPipe(){
+    this->fd = -1;
+    this->savedFlags = 0;
+    this->fifo = false;
+    this->format = PIPE_S16LE;
+    this->channelCount = 0;
+    this->sampleRate = 0.0;
+    this->frameBytes = 0;
+    this->ring = NULL;
+    this->running.store(false);
+    this->ended.store(true);
+    this->received.store(0);
+    this->starved.store(0);
+    this->delivered = 0;
+    this->clockStarted = false;
+    sem_init(&this->filled, 0, 0);
+    sem_init(&this->drained, 0, 0);
+}
+
+pcmPipe::~pcmPipe(){
+    this->close();
+    sem_destroy(&this->filled);
+    sem_destroy(&this->drained);
+}
+
+// Opens the path non-blocking; "-" is stdin
+int pcmPipe::openPath(){
+    if (this->path == "-") {
+        this->savedFlags = fcntl(STDIN_FILENO, F_GETFL);
+        fcntl(STDIN_FILENO, F_SETFL, this->savedFlags | O_NONBLOCK);
+        return STDIN_FILENO;
+    }
+    // Never blocks, even on a FIFO nobody has opened for writing yet
+    return ::open(this->path.c_str(), O_RDONLY | O_NONBLOCK);
+}
+
+// Starts reading `path` ("-" for stdin): interleaved `format` samples,
+// `channels` per frame at `rate`. Up to bufferSeconds of input is queued
+// ahead of read(). Returns 1 on success.
+int pcmPipe::open(const char* path, int format, int channels, double rate, double bufferSeconds){
+    if (this->isOpen()) {
+        printf("Pipe is already open\n");
+        return 0;
+    }
+    if (format < 0 || format >= PIPE_FORMAT_COUNT || channels < 1 || rate <= 0.0 || bufferSeconds <= 0.0) {
+        printf("Invalid pipe format: %d channels at %.0f Hz, %.2f s buffered\n", channels, rate, bufferSeconds);
+        return 0;
+    }
+    this->path = path;
+    this->fd = this->openPath();
+    if (this->fd < 0) {
+        printf("Could not open %s: %s\n", path, strerror(errno));
+        return 0;
+    }
+    struct stat info;
+    this->fifo = this->fd != STDIN_FILENO && fstat(this->fd, &info) == 0 && S_ISFIFO(info.st_mode);
+#ifdef F_SETPIPE_SZ
+    // A deeper kernel pipe means fewer, larger reads; best effort
+    fcntl(this->fd, F_SETPIPE_SZ, 1 << 20);
+#endif
+
+    this->format = format;
+    this->channelCount = channels;
+    this->sampleRate = rate;
+    this->frameBytes = formatBytes[format] * channels;
+    this->ring = new spscRing<unsigned char>((size_t)(rate * bufferSeconds) * this->frameBytes);
+    this->received.store(0);
+    this->starved.store(0);
+    this->delivered = 0;
+    this->clockStarted = false;
+    this->ended.store(false);
+    this->running.store(true);
+    this->reader = std::thread(&pcmPipe::readLoop, this);
+    return 1;
+}
+
+// Ends the input early: the reader thread stops and read() returns 0 from
+// its next call on. Safe while another thread is in read().
+void pcmPipe::stop(){
+    this->running.store(false);
+    if (this->reader.joinable()) {
+        this->reader.join();
+    }
+    this->ended.store(true);
+}
+
+// Stops the reader thread and closes the pipe. stdin gets its flags back.
+// Nothing may be in read() any more.
+void pcmPipe::close(){
+    this->stop();
+    if (this->fd == STDIN_FILENO) {
+        fcntl(STDIN_FILENO, F_SETFL, this->savedFlags);
+    } else if (this->fd >= 0) {
+        ::close(this->fd);
+    }
+    this->fd = -1;
+    this->ended.store(true);
+    delete this->ring;
+    this->ring = NULL;
+}
+
+bool pcmPipe::isOpen(){
+    return this->ring != NULL;
+}
+
+// Reader thread: read as much as the ring has room for in one call, sleep
+// in poll() when the pipe is empty and on `drained` when the ring is full
+void pcmPipe::readLoop(){
+    bool waitForWriter = this->fifo;
+    while (this->running.load(std::memory_order_relaxed)) {
+        size_t room;
+        unsigned char* at = this->ring->writable(room);
+        if (room == 0) {
+            struct timespec deadline = deadlineAfter(PIPE_POLL_MS / 1000.0);
+            sem_timedwait(&this->drained, &deadline);
+            continue;
+        }
+        if (waitForWriter) {
+            // A FIFO without a writer reads as end of file until one opens it
+            struct pollfd wait = { this->fd, POLLIN, 0 };
+            if (poll(&wait, 1, PIPE_POLL_MS) <= 0) {
+                continue;
+            }
+            waitForWriter = false;
+        }
+        ssize_t got = ::read(this->fd, at, std::min<size_t>(room, PIPE_READ_BYTES));
+        if (got > 0) {
+            this->ring->produced((size_t)got);
+            this->received.fetch_add((unsigned long long)got, std::memory_order_relaxed);
+            sem_post(&this->filled);
+            continue;
+        }
+        if (got == 0) {
+            if (!this->fifo) {
+                break;
+            }
+            // The writer went away. Complete any frame it left half written,
+            // so the next writer's frames line up, and wait for that writer.
+            size_t partial = (size_t)(this->received.load(std::memory_order_relaxed) % this->frameBytes);
+            if (partial > 0) {
+                static const unsigned char zeros[64] = { 0 };
+                size_t padding = this->frameBytes - partial;
+                while (padding > 0 && this->running.load(std::memory_order_relaxed)) {
+                    size_t written = this->ring->write(zeros, std::min<size_t>(padding, sizeof(zeros)));
+                    padding -= written;
+                    this->received.fetch_add(written, std::memory_order_relaxed);
+                    if (written == 0) {
+                        struct timespec deadline = deadlineAfter(PIPE_POLL_MS / 1000.0);
+                        sem_timedwait(&this->drained, &deadline);
+                    }
+                }
+            }
+            LOG_EVERY(10.0, LOG_LEVEL_INFO, "Writer closed %s, waiting for the next", this->path.c_str());
+            ::close(this->fd);
+            this->fd = this->openPath();
+            if (this->fd < 0) {
+                logError("Could not reopen %s: %s", this->path.c_str(), strerror(errno));
+                break;
+            }
+            waitForWriter = true;
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            struct pollfd wait = { this->fd, POLLIN, 0 };
+            poll(&wait, 1, PIPE_POLL_MS);
+            continue;
+        }
+        if (errno != EINTR) {
+            logError("Reading %s failed: %s", this->path.c_str(), strerror(errno));
+            break;
+        }
+    }
+    this->ended.store(true);
+    sem_post(&this->filled);
+}
+
+// Little-endian bytes to floats on [-1, 1]
+void pcmPipe::convert(const unsigned char* bytes, float* out, long frames){
+    size_t samples = (size_t)frames * this->channelCount;
+    switch (this->format) {
+        case PIPE_S16LE:
+            for (size_t i = 0; i < samples; i++) {
+                const unsigned char* b = bytes + 2 * i;
+                out[i] = (int16_t)(b[0] | b[1] << 8) * (1.0f / 32768.0f);
+            }
+            break;
+        case PIPE_S24LE:
+            for (size_t i = 0; i < samples; i++) {
+                const unsigned char* b = bytes + 3 * i;
+                // Into the top of an int32 so the sign comes along
+                out[i] = (int32_t)((uint32_t)b[0] << 8 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 24) * (1.0f / 2147483648.0f);
+            }
+            break;
+        case PIPE_S32LE:
+            for (size_t i = 0; i < samples; i++) {
+                const unsigned char* b = bytes + 4 * i;
+                out[i] = (int32_t)((uint32_t)b[0] | (uint32_t)b[1] << 8 | (uint32_t)b[2] << 16 | (uint32_t)b[3] << 24) * (1.0f / 2147483648.0f);
+            }
+            break;
+        case PIPE_F32LE:
+            memcpy(out, bytes, samples * sizeof(float));
+            break;
+    }
+}
+
+// Returns `frames` interleaved frames once they are due by the wall clock,
+// silence standing in for whatever the writer has not delivered. The clock
+// starts with the first audio. Returns 0 once the input has ended and
+// everything before the end has been read, or once the pipe is stopped.
+long pcmPipe::read(float* out, long frames){
+    if (!this->isOpen() || !this->running.load() || frames <= 0) {
+        return 0;
+    }
+    size_t want = (size_t)frames * this->frameBytes;
+    if (this->staged.size() < want) {
+        this->staged.resize(want);
+    }
+
+    using namespace std::chrono;
+    if (!this->clockStarted) {
+        // However long the writer takes to start, don't count it as
+        // underruns. The clock starts once PIPE_PREFILL_BUFFERS are queued,
+        // which is the slack a writer running in real time gets.
+        size_t prefill = std::min(want * PIPE_PREFILL_BUFFERS, this->ring->capacity() / this->frameBytes * this->frameBytes);
+        while (this->ring->size() < prefill && !this->ended.load()) {
+            struct timespec deadline = deadlineAfter(PIPE_POLL_MS / 1000.0);
+            sem_timedwait(&this->filled, &deadline);
+        }
+        if (this->ring->size() < (size_t)this->frameBytes) {
+            return 0;
+        }
+        this->clockStarted = true;
+        this->clockStart = steady_clock::now();
+        this->delivered = 0;
+    }
+
+    // The first buffer is due at once, each one after a buffer's time later
+    duration<double> period((double)frames / this->sampleRate);
+    steady_clock::time_point due = this->clockStart
+        + duration_cast<steady_clock::duration>(duration<double>(this->delivered / this->sampleRate));
+    steady_clock::time_point now = steady_clock::now();
+    if (now < due) {
+        std::this_thread::sleep_until(due);
+    } else if (now - due > PIPE_MAX_LATE_PERIODS * period) {
+        // The caller stalled; carry on from now rather than rushing to catch up
+        this->clockStart += duration_cast<steady_clock::duration>(now - due);
+    }
+
+    bool finished = this->ended.load();
+    size_t queued = this->ring->size() / this->frameBytes * this->frameBytes;
+    if (queued == 0 && finished) {
+        return 0;
+    }
+    size_t got = this->ring->read(&this->staged[0], std::min(want, queued));
+    sem_post(&this->drained);
+    long gotFrames = (long)(got / this->frameBytes);
+    this->convert(&this->staged[0], out, gotFrames);
+    if (gotFrames < frames) {
+        std::fill(out + (size_t)gotFrames * this->channelCount, out + (size_t)frames * this->channelCount, 0.0f);
+        if (!finished) {
+            this->starved.fetch_add(1, std::memory_order_relaxed);
+            LOG_EVERY(1.0, LOG_LEVEL_WARN, "Pipe underrun: %ld of %ld frames arrived in time", gotFrames, frames);
+        }
+    }
+    this->delivered += frames;
+    return frames;
+}
+
+// The input has ended and read() has nothing more to give
+bool pcmPipe::atEnd(){
+    return !this->isOpen() || (this->ended.load() && this->ring->size() < (size_t)this->frameBytes);
+}
+
+int pcmPipe::channels(){
+    return this->channelCount;
+}
+
+double pcmPipe::rate(){
+    return this->sampleRate;
+}
+
+// Buffers that were due before the writer delivered them
+unsigned long long pcmPipe::underruns(){
+    return this->starved.load();
+}
+
+unsigned long long pcmPipe::bytesReceived(){
+    return this->received.load();
+}
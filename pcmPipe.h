@@ -0,0 +1,90 @@
+#ifndef PCMPIPE_H
+#define PCMPIPE_H
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+#include <chrono>
+#include <semaphore.h>
+#include "spscRing.h"
+
+#define PIPE_READ_BYTES (64 * 1024)  // Largest single read() from the pipe
+#define PIPE_BUFFER_SECONDS 2.0      // Input queued ahead of the wall clock before the writer is held back
+#define PIPE_PREFILL_BUFFERS 2       // Buffers queued before the clock starts; all but one are a real-time writer's slack
+#define PIPE_MAX_LATE_PERIODS 4      // Further behind the clock than this and pacing restarts rather than catching up
+
+// Sample formats a pipe can carry, all little-endian and interleaved
+enum {
+    PIPE_S16LE = 0,
+    PIPE_S24LE,      // Packed, 3 bytes a sample
+    PIPE_S32LE,
+    PIPE_F32LE,
+    PIPE_FORMAT_COUNT
+};
+
+// Raw PCM from stdin or a named pipe, for installs where another process
+// (a decoder, a network receiver) produces the audio and no sound card is
+// involved:
+//
+//   ffmpeg -i set.flac -f s16le -ac 2 -ar 48000 - | ./fractal --pipe - --pipe-channels 2 --pipe-rate 48000
+//
+// A reader thread does large non-blocking reads straight into a byte ring;
+// when the ring is full it stops reading, so a writer faster than real time
+// (like the decoder above) is held back by the pipe itself. read() hands
+// the audio out on a wall clock, one buffer every buffer's worth of time,
+// exactly as a sound card would. If the writer falls behind, the missing
+// part of the buffer is silence and counted in underruns(), and the clock
+// keeps going, so a stalled source neither stops the analysis nor leaves
+// extra latency behind once it catches up.
+//
+// End of stdin ends the stream. A FIFO outlives its writers: when one goes
+// away the pipe is reopened for the next, and read() keeps returning
+// silence in between.
+class pcmPipe{
+    private:
+        std::string path;
+        int fd;
+        int savedFlags;              // stdin's flags, restored on close
+        bool fifo;                   // Reopen on end of file rather than ending
+        int format;
+        int channelCount;
+        double sampleRate;
+        int frameBytes;
+        spscRing<unsigned char>* ring;
+        std::vector<unsigned char> staged; // One buffer's bytes, unwrapped for conversion
+        sem_t filled;                // Posted by the reader thread after each read
+        sem_t drained;               // Posted by read() after taking bytes out
+        std::thread reader;
+        std::atomic<bool> running;
+        std::atomic<bool> ended;     // No more input will arrive
+        std::atomic<unsigned long long> received;
+        std::atomic<unsigned long long> starved; // Buffers read() had to pad with silence
+        unsigned long long delivered; // Frames handed out since the clock started
+        bool clockStarted;
+        std::chrono::steady_clock::time_point clockStart;
+
+        int openPath();
+        void readLoop();
+        void convert(const unsigned char* bytes, float* out, long frames);
+    public:
+        pcmPipe();
+        ~pcmPipe();
+
+        int open(const char* path, int format = PIPE_S16LE, int channels = 1, double rate = 44100.0, double bufferSeconds = PIPE_BUFFER_SECONDS);
+        void stop();
+        void close();
+        bool isOpen();
+
+        long read(float* out, long frames);
+        bool atEnd();
+
+        int channels();
+        double rate();
+        unsigned long long underruns();
+        unsigned long long bytesReceived();
+};
+
+int pipeFormat(const char* name);   // "s16le", "s24le", "s32le" or "f32le"; -1 for anything else
+
+#endif
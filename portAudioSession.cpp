@@ -0,0 +1,33 @@
+#include "portAudioSession.h"
+#include <portaudio.h>
+#include <stdio.h>
+#include <mutex>
+
+static std::mutex portAudioLock;
+static int portAudioUsers = 0;
+
+int portAudioAcquire(){
+    std::lock_guard<std::mutex> guard(portAudioLock);
+    if (portAudioUsers == 0) {
+        PaError err = Pa_Initialize();
+        if (err != paNoError) {
+            printf("PortAudio error: %s\n", Pa_GetErrorText(err));
+            return 0;
+        }
+    }
+    portAudioUsers++;
+    return 1;
+}
+
+void portAudioRelease(){
+    std::lock_guard<std::mutex> guard(portAudioLock);
+    if (portAudioUsers == 0) {
+        return;
+    }
+    if (--portAudioUsers == 0) {
+        PaError err = Pa_Terminate();
+        if (err != paNoError) {
+            printf("PortAudio error: %s\n", Pa_GetErrorText(err));
+        }
+    }
+}
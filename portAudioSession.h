@@ -0,0 +1,12 @@
+#ifndef PORTAUDIOSESSION_H
+#define PORTAUDIOSESSION_H
+
+// Pa_Initialize/Pa_Terminate are process-wide and not thread-safe, and
+// PortAudio only really shuts down once every Pa_Initialize has been matched.
+// Everything that talks to PortAudio goes through this pair instead, so any
+// number of analyzers and capture streams can come and go from different
+// threads. Returns 1 on success.
+int portAudioAcquire();
+void portAudioRelease();
+
+#endif
@@ -1,62 +1,31 @@
 #include <iostream>
-#include <portaudio.h>
+#include "audioReader.h"
 
 // Define some constants for audio input
 #define SAMPLE_RATE 44100
 #define NUM_CHANNELS 1  // Mono audio
-#define FRAMES_PER_BUFFER 256
+#define READ_TIMEOUT 1.0 // Seconds to wait for the device before giving up on a frame
+
+// The stream is opened on the first call and kept running, so each frame
+// after that is a copy out of the reader's ring instead of a full
+// Pa_Initialize / open / start / stop / Pa_Terminate cycle. Whatever queued
+// up between calls is dropped first: a frame is the audio from now on, not
+// up to READER_BUFFER_SECONDS of it from before.
+static audioReader reader;
 
 // This function will be used to capture audio from the microphone
 void getNextAudioFrame(size_t frameSampleCount, float* data) {
-    PaError err;
-
-    // Initialize PortAudio
-    err = Pa_Initialize();
-    if (err != paNoError) {
-        std::cerr << "PortAudio initialization error: " << Pa_GetErrorText(err) << std::endl;
-        return;
-    }
-
-    // Open input stream
-    PaStream *stream;
-    err = Pa_OpenDefaultStream(&stream,
-                               NUM_CHANNELS,  // Input channels (microphone)
-                               0,             // No output channels
-                               paFloat32,     // Sample format
-                               SAMPLE_RATE,   // Sample rate
-                               FRAMES_PER_BUFFER,  // Frames per buffer
-                               nullptr,       // No callback, use blocking read
-                               nullptr);      // No user data
-
-    if (err != paNoError) {
-        std::cerr << "PortAudio open stream error: " << Pa_GetErrorText(err) << std::endl;
-        Pa_Terminate();
-        return;
-    }
-
-    // Start the stream
-    err = Pa_StartStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio start stream error: " << Pa_GetErrorText(err) << std::endl;
-        Pa_CloseStream(stream);
-        Pa_Terminate();
+    if (!reader.isOpen() && !reader.open(-1, NUM_CHANNELS, SAMPLE_RATE)) {
+        std::cerr << "Could not open the default input" << std::endl;
         return;
     }
 
     // Read audio frames
-    size_t totalSamples = frameSampleCount * NUM_CHANNELS;  // Total number of samples to read
-    err = Pa_ReadStream(stream, data, frameSampleCount);
-
-    if (err != paNoError) {
-        std::cerr << "PortAudio read stream error: " << Pa_GetErrorText(err) << std::endl;
+    reader.discard();
+    long frames = reader.read(data, (long)frameSampleCount, READ_TIMEOUT);
+    if (frames < (long)frameSampleCount) {
+        std::cerr << "Timed out after " << frames << " of " << frameSampleCount << " frames" << std::endl;
     }
-
-    // Stop and close the stream
-    Pa_StopStream(stream);
-    Pa_CloseStream(stream);
-
-    // Terminate PortAudio
-    Pa_Terminate();
 }
 
 int main() {
@@ -0,0 +1,148 @@
+#include "resampler.h"
+#include "simdKernels.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+typedef struct {
+    int taps;          // At a 1:1 ratio
+    double stopbandDb; // Sets the Kaiser window's beta
+} resampleQuality;
+
+static const resampleQuality qualities[] = {
+    {16, 60.0},  // RESAMPLE_FAST
+    {32, 80.0},  // RESAMPLE_MEDIUM
+    {64, 100.0}  // RESAMPLE_BEST
+};
+
+// Zeroth order modified Bessel function, for the Kaiser window
+static double besselI0(double x){
+    double sum = 1.0, term = 1.0;
+    for (int k = 1; k < 50; k++) {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+        if (term < 1e-12 * sum) break;
+    }
+    return sum;
+}
+
+static long long greatestCommonDivisor(long long a, long long b){
+    while (b != 0) {
+        long long t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+resampler::resampler(double inputRate, double outputRate, int channels, int maxFrames, int quality){
+    this->channels = channels;
+    this->maxFrames = maxFrames;
+    long long in = std::llround(inputRate);
+    long long out = std::llround(outputRate);
+    long long divisor = greatestCommonDivisor(in, out);
+    this->up = out / divisor;
+    this->down = in / divisor;
+    this->phases = (int)std::min<long long>(this->up, RESAMPLER_MAX_PHASES);
+
+    const resampleQuality& q = qualities[std::max(0, std::min(quality, (int)RESAMPLE_BEST))];
+    // The cutoff sits at the lower of the two Nyquist rates, so anything that
+    // aliases on the way down only folds into the transition band. When
+    // downsampling the filter runs at the input rate and needs proportionally
+    // more taps for the same transition width at the output.
+    double ratio = (double)this->up / this->down;
+    double cutoff = 0.5 * std::min(1.0, ratio); // Cycles per input sample
+    int taps = (int)std::ceil(q.taps / std::min(1.0, ratio));
+    this->taps = std::min(RESAMPLER_MAX_TAPS, (taps + 7) / 8 * 8);
+
+    // Phase p's taps line up with the history so that tap j sits at
+    // t = j - (taps/2 - 1) - p/phases input samples from the output instant
+    double beta = 0.1102 * (q.stopbandDb - 8.7);
+    double halfWidth = this->taps / 2.0;
+    this->coeffs.resize((size_t)this->phases * this->taps);
+    for (int p = 0; p < this->phases; p++) {
+        float* row = &this->coeffs[(size_t)p * this->taps];
+        double sum = 0.0;
+        for (int j = 0; j < this->taps; j++) {
+            double t = j - (this->taps / 2 - 1) - (double)p / this->phases;
+            double x = 2.0 * M_PI * cutoff * t;
+            double sinc = std::fabs(x) < 1e-12 ? 1.0 : std::sin(x) / x;
+            double r = t / halfWidth;
+            double window = besselI0(beta * std::sqrt(std::max(0.0, 1.0 - r * r))) / besselI0(beta);
+            row[j] = sinc * window;
+            sum += sinc * window;
+        }
+        // Unity DC gain for every phase, or the rounding of the phase shows up as ripple
+        for (int j = 0; j < this->taps; j++) {
+            row[j] /= sum;
+        }
+    }
+
+    this->stride = this->taps + maxFrames;
+    this->history.resize((size_t)channels * this->stride);
+    this->appendAt.resize(channels);
+    this->reset();
+}
+
+void resampler::reset(){
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    // Enough silence that the first output is centred on the first input sample
+    this->fill = this->taps / 2 - 1;
+    this->index = 0;
+    this->phase = 0;
+}
+
+// Converts `frames` interleaved input frames (at most maxFrames) and returns
+// how many interleaved output frames were written, at most maxOutput(frames).
+int resampler::process(const float* in, int frames, float* out){
+    frames = std::min(frames, this->maxFrames);
+    for (int c = 0; c < this->channels; c++) {
+        this->appendAt[c] = &this->history[(size_t)c * this->stride + this->fill];
+    }
+    deinterleave(in, this->channels, frames, &this->appendAt[0]);
+    this->fill += frames;
+
+    int written = 0;
+    while (this->index + this->taps <= this->fill) {
+        int row = this->phases == this->up ? (int)this->phase : (int)(this->phase * this->phases / this->up);
+        const float* kernel = &this->coeffs[(size_t)row * this->taps];
+        for (int c = 0; c < this->channels; c++) {
+            const float* window = &this->history[(size_t)c * this->stride + this->index];
+            out[written * this->channels + c] = dotProduct(window, kernel, this->taps);
+        }
+        written++;
+        this->phase += this->down;
+        this->index += (int)(this->phase / this->up);
+        this->phase %= this->up;
+    }
+
+    // Drop what no future output will look at
+    int consumed = std::min(this->index, this->fill);
+    if (consumed > 0) {
+        for (int c = 0; c < this->channels; c++) {
+            float* h = &this->history[(size_t)c * this->stride];
+            memmove(h, h + consumed, sizeof(float) * (this->fill - consumed));
+        }
+        this->fill -= consumed;
+        this->index -= consumed;
+    }
+    return written;
+}
+
+int resampler::maxInput(){
+    return this->maxFrames;
+}
+
+// Upper bound on what process() writes for a block of `frames`
+int resampler::maxOutput(int frames){
+    return (int)(((long long)frames * this->up + this->down - 1) / this->down) + 1;
+}
+
+// Input samples between a sample arriving and the output centred on it
+int resampler::latency(){
+    return this->taps / 2;
+}
+
+int resampler::macsPerOutputSample(){
+    return this->taps * this->channels;
+}
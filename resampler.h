@@ -0,0 +1,59 @@
+#ifndef RESAMPLER_H
+#define RESAMPLER_H
+
+#include <vector>
+
+#define RESAMPLER_MAX_PHASES 1024 // Ratios that reduce to more phases than this round the phase instead
+#define RESAMPLER_MAX_TAPS 256    // Bounds the cost per output sample whatever the ratio
+
+// Trade-off between stopband, passband and cost per output sample. Taps are
+// at a 1:1 ratio; downsampling scales them by the ratio so the transition
+// band stays the same width relative to the output rate. Passband edges are
+// the -0.1 dB points measured going to 44.1 kHz.
+enum {
+    RESAMPLE_FAST = 0,   // 16 taps, 60 dB stopband, flat to ~18.5 kHz
+    RESAMPLE_MEDIUM,     // 32 taps, 80 dB stopband, flat to ~19.5 kHz
+    RESAMPLE_BEST        // 64 taps, 100 dB stopband, flat to ~20.5 kHz
+};
+
+// Streaming sample-rate converter for interleaved audio, so a device can be
+// captured at its native rate (48 or 96 kHz, say) and analysed at SAMPLE_RATE.
+//
+// Polyphase windowed sinc: the ratio is reduced to up/down, the Kaiser
+// windowed low-pass is split into `up` phases, and each output sample is
+// one dot product of the phase it falls on with the input history, through
+// the SIMD dotProduct kernel. Every channel keeps a contiguous history so
+// no output ever has to wrap around a ring.
+//
+// The transition band straddles the output Nyquist frequency, so whatever
+// aliases only folds back above the passband, out of the analysed range.
+// Cost is taps multiply-adds per output sample per channel, see
+// macsPerOutputSample(); with AVX2, RESAMPLE_MEDIUM takes 48 or 96 kHz mono
+// to 44.1 kHz in about 10 ns per output sample, ~10 us per analysed buffer.
+class resampler{
+    private:
+        int channels;
+        int maxFrames;                 // Largest input block process() takes
+        long long up;                  // Output samples per `down` input samples, reduced
+        long long down;
+        int phases;                    // Coefficient sets, up or RESAMPLER_MAX_PHASES
+        int taps;                      // Per phase, a multiple of 8
+        std::vector<float> coeffs;     // phases x taps
+        std::vector<float> history;    // channels x stride, unconsumed input
+        int stride;
+        std::vector<float*> appendAt;  // Where each channel's next input goes
+        int fill;                      // Samples per channel held in history
+        int index;                     // First history sample of the next output's window
+        long long phase;               // Position of the next output between samples, in 1/up
+    public:
+        resampler(double inputRate, double outputRate, int channels, int maxFrames, int quality = RESAMPLE_MEDIUM);
+
+        void reset();
+        int process(const float*, int, float*);
+        int maxInput();
+        int maxOutput(int frames);
+        int latency();
+        int macsPerOutputSample();
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "resolutionScaler.h"
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+#include <algorithm>
+
+static const char* upscaleVertexSource =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 position;\n"
+    "void main() { gl_Position = vec4(position, 0.0, 1.0); }\n";
+
+// Bilinear upscale with contrast-adaptive sharpening: each pixel is pushed
+// away from its four neighbours, less so where they already differ a lot,
+// so soft detail comes back without halos around hard edges
+static const char* upscaleFragmentSource =
+    "#version 330 core\n"
+    "uniform sampler2D scene;\n"
+    "uniform vec2 extent;\n"        // Rendered size over the texture's size
+    "uniform vec2 windowSize;\n"
+    "uniform float sharpness;\n"
+    "out vec4 FragColor;\n"
+    "vec3 tap(vec2 uv, vec2 lo, vec2 hi) { return texture(scene, clamp(uv, lo, hi)).rgb; }\n"
+    "void main() {\n"
+    "    vec2 texel = 1.0 / vec2(textureSize(scene, 0));\n"
+    "    vec2 uv = gl_FragCoord.xy / windowSize * extent;\n"
+    "    vec2 lo = 0.5 * texel;\n"     // Only what was drawn this frame
+    "    vec2 hi = extent - 0.5 * texel;\n"
+    "    vec3 c = tap(uv, lo, hi);\n"
+    "    vec3 n = tap(uv + vec2(0.0, texel.y), lo, hi);\n"
+    "    vec3 s = tap(uv - vec2(0.0, texel.y), lo, hi);\n"
+    "    vec3 e = tap(uv + vec2(texel.x, 0.0), lo, hi);\n"
+    "    vec3 w = tap(uv - vec2(texel.x, 0.0), lo, hi);\n"
+    "    vec3 low = min(c, min(min(n, s), min(e, w)));\n"
+    "    vec3 high = max(c, max(max(n, s), max(e, w)));\n"
+    "    vec3 amount = sqrt(clamp(min(low, 1.0 - high) / max(high, vec3(1e-4)), 0.0, 1.0));\n"
+    "    vec3 weight = -amount * mix(0.0, 0.2, sharpness);\n"
+    "    vec3 color = (c + (n + s + e + w) * weight) / (1.0 + 4.0 * weight);\n"
+    "    FragColor = vec4(clamp(color, 0.0, 1.0), 1.0);\n"
+    "}\n";
+
+resolutionScaler::resolutionScaler() : upscaler(upscaleVertexSource){
+    this->quad = 0;
+    this->fullWidth = 0;
+    this->fullHeight = 0;
+    this->scaledWidth = 0;
+    this->scaledHeight = 0;
+    this->minScale = SCALER_MIN_SCALE;
+    this->maxScale = SCALER_MAX_SCALE;
+    this->currentScale = SCALER_MAX_SCALE;
+    this->targetMs = SCALER_TARGET_MS;
+    this->lastMs = 0.0;
+    this->errors[0] = 0.0;
+    this->errors[1] = 0.0;
+    this->texture = 0;
+    this->textureWidth = 0;
+    this->textureHeight = 0;
+    this->target = 0;
+    memset(this->queries, 0, sizeof(this->queries));
+    this->oldest = 0;
+    this->inFlight = 0;
+    this->timing = false;
+    this->screen = 0;
+    this->program = 0;
+    this->extentLocation = -1;
+    this->sharpnessLocation = -1;
+}
+
+// Sets up the target and the upscale pass for a `width` x `height` window.
+// `quad` is the full-screen quad's VAO (6 indices). The scale starts at
+// maxScale and is kept within [minScale, maxScale], both in (0, 1].
+// Returns 1 on success.
+int resolutionScaler::init(GLuint quad, int width, int height, double targetMs, float minScale, float maxScale){
+    if (!(minScale > 0.0f && minScale <= maxScale && maxScale <= 1.0f) || targetMs <= 0.0) {
+        printf("Invalid resolution scaling: %.2f to %.2f for %.2f ms\n", minScale, maxScale, targetMs);
+        return 0;
+    }
+    this->quad = quad;
+    this->fullWidth = width;
+    this->fullHeight = height;
+    this->minScale = minScale;
+    this->maxScale = maxScale;
+    this->currentScale = maxScale;
+    this->targetMs = targetMs;
+
+    this->upscaler.add("upscale", upscaleFragmentSource);
+    this->upscaler.build();
+    this->program = this->upscaler.program(0);
+    if (this->program == 0) {
+        return 0;
+    }
+    glUseProgram(this->program);
+    glUniform1i(glGetUniformLocation(this->program, "scene"), 0);
+    glUniform2f(glGetUniformLocation(this->program, "windowSize"), (float)width, (float)height);
+    this->extentLocation = glGetUniformLocation(this->program, "extent");
+    this->sharpnessLocation = glGetUniformLocation(this->program, "sharpness");
+    glUniform1f(this->sharpnessLocation, SCALER_SHARPNESS);
+
+    GLint screen = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &screen);
+    this->textureWidth = (int)ceilf(width * maxScale);
+    this->textureHeight = (int)ceilf(height * maxScale);
+    glGenTextures(1, &this->texture);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, this->textureWidth, this->textureHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glGenFramebuffers(1, &this->target);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->target);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->texture, 0);
+    bool complete = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    glBindFramebuffer(GL_FRAMEBUFFER, screen);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    if (!complete) {
+        printf("Scaled render target is incomplete\n");
+        return 0;
+    }
+    this->resize();
+
+    // Core since 3.3; without it the scale just stays put
+    if (GLEW_ARB_timer_query) {
+        glGenQueries(SCALER_QUERIES, this->queries);
+    } else {
+        printf("No GPU timer queries; rendering at %.2f scale\n", maxScale);
+    }
+    return 1;
+}
+
+void resolutionScaler::release(){
+    if (this->queries[0] != 0) {
+        glDeleteQueries(SCALER_QUERIES, this->queries);
+        memset(this->queries, 0, sizeof(this->queries));
+    }
+    if (this->target != 0) {
+        glDeleteFramebuffers(1, &this->target);
+        glDeleteTextures(1, &this->texture);
+        this->target = 0;
+        this->texture = 0;
+    }
+    this->upscaler.release();
+    this->program = 0;
+}
+
+// Scaled size, rounded to SCALER_STEP so the size does not creep by a
+// pixel at a time
+void resolutionScaler::resize(){
+    this->scaledWidth = std::max(SCALER_STEP, (int)lroundf(this->fullWidth * this->currentScale / SCALER_STEP) * SCALER_STEP);
+    this->scaledHeight = std::max(SCALER_STEP, (int)lroundf(this->fullHeight * this->currentScale / SCALER_STEP) * SCALER_STEP);
+    this->scaledWidth = std::min(this->scaledWidth, this->textureWidth);
+    this->scaledHeight = std::min(this->scaledHeight, this->textureHeight);
+}
+
+// One PID step on a measured frame. The error is relative to the target,
+// positive when the frame was too slow, and the output is a change of
+// scale: velocity form, u(k) - u(k-1) = Kp (e(k) - e(k-1)) + Ki e(k)
+// + Kd (e(k) - 2 e(k-1) + e(k-2)).
+void resolutionScaler::control(double gpuMs){
+    this->lastMs = gpuMs;
+    double error = (gpuMs - this->targetMs) / this->targetMs;
+    double change = SCALER_KP * (error - this->errors[0]) + SCALER_KI * error
+        + SCALER_KD * (error - 2.0 * this->errors[0] + this->errors[1]);
+    this->errors[1] = this->errors[0];
+    this->errors[0] = error;
+    this->currentScale = std::min(this->maxScale, std::max(this->minScale, (float)(this->currentScale - change)));
+}
+
+// Collects any finished timings, sets this frame's size and binds the
+// target with the viewport covering that size
+void resolutionScaler::begin(){
+    if (this->queries[0] != 0) {
+        // Queries finish in order, so stop at the first that has not
+        while (this->inFlight > 0) {
+            GLuint available = 0;
+            glGetQueryObjectuiv(this->queries[this->oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+            if (!available) {
+                break;
+            }
+            GLuint64 elapsed = 0;
+            glGetQueryObjectui64v(this->queries[this->oldest], GL_QUERY_RESULT, &elapsed);
+            this->control(elapsed / 1e6);
+            this->oldest = (this->oldest + 1) % SCALER_QUERIES;
+            this->inFlight--;
+        }
+        // With every query still in flight this frame goes untimed rather than waiting
+        this->timing = this->inFlight < SCALER_QUERIES;
+        if (this->timing) {
+            glBeginQuery(GL_TIME_ELAPSED, this->queries[(this->oldest + this->inFlight) % SCALER_QUERIES]);
+        }
+    }
+    this->resize();
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &this->screen);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->target);
+    glViewport(0, 0, this->scaledWidth, this->scaledHeight);
+}
+
+// Upscales the frame onto the framebuffer begin() found bound (the
+// window's) and ends its timing
+void resolutionScaler::end(){
+    glBindFramebuffer(GL_FRAMEBUFFER, this->screen);
+    glViewport(0, 0, this->fullWidth, this->fullHeight);
+    glUseProgram(this->program);
+    glUniform2f(this->extentLocation, (float)this->scaledWidth / this->textureWidth, (float)this->scaledHeight / this->textureHeight);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->texture);
+    glBindVertexArray(this->quad);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    if (this->timing) {
+        glEndQuery(GL_TIME_ELAPSED);
+        this->inFlight++;
+        this->timing = false;
+    }
+}
+
+int resolutionScaler::width(){
+    return this->scaledWidth;
+}
+
+int resolutionScaler::height(){
+    return this->scaledHeight;
+}
+
+float resolutionScaler::scale(){
+    return this->currentScale;
+}
+
+double resolutionScaler::gpuMs(){
+    return this->lastMs;
+}
+
+// Which way the scene's own cost has to go for the target to hold: 1 when
+// the last frame was over it at the smallest scale, -1 when it was well
+// under it at the largest, 0 while scaling covers it or before any frame
+// was timed
+int resolutionScaler::pressure(){
+    if (this->lastMs <= 0.0) {
+        return 0;
+    }
+    if (this->currentScale <= this->minScale && this->lastMs > this->targetMs) {
+        return 1;
+    }
+    if (this->currentScale >= this->maxScale && this->lastMs < SCALER_HEADROOM * this->targetMs) {
+        return -1;
+    }
+    return 0;
+}
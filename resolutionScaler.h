@@ -0,0 +1,85 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+#include <GL/glew.h>
+#include "shaderLibrary.h"
+
+#define SCALER_TARGET_MS 14.0   // GPU time per frame to hold; leaves headroom under 60 fps
+#define SCALER_MIN_SCALE 0.5f   // Smallest fraction of the window's width and height rendered
+#define SCALER_MAX_SCALE 1.0f
+#define SCALER_QUERIES 4        // Timer queries in flight; results are read a few frames late
+#define SCALER_KP 0.10          // PID gains, on the frame time's error relative to the target
+#define SCALER_KI 0.04
+#define SCALER_KD 0.02
+#define SCALER_STEP 8           // Rendered sizes are multiples of this many pixels
+#define SCALER_SHARPNESS 0.6f   // 0 = plain bilinear upscale, 1 = strongest sharpening
+#define SCALER_HEADROOM 0.6     // Under this share of the target at full scale, the scene could afford more detail
+
+// Dynamic resolution: the scene is drawn into an offscreen target at a
+// fraction of the window's size and scaled up to the window with a
+// contrast-adaptive sharpening filter, and the fraction follows the GPU's
+// frame time.
+//
+//   resolutionScaler scaler;
+//   scaler.init(VAO, RESOLUTION_W, RESOLUTION_H, SCALER_TARGET_MS, SCALER_MIN_SCALE, SCALER_MAX_SCALE);
+//   // every frame:
+//   scaler.begin();                                  // Binds the target
+//   params.setResolution(scaler.width(), scaler.height());
+//   ... upload the parameters and draw the scene ...
+//   scaler.end();                                    // Upscales to the window
+//
+// The time from begin() to the end of the upscale is measured with
+// GL_TIME_ELAPSED queries. Results are read only once available, a few
+// frames later, so timing never stalls the pipeline. Each result feeds a
+// PID controller in velocity form: it moves the scale by the change it
+// computes and the scale is clamped to [minScale, maxScale], so the
+// integral cannot wind up while the scale sits at a limit. The target is
+// allocated once at the largest scale; a smaller scale only shrinks the
+// viewport. Past the ends of that range only the scene itself can get
+// cheaper or dearer; pressure() says which way (sceneManager::quality()).
+class resolutionScaler{
+    private:
+        GLuint quad;
+        int fullWidth;
+        int fullHeight;
+        int scaledWidth;
+        int scaledHeight;
+        float minScale;
+        float maxScale;
+        float currentScale;
+        double targetMs;
+        double lastMs;
+        double errors[2];            // The two previous errors, for the P and D terms
+        GLuint texture;
+        int textureWidth;            // Allocated at maxScale
+        int textureHeight;
+        GLuint target;
+        GLint screen;                // Framebuffer to upscale onto
+        GLuint queries[SCALER_QUERIES];
+        int oldest;                  // Oldest query still in flight
+        int inFlight;
+        bool timing;                 // This frame has a query running
+        shaderLibrary upscaler;
+        GLuint program;
+        GLint extentLocation;
+        GLint sharpnessLocation;
+
+        void control(double gpuMs);
+        void resize();
+    public:
+        resolutionScaler();
+
+        int init(GLuint quad, int width, int height, double targetMs, float minScale, float maxScale);
+        void release();   // Needs the context
+
+        void begin();
+        void end();
+
+        int width();      // Size the scene is drawn at this frame
+        int height();
+        float scale();
+        double gpuMs();   // Latest measured frame, 0 before the first
+        int pressure();
+};
+
+#endif
@@ -0,0 +1,629 @@
+#include "sceneManager.h"
+#include "logger.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+static const char* crossfadeVertexSource =
+    "#version 330 core\n"
+    "layout(location = 0) in vec2 position;\n"
+    "void main() { gl_Position = vec4(position, 0.0, 1.0); }\n";
+
+// The targets are the screen's size, so pixels map one to one
+static const char* crossfadeFragmentSource =
+    "#version 330 core\n"
+    "uniform sampler2D fromScene;\n"
+    "uniform sampler2D toScene;\n"
+    "uniform float mixAmount;\n"
+    "out vec4 FragColor;\n"
+    "void main() {\n"
+    "    ivec2 pixel = ivec2(gl_FragCoord.xy);\n"
+    "    FragColor = mix(texelFetch(fromScene, pixel, 0), texelFetch(toScene, pixel, 0), mixAmount);\n"
+    "}\n";
+
+static double millis(std::chrono::steady_clock::duration d){
+    return std::chrono::duration<double, std::milli>(d).count();
+}
+
+static const char* tierLabel(int tier){
+    return tier >= 0 ? qualityName(tier) : "as written";
+}
+
+sceneManager::sceneManager() : compositor(crossfadeVertexSource){
+    this->library = NULL;
+    this->params = NULL;
+    this->loader = NULL;
+    this->quad = 0;
+    this->width = 0;
+    this->height = 0;
+    this->current = -1;
+    this->next = -1;
+    this->state = SCENE_IDLE;
+    this->pressureSign = 0;
+    this->pressureFrames = 0;
+    this->fadeSeconds = 0.0f;
+    this->timed = false;
+    memset(this->targets, 0, sizeof(this->targets));
+    memset(this->textures, 0, sizeof(this->textures));
+    this->blend = 0;
+    this->mixLocation = -1;
+    memset(&this->stats, 0, sizeof(this->stats));
+    memset(&this->last, 0, sizeof(this->last));
+    this->last.from = -1;
+    this->last.to = -1;
+    this->steadyWorstMs = 0.0;
+    this->stopping = false;
+    memset(&this->warmValues, 0, sizeof(this->warmValues));
+}
+
+// Builds `scene` at quality `tier`, which every scene starts at, and the
+// crossfade pass on the current context and starts the loader thread on
+// `loader`'s, which must share objects with it and not be current
+// anywhere. Without a loader every variant is built here, as before.
+// `quad` is the full-screen quad's VAO (6 indices), `width` and `height`
+// the framebuffer's size. Returns 1 on success.
+int sceneManager::init(shaderLibrary* library, shaderParams* params, GLuint quad, GLFWwindow* loader, const char* scene, int tier, int width, int height){
+    if (library->find(scene) < 0 || tier < 0 || tier >= QUALITY_TIERS) {
+        printf("No scene %s at quality %d to start with\n", scene, tier);
+        return 0;
+    }
+    this->library = library;
+    this->params = params;
+    this->loader = loader;
+    this->quad = quad;
+    this->width = width;
+    this->height = height;
+    this->group();
+    this->current = 0;
+    while (strcmp(this->name(this->current), scene) != 0) {
+        this->current++;
+    }
+    this->shown.assign(this->variants.size(), tier);
+    this->wanted.assign(this->variants.size(), tier);
+    this->ceiling.assign(this->variants.size(), QUALITY_TIERS - 1);
+    this->programs.assign(library->count(), 0);
+    this->failed.assign(library->count(), false);
+    this->tried.assign(library->count(), loader == NULL);
+
+    int first = this->variant(this->current);
+    this->tried[first] = true;
+    library->build(loader != NULL ? first : -1);
+    for (int i = 0; i < library->count(); i++) {
+        GLuint program = library->program(i);
+        if (program != 0 && params->attach(program)) {
+            this->programs[i] = program;
+        } else if (loader == NULL || i == first) {
+            this->failed[i] = true;
+        }
+    }
+    if (this->programs[first] == 0) {
+        printf("Scene %s did not build at %s quality\n", scene, qualityName(tier));
+        return 0;
+    }
+
+    this->compositor.add("crossfade", crossfadeFragmentSource);
+    this->compositor.build();
+    this->blend = this->compositor.program(0);
+    if (this->blend == 0) {
+        return 0;
+    }
+    glUseProgram(this->blend);
+    glUniform1i(glGetUniformLocation(this->blend, "fromScene"), 0);
+    glUniform1i(glGetUniformLocation(this->blend, "toScene"), 1);
+    this->mixLocation = glGetUniformLocation(this->blend, "mixAmount");
+
+    // Allocated once; a crossfade only rebinds them
+    GLint screen = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &screen);
+    glGenTextures(SCENE_TARGETS, this->textures);
+    glGenFramebuffers(SCENE_TARGETS, this->targets);
+    for (int i = 0; i < SCENE_TARGETS; i++) {
+        glBindTexture(GL_TEXTURE_2D, this->textures[i]);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glBindFramebuffer(GL_FRAMEBUFFER, this->targets[i]);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, this->textures[i], 0);
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+            printf("Crossfade target %d is incomplete\n", i);
+            glBindFramebuffer(GL_FRAMEBUFFER, screen);
+            return 0;
+        }
+    }
+    glBindFramebuffer(GL_FRAMEBUFFER, screen);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    glUseProgram(this->programs[first]);
+
+    if (loader != NULL) {
+        // Preload every other scene at its tier, so most switches find it
+        // ready; other tiers wait until quality() asks for them
+        this->warmValues = params->current();
+        for (int i = 0; i < (int)this->variants.size(); i++) {
+            if (this->programs[this->variant(i)] == 0) {
+                this->queue(this->variant(i), false);
+            }
+        }
+        // File-backed variants are rebuilt on the loader whenever they are saved
+        for (int i = 0; i < library->count(); i++) {
+            if (library->path(i)[0] != '\0') {
+                int id = this->watch.add(library->path(i));
+                if (id >= 0) {
+                    this->watched.resize(id + 1);
+                    this->watched[id] = i;
+                }
+            }
+        }
+        this->stopping = false;
+        this->worker = std::thread(&sceneManager::loadLoop, this);
+    }
+    return 1;
+}
+
+void sceneManager::release(){
+    if (this->worker.joinable()) {
+        {
+            std::lock_guard<std::mutex> guard(this->lock);
+            this->stopping = true;
+        }
+        this->wake.notify_all();
+        this->worker.join();
+    }
+    for (size_t i = 0; i < this->done.size(); i++) {
+        this->arrived.push_back(this->done[i]);
+    }
+    this->done.clear();
+    // The library deletes the programs it has now; earlier ones still on
+    // screen or replaced by a reload that never reached the screen are ours
+    std::vector<GLuint> stale;
+    for (size_t i = 0; i < this->programs.size(); i++) {
+        if (this->programs[i] != 0 && this->programs[i] != this->library->program((int)i)) {
+            stale.push_back(this->programs[i]);
+        }
+    }
+    for (size_t i = 0; i < this->arrived.size(); i++) {
+        loaded& item = this->arrived[i];
+        if (item.fence != NULL) {
+            glDeleteSync(item.fence);
+        }
+        if (item.replaced != 0 && item.replaced != this->library->program(item.variant)) {
+            stale.push_back(item.replaced);
+        }
+    }
+    this->arrived.clear();
+    std::sort(stale.begin(), stale.end());
+    stale.erase(std::unique(stale.begin(), stale.end()), stale.end());
+    for (size_t i = 0; i < stale.size(); i++) {
+        glDeleteProgram(stale[i]);
+    }
+    this->watch.close();
+    if (this->targets[0] != 0) {
+        glDeleteFramebuffers(SCENE_TARGETS, this->targets);
+        glDeleteTextures(SCENE_TARGETS, this->textures);
+        memset(this->targets, 0, sizeof(this->targets));
+        memset(this->textures, 0, sizeof(this->textures));
+    }
+    this->compositor.release();
+    this->blend = 0;
+}
+
+// Makes each name in the library a scene, in the order first registered,
+// and picks its variant for every tier: the one specialized for it, or
+// else the nearest, the cheaper one on a tie. A variant as written counts
+// as QUALITY_DEFAULT.
+void sceneManager::group(){
+    std::vector<std::vector<int> > exact;
+    std::vector<int> firsts;
+    for (int i = 0; i < this->library->count(); i++) {
+        int first = this->library->find(this->library->name(i));
+        size_t scene = std::find(firsts.begin(), firsts.end(), first) - firsts.begin();
+        if (scene == firsts.size()) {
+            firsts.push_back(first);
+            exact.push_back(std::vector<int>(QUALITY_TIERS, -1));
+        }
+        int tier = this->library->tier(i);
+        exact[scene][tier >= 0 ? tier : QUALITY_DEFAULT] = i;
+    }
+    this->variants = exact;
+    for (size_t scene = 0; scene < exact.size(); scene++) {
+        for (int tier = 0; tier < QUALITY_TIERS; tier++) {
+            for (int distance = 1; this->variants[scene][tier] < 0; distance++) {
+                if (tier - distance >= 0 && exact[scene][tier - distance] >= 0) {
+                    this->variants[scene][tier] = exact[scene][tier - distance];
+                } else if (tier + distance < QUALITY_TIERS && exact[scene][tier + distance] >= 0) {
+                    this->variants[scene][tier] = exact[scene][tier + distance];
+                }
+            }
+        }
+    }
+}
+
+int sceneManager::variant(int scene){
+    return this->variants[scene][this->shown[scene]];
+}
+
+// Asks the loader for library variant `index`, at the front of the queue if `first`
+void sceneManager::queue(int index, bool first){
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        this->jobs.erase(std::remove(this->jobs.begin(), this->jobs.end(), index), this->jobs.end());
+        if (first) {
+            this->jobs.push_front(index);
+        } else {
+            this->jobs.push_back(index);
+        }
+    }
+    this->wake.notify_one();
+}
+
+// Loader thread: builds, attaches and warms one variant at a time on the
+// shared context, and rebuilds watched files when they are saved. Only it
+// calls the library between init() and release().
+void sceneManager::loadLoop(){
+    glfwMakeContextCurrent(this->loader);
+
+    // Container objects are not shared, so the loader has its own
+    float corners[] = { -1.0f, -1.0f, 3.0f, -1.0f, -1.0f, 3.0f };
+    GLuint vao, vbo, texture, target, values;
+    glGenVertexArrays(1, &vao);
+    glBindVertexArray(vao);
+    glGenBuffers(1, &vbo);
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, SCENE_WARM_SIZE, SCENE_WARM_SIZE, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glGenFramebuffers(1, &target);
+    glBindFramebuffer(GL_FRAMEBUFFER, target);
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+    glViewport(0, 0, SCENE_WARM_SIZE, SCENE_WARM_SIZE);
+    // A fixed copy of the parameters, so warming never touches the live buffer
+    glGenBuffers(1, &values);
+    glBindBuffer(GL_UNIFORM_BUFFER, values);
+    glBufferData(GL_UNIFORM_BUFFER, sizeof(frameParams), &this->warmValues, GL_STATIC_DRAW);
+    glBindBufferBase(GL_UNIFORM_BUFFER, PARAMS_BINDING, values);
+
+    std::vector<int> saved;
+    while (true) {
+        int index = -1;
+        {
+            std::unique_lock<std::mutex> guard(this->lock);
+            if (!this->stopping && this->jobs.empty()) {
+                this->wake.wait_for(guard, std::chrono::milliseconds(SCENE_WATCH_MS));
+            }
+            if (this->stopping) {
+                break;
+            }
+            if (!this->jobs.empty()) {
+                index = this->jobs.front();
+                this->jobs.pop_front();
+            }
+        }
+        if (index >= 0 && this->library->program(index) == 0) {
+            clock::time_point start = clock::now();
+            this->tried[index] = true;
+            this->library->build(index);
+            if (this->deliver(index, this->library->program(index), 0)) {
+                logInfo("Scene %s built at %s quality in %.1f ms (%s)", this->library->name(index), tierLabel(this->library->tier(index)),
+                        millis(clock::now() - start), this->library->cachedCount() > 0 ? "cached" : "compiled");
+            }
+        }
+
+        saved.clear();
+        this->watch.changed(saved);
+        for (size_t i = 0; i < saved.size(); i++) {
+            // A tier not built yet reads the file when it is
+            index = this->watched[saved[i]];
+            if (!this->tried[index]) {
+                continue;
+            }
+            clock::time_point start = clock::now();
+            GLuint replaced = 0;
+            int rebuilt = this->library->reload(index, &replaced);
+            if (rebuilt == 0) {
+                // The compile log is already out; what is on screen stays
+                logWarn("%s did not build; keeping the last good %s at %s quality", this->library->path(index), this->library->name(index),
+                        tierLabel(this->library->tier(index)));
+            }
+            if (rebuilt != 1) {
+                continue;
+            }
+            if (this->deliver(index, this->library->program(index), replaced)) {
+                logInfo("Scene %s reloaded from %s at %s quality in %.1f ms", this->library->name(index), this->library->path(index),
+                        tierLabel(this->library->tier(index)), millis(clock::now() - start));
+            }
+        }
+    }
+
+    glDeleteBuffers(1, &values);
+    glDeleteFramebuffers(1, &target);
+    glDeleteTextures(1, &texture);
+    glDeleteBuffers(1, &vbo);
+    glDeleteVertexArrays(1, &vao);
+    glFinish();
+    glfwMakeContextCurrent(NULL);
+}
+
+// Loader thread: attaches a freshly built program, draws it once and hands
+// it to the render thread with a fence on that draw. Returns 0 if there is
+// nothing to hand over but the failure.
+bool sceneManager::deliver(int index, GLuint program, GLuint replaced){
+    loaded result = { index, program, NULL, replaced };
+    bool ok = program != 0 && this->params->attach(program);
+    if (ok) {
+        glUseProgram(program);
+        glDrawArrays(GL_TRIANGLES, 0, 3);
+        result.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    } else {
+        result.program = 0;
+    }
+    // The render thread waits for the fence, so it has to reach the GPU
+    glFlush();
+    std::lock_guard<std::mutex> guard(this->lock);
+    this->done.push_back(result);
+    return ok;
+}
+
+// Takes what the loader finished and makes variants drawable once their
+// warm-up draw has completed. Polls; never waits. A reloaded program
+// replaces the one on screen between two frames, which is the only time
+// the old one can be deleted.
+void sceneManager::collect(){
+    {
+        std::lock_guard<std::mutex> guard(this->lock);
+        for (size_t i = 0; i < this->done.size(); i++) {
+            this->arrived.push_back(this->done[i]);
+        }
+        this->done.clear();
+    }
+    for (size_t i = 0; i < this->arrived.size(); ) {
+        loaded& item = this->arrived[i];
+        if (item.program == 0) {
+            // A reload that failed leaves the scene as it was
+            this->failed[item.variant] = this->programs[item.variant] == 0;
+        } else {
+            GLenum status = glClientWaitSync(item.fence, 0, 0);
+            if (status == GL_TIMEOUT_EXPIRED) {
+                // The loader's fences signal in order, and a scene's reloads
+                // must be swapped in in order, so nothing later is ready either
+                break;
+            }
+            glDeleteSync(item.fence);
+            if (status == GL_WAIT_FAILED) {
+                this->failed[item.variant] = this->programs[item.variant] == 0;
+            } else {
+                this->programs[item.variant] = item.program;
+                this->failed[item.variant] = false;
+                if (item.replaced != 0) {
+                    glDeleteProgram(item.replaced);
+                }
+            }
+        }
+        this->arrived.erase(this->arrived.begin() + i);
+    }
+}
+
+// Starts a switch to `scene`; it fades in once built and on a beat.
+// Picking another scene before the fade starts retargets the switch, and
+// picking the current one cancels it. The scene comes back at the tier it
+// was last drawn at. Returns 0 for a scene that does not exist or did not
+// build, and while a fade is under way.
+int sceneManager::switchTo(int scene){
+    if (scene < 0 || scene >= this->count() || this->failed[this->variant(scene)]) {
+        return 0;
+    }
+    if (this->state == SCENE_FADING) {
+        return scene == this->next;
+    }
+    if (scene == this->current) {
+        this->state = SCENE_IDLE;
+        this->next = -1;
+        return 1;
+    }
+    if (this->state == SCENE_IDLE) {
+        memset(&this->stats, 0, sizeof(this->stats));
+        this->stats.from = this->current;
+        this->stats.steadyWorstMs = this->steadyWorstMs;
+        this->requested = clock::now();
+    }
+    if (scene == this->next) {
+        return 1;
+    }
+    this->stats.to = scene;
+    this->next = scene;
+    this->state = SCENE_LOADING;
+    if (this->programs[this->variant(scene)] == 0) {
+        this->queue(this->variant(scene), true);
+    }
+    return 1;
+}
+
+int sceneManager::switchTo(const char* name){
+    for (int scene = 0; scene < this->count(); scene++) {
+        if (strcmp(this->name(scene), name) == 0) {
+            return this->switchTo(scene);
+        }
+    }
+    return 0;
+}
+
+// Time since the previous render() call, into the transition's stats or
+// the steady state's worst
+void sceneManager::frameTime(clock::time_point now){
+    if (!this->timed) {
+        this->timed = true;
+        this->lastFrame = now;
+        return;
+    }
+    double ms = millis(now - this->lastFrame);
+    this->lastFrame = now;
+    if (this->state == SCENE_IDLE) {
+        this->steadyWorstMs = std::max(this->steadyWorstMs, ms);
+        return;
+    }
+    this->stats.frames++;
+    this->stats.worstMs = std::max(this->stats.worstMs, ms);
+    this->stats.meanMs += ms;
+}
+
+void sceneManager::draw(int scene){
+    glUseProgram(this->programs[this->variant(scene)]);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glBindVertexArray(this->quad);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+}
+
+// Draws the frame into the bound framebuffer with the current parameters.
+// `beat` is true on a frame with a detected beat; `beatSeconds` is the
+// beat's length, for timing the fade.
+void sceneManager::render(bool beat, float beatSeconds){
+    clock::time_point now = clock::now();
+    this->frameTime(now);
+    this->collect();
+    this->settle();
+
+    if (this->state == SCENE_LOADING) {
+        if (this->programs[this->variant(this->next)] != 0) {
+            this->state = SCENE_WAITING;
+            this->ready = now;
+            this->stats.loadMs = millis(now - this->requested);
+        } else if (this->failed[this->variant(this->next)]) {
+            logWarn("Scene %s did not build; staying on %s", this->name(this->next), this->name(this->current));
+            this->state = SCENE_IDLE;
+            this->next = -1;
+        }
+    }
+    if (this->state == SCENE_WAITING
+        && (beat || std::chrono::duration<float>(now - this->ready).count() >= SCENE_BEAT_WAIT * beatSeconds)) {
+        this->state = SCENE_FADING;
+        this->fadeStart = now;
+        this->fadeSeconds = SCENE_FADE_BEATS * beatSeconds;
+    }
+
+    float amount = 0.0f;
+    if (this->state == SCENE_FADING) {
+        amount = std::chrono::duration<float>(now - this->fadeStart).count() / this->fadeSeconds;
+        if (amount >= 1.0f) {
+            this->stats.meanMs /= std::max(this->stats.frames, 1);
+            this->last = this->stats;
+            logInfo("Scene %s -> %s: worst frame %.2f ms (%.2f ms before), mean %.2f ms, ready after %.0f ms",
+                    this->name(this->last.from), this->name(this->last.to),
+                    this->last.worstMs, this->last.steadyWorstMs, this->last.meanMs, this->last.loadMs);
+            this->current = this->next;
+            this->next = -1;
+            this->state = SCENE_IDLE;
+            this->steadyWorstMs = 0.0;
+        }
+    }
+    if (this->state != SCENE_FADING) {
+        this->draw(this->current);
+        return;
+    }
+
+    GLint screen = 0;
+    glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &screen);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->targets[0]);
+    this->draw(this->current);
+    glBindFramebuffer(GL_FRAMEBUFFER, this->targets[1]);
+    this->draw(this->next);
+    glBindFramebuffer(GL_FRAMEBUFFER, screen);
+
+    glUseProgram(this->blend);
+    glUniform1f(this->mixLocation, amount);
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, this->textures[0]);
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, this->textures[1]);
+    glBindVertexArray(this->quad);
+    glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+    glActiveTexture(GL_TEXTURE0);
+}
+
+// Moves the scene on screen to the tier quality() picked once that tier's
+// program is drawable, or gives up on a tier that did not build
+void sceneManager::settle(){
+    int scene = this->current;
+    int tier = this->wanted[scene];
+    if (tier == this->shown[scene]) {
+        return;
+    }
+    int index = this->variants[scene][tier];
+    if (this->programs[index] != 0) {
+        logInfo("Scene %s quality %s -> %s", this->name(scene), qualityName(this->shown[scene]), qualityName(tier));
+        this->shown[scene] = tier;
+    } else if (this->failed[index]) {
+        logWarn("Scene %s did not build at %s quality; staying at %s", this->name(scene), qualityName(tier), qualityName(this->shown[scene]));
+        if (tier > this->shown[scene]) {
+            this->ceiling[scene] = this->shown[scene];
+        }
+        this->wanted[scene] = this->shown[scene];
+    }
+}
+
+// Fits the scene on screen to the GPU budget. `pressure` is
+// resolutionScaler::pressure() after the last frame; once it has pointed
+// the same way for SCENE_QUALITY_FRAMES frames in a row, the scene moves
+// one tier down (1) or up (-1). Frames during a switch or a tier change do
+// not count. A scene that had to come down from a tier never goes back up
+// to it, so it cannot flip between two tiers as the load swings.
+void sceneManager::quality(int pressure){
+    int scene = this->current;
+    if (this->state != SCENE_IDLE || this->wanted[scene] != this->shown[scene]) {
+        pressure = 0;
+    }
+    if (pressure == 0 || pressure != this->pressureSign) {
+        this->pressureSign = pressure;
+        this->pressureFrames = 0;
+        return;
+    }
+    if (++this->pressureFrames < SCENE_QUALITY_FRAMES) {
+        return;
+    }
+    this->pressureFrames = 0;
+    // Tiers the scene has no program of its own for change nothing
+    int tier = this->shown[scene] - pressure;
+    while (tier >= 0 && tier <= this->ceiling[scene] && this->variants[scene][tier] == this->variant(scene)) {
+        tier -= pressure;
+    }
+    if (tier < 0 || tier > this->ceiling[scene]) {
+        return;
+    }
+    if (pressure > 0) {
+        this->ceiling[scene] = tier;
+    }
+    int index = this->variants[scene][tier];
+    if (this->failed[index]) {
+        return;
+    }
+    this->wanted[scene] = tier;
+    if (this->programs[index] == 0) {
+        this->queue(index, true);
+    }
+}
+
+int sceneManager::count(){
+    return (int)this->variants.size();
+}
+
+const char* sceneManager::name(int scene){
+    return this->library->name(this->variants[scene][0]);
+}
+
+// The scene on screen; during a fade, the one fading out
+int sceneManager::scene(){
+    return this->current;
+}
+
+int sceneManager::tier(){
+    return this->shown[this->current];
+}
+
+bool sceneManager::switching(){
+    return this->state != SCENE_IDLE;
+}
+
+// Frame times of the last completed transition; from and to are -1 before the first
+transitionStats sceneManager::lastTransition(){
+    return this->last;
+}
@@ -0,0 +1,167 @@
+#ifndef SCENEMANAGER_H
+#define SCENEMANAGER_H
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+#include <deque>
+#include <vector>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <condition_variable>
+#include "shaderLibrary.h"
+#include "shaderParams.h"
+#include "shaderWatch.h"
+#include "shaderQuality.h"
+
+#define SCENE_FADE_BEATS 2.0f      // Length of a crossfade
+#define SCENE_BEAT_WAIT 2.0f       // Beats a ready scene waits for a beat before fading in anyway
+#define SCENE_WARM_SIZE 16         // Pixels a side of the loader's warm-up target
+#define SCENE_TARGETS 2            // Offscreen targets in the pool: outgoing and incoming scene
+#define SCENE_WATCH_MS 100         // Longest the loader goes between looking for saved shader files
+#define SCENE_QUALITY_FRAMES 180   // Frames over or under budget in a row before a scene changes quality tier
+
+// Frame times around one scene switch, from the switchTo() call to the end
+// of the crossfade, against the slowest frame before it
+typedef struct {
+    int from;
+    int to;
+    int frames;
+    double worstMs;
+    double meanMs;
+    double steadyWorstMs;   // Slowest frame between the previous transition and this one
+    double loadMs;          // switchTo() until the program was ready to draw
+} transitionStats;
+
+// Switches scenes while the visualiser runs, without the frame that used
+// to stall on a compile and link.
+//
+//   GLFWwindow* loader = ... hidden window sharing the main window's context ...
+//   sceneManager scenes;
+//   scenes.init(&library, &params, VAO, loader, "menger", QUALITY_HIGH, width, height);
+//   scenes.switchTo("kaleidoscope");     // From a key press, say
+//   // every frame, after params.upload():
+//   scenes.render(beat, beatSeconds);
+//   scenes.quality(scaler.pressure());   // Only to adapt the quality tier
+//   ...
+//   scenes.release();                    // Before library.release() and glfwTerminate()
+//
+// Only the first scene is built on the render thread. A loader thread owns
+// the hidden window's context and builds the others there, one
+// shaderLibrary::build() at a time: the requested scene first, the rest in
+// the background. It draws each new program once into a tiny target, since
+// drivers often finish compiling at the first draw, then fences that draw.
+// The render thread only polls the fence (never waits on it), so a scene is
+// used once the GPU has really run it. The switch itself starts on the
+// next beat and crossfades over SCENE_FADE_BEATS: both scenes are drawn
+// into the pooled offscreen targets and mixed onto the screen. Frame times
+// over every transition are logged and kept in lastTransition().
+//
+// Scenes the library reads from files (shaderLibrary::addFile()) are
+// watched while the loader runs. Saving one rebuilds it on the loader the
+// same way, and the render thread swaps the new program in between two
+// frames once its fence has signalled. A save that does not compile or
+// link only logs; the last good program stays on screen.
+//
+// A scene is every library variant under one name, one per quality tier
+// (shaderLibrary::add() with a tier); a tier it lacks uses the nearest it
+// has. Each scene is drawn at its own tier, and only that tier is built
+// up front. quality() moves the scene on screen down a tier when even the
+// smallest render scale is over the GPU budget and up one when the
+// largest leaves plenty to spare: the loader builds the other tier like
+// any scene and the render thread changes program between two frames.
+class sceneManager{
+    private:
+        enum {
+            SCENE_IDLE = 0,
+            SCENE_LOADING,      // Waiting for the loader to finish `next`
+            SCENE_WAITING,      // `next` is ready, waiting for a beat
+            SCENE_FADING
+        };
+        typedef struct {
+            int variant;        // Library variant
+            GLuint program;     // 0 if it failed to build
+            GLsync fence;       // Signalled once the warm-up draw has run
+            GLuint replaced;    // Program a reload replaces, deleted once it is off screen
+        } loaded;
+        typedef std::chrono::steady_clock clock;
+
+        shaderLibrary* library;
+        shaderParams* params;
+        GLFWwindow* loader;
+        GLuint quad;
+        int width;
+        int height;
+
+        std::vector<std::vector<int> > variants;  // Library variant of each scene at each tier
+
+        // Render thread only
+        std::vector<GLuint> programs;  // Per library variant, 0 until its fence has signalled
+        std::vector<bool> failed;
+        std::vector<loaded> arrived;   // Built, waiting on their fences
+        int current;
+        int next;
+        std::vector<int> shown;        // Tier each scene is drawn at
+        std::vector<int> wanted;       // Tier quality() picked, shown once it is built
+        std::vector<int> ceiling;      // Highest tier quality() may still pick for the scene
+        int pressureSign;
+        int pressureFrames;
+        int state;
+        clock::time_point requested;
+        clock::time_point ready;
+        clock::time_point fadeStart;
+        float fadeSeconds;
+        clock::time_point lastFrame;
+        bool timed;
+        GLuint targets[SCENE_TARGETS];
+        GLuint textures[SCENE_TARGETS];
+        shaderLibrary compositor;
+        GLuint blend;
+        GLint mixLocation;
+        transitionStats stats;
+        transitionStats last;
+        double steadyWorstMs;
+
+        // Shared with the loader thread under `lock`
+        std::mutex lock;
+        std::condition_variable wake;
+        std::deque<int> jobs;
+        std::vector<loaded> done;
+        bool stopping;
+        std::thread worker;
+        frameParams warmValues;
+
+        // Loader thread only
+        shaderWatch watch;
+        std::vector<int> watched;      // Library variant of each watch id
+        std::vector<bool> tried;       // Variants built so far, the ones a save rebuilds
+
+        void group();
+        int variant(int scene);        // At its shown tier
+        void loadLoop();
+        void queue(int index, bool first);
+        bool deliver(int index, GLuint program, GLuint replaced);
+        void collect();
+        void settle();
+        void frameTime(clock::time_point now);
+        void draw(int scene);
+    public:
+        sceneManager();
+
+        int init(shaderLibrary*, shaderParams*, GLuint quad, GLFWwindow* loader, const char* scene, int tier, int width, int height);
+        void release();   // Stops the loader thread; needs the context
+
+        int switchTo(int scene);
+        int switchTo(const char* name);
+        void render(bool beat, float beatSeconds);
+        void quality(int pressure);
+
+        int count();
+        const char* name(int scene);
+        int scene();
+        int tier();       // Of the scene on screen
+        bool switching();
+        transitionStats lastTransition();
+};
+
+#endif
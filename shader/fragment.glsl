@@ -1,10 +1,15 @@
 #version 330 core
 layout(location = 0) out vec4 fragColor;
 
-uniform vec2 u_resolution;
-uniform float u_time;
-
-const int MAX_STEPS = 300;
+#ifndef MAX_STEPS
+#define MAX_STEPS 300
+#endif
+#ifndef REFLECT_STEPS
+#define REFLECT_STEPS 15
+#endif
+#ifndef AO_SAMPLES
+#define AO_SAMPLES 10
+#endif
 const float MAX_DIST = 50;
 const float EPSILON = 0.0001;
 const float PI = acos(-1.0);
@@ -70,13 +75,13 @@ vec4 map(vec3 p) {
     float size = 0.5;
     vec3 col = vec3(1);
 
-    p.z += u_time * 0.3;
-    p.xy *= rot(u_time * 0.1);
+    p.z += continuous_time * 0.3;
+    p.xy *= rot(continuous_time * 0.1);
 
     d = -getInnerMenger(p, size);
 
 //    col = abs(floor(p * 6.0 * size - size) + 0.1);
-    col = hash33(floor(p * 3.0 * size - size) + 2e-5 * u_time);
+    col = hash33(floor(p * 3.0 * size - size) + 2e-5 * continuous_time);
 //    col = vec3(hash13(floor(p * 3.0 * size - 1.0 * size)));
     return vec4(col, d * 0.9);
 }
@@ -97,11 +102,10 @@ vec4 rayMarch(vec3 ro, vec3 rd, int steps) {
 
 
 float getAO(vec3 pos, vec3 norm) {
-    float AO_SAMPLES = 10.0;
     float AO_FACTOR = 1.0;
     float result = 1.0;
-    float s = -AO_SAMPLES;
-    float unit = 1.0 / AO_SAMPLES;
+    float s = -10.0;
+    float unit = 1.0 / float(AO_SAMPLES);
     for (float i = unit; i < 1.0; i += unit) {
         result -= pow(1.6, i * s) * (i - map(pos + i * norm).w);
     }
@@ -121,7 +125,7 @@ vec3 render(vec2 uv) {
     vec3 ro = vec3(0, 0, -1.9);
     vec3 rd = normalize(vec3(uv, 2.0));
 
-    mat2 rm = rot(PI * 0.5 + u_time * 0.25);
+    mat2 rm = rot(PI * 0.5 + continuous_time * 0.25);
     rd.xy *= rm;
     rd.xz *= rm;
 
@@ -140,7 +144,7 @@ vec3 render(vec2 uv) {
 
         // reflections
         vec3 ref_col;
-        vec4 ref_res = rayMarch(p + normal * 0.05, ref, 15);
+        vec4 ref_res = rayMarch(p + normal * 0.05, ref, REFLECT_STEPS);
         vec3 ref_p = p + ref * ref_res.w;
         vec3 ref_normal = getNormal(ref_p);
         ref_col = ref_res.rgb * max(0.0, dot(-ref, ref_normal));
@@ -0,0 +1,415 @@
+#include "shaderLibrary.h"
+#include "shaderQuality.h"
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+// 64-bit FNV-1a, enough to tell sources and drivers apart
+static uint64_t fnv1a(const std::string& text, uint64_t hash = 14695981039346656037ULL){
+    for (size_t i = 0; i < text.size(); i++) {
+        hash ^= (unsigned char)text[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static std::string glString(GLenum name){
+    const GLubyte* value = glGetString(name);
+    return value != NULL ? (const char*)value : "";
+}
+
+static bool readSource(const std::string& path, std::string& text){
+    FILE* file = fopen(path.c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    text.clear();
+    char chunk[4096];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, got);
+    }
+    bool ok = !ferror(file);
+    fclose(file);
+    return ok;
+}
+
+shaderLibrary::shaderLibrary(const char* vertexSource){
+    this->vertex = vertexSource;
+    this->binaries = false;
+    this->compiled = 0;
+    this->loaded = 0;
+}
+
+// Registers a fragment shader under `name`, specialized for quality
+// `tier` unless it is -1. Returns its index, or -1 if the name is taken at
+// that tier. Call before build().
+int shaderLibrary::add(const char* name, const std::string& fragmentSource, int tier){
+    if (this->find(name, tier) >= 0) {
+        printf("Shader %s is already registered%s%s\n", name, tier >= 0 ? " at " : "", qualityName(tier));
+        return -1;
+    }
+    variant v;
+    v.name = name;
+    v.filter = NULL;
+    v.tier = tier;
+    v.fragment = this->specialize(v, fragmentSource);
+    v.program = 0;
+    v.linking = 0;
+    v.shader = 0;
+    v.cached = false;
+    this->variants.push_back(v);
+    return (int)this->variants.size() - 1;
+}
+
+// Registers the fragment shader in the file at `path`, passed through
+// `filter` (shaderParams::inject, say) when it is not NULL. reload() reads
+// the file again. Returns the index, or -1 if the file cannot be read or
+// the name is taken at `tier`.
+int shaderLibrary::addFile(const char* name, const char* path, shaderFilter filter, int tier){
+    std::string text;
+    if (!readSource(path, text)) {
+        printf("Could not read shader %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    int index = this->add(name, filter != NULL ? filter(text.c_str()) : text, tier);
+    if (index >= 0) {
+        this->variants[index].path = path;
+        this->variants[index].filter = filter;
+    }
+    return index;
+}
+
+// The source a variant compiles from `text`, once filtered
+std::string shaderLibrary::specialize(const variant& v, const std::string& text){
+    return v.tier >= 0 ? qualitySpecialize(text, v.tier) : text;
+}
+
+// Named after the variant and its tier, so saving one tier never prunes another's
+static std::string cacheName(const std::string& name, int tier){
+    return tier >= 0 ? name + "." + qualityName(tier) : name;
+}
+
+std::string shaderLibrary::cachePath(const variant& v){
+    uint64_t key = fnv1a(v.fragment, fnv1a(this->vertex, fnv1a(this->driver)));
+    char hex[17];
+    snprintf(hex, sizeof(hex), "%016llx", (unsigned long long)key);
+    return std::string(SHADER_CACHE_DIR) + "/" + cacheName(v.name, v.tier) + "-" + hex + ".bin";
+}
+
+// A cache file is SHADER_CACHE_MAGIC, the binary format, the byte count,
+// then the bytes glGetProgramBinary gave
+bool shaderLibrary::loadCached(variant& v){
+    FILE* file = fopen(this->cachePath(v).c_str(), "rb");
+    if (file == NULL) {
+        return false;
+    }
+    uint32_t header[3];
+    std::vector<char> binary;
+    bool ok = fread(header, sizeof(header), 1, file) == 1 && header[0] == SHADER_CACHE_MAGIC && header[2] > 0;
+    if (ok) {
+        binary.resize(header[2]);
+        ok = fread(&binary[0], 1, binary.size(), file) == binary.size();
+    }
+    fclose(file);
+    if (!ok) {
+        return false;
+    }
+    // The driver may still refuse it, e.g. after an update that kept its version string
+    glProgramBinary(v.linking, header[1], &binary[0], (GLsizei)binary.size());
+    GLint linked = GL_FALSE;
+    glGetProgramiv(v.linking, GL_LINK_STATUS, &linked);
+    return linked == GL_TRUE;
+}
+
+// Writes the program's binary, replacing any older entry for the same name
+void shaderLibrary::saveCached(const variant& v){
+    GLint length = 0;
+    glGetProgramiv(v.linking, GL_PROGRAM_BINARY_LENGTH, &length);
+    if (length <= 0) {
+        return;
+    }
+    std::vector<char> binary(length);
+    GLenum format = 0;
+    GLsizei written = 0;
+    glGetProgramBinary(v.linking, length, &written, &format, &binary[0]);
+    if (written <= 0) {
+        return;
+    }
+
+    std::string path = this->cachePath(v);
+    std::string prefix = cacheName(v.name, v.tier) + "-";
+    DIR* dir = opendir(SHADER_CACHE_DIR);
+    if (dir != NULL) {
+        struct dirent* entry;
+        while ((entry = readdir(dir)) != NULL) {
+            std::string file = entry->d_name;
+            std::string full = std::string(SHADER_CACHE_DIR) + "/" + file;
+            if (file.compare(0, prefix.size(), prefix) == 0 && file.find('-', prefix.size()) == std::string::npos && full != path) {
+                remove(full.c_str());
+            }
+        }
+        closedir(dir);
+    }
+
+    // Written aside and renamed, so a crash never leaves half a binary under the real name
+    std::string temporary = path + ".tmp";
+    FILE* file = fopen(temporary.c_str(), "wb");
+    if (file == NULL) {
+        printf("Could not write %s: %s\n", temporary.c_str(), strerror(errno));
+        return;
+    }
+    uint32_t header[3] = { SHADER_CACHE_MAGIC, (uint32_t)format, (uint32_t)written };
+    bool ok = fwrite(header, sizeof(header), 1, file) == 1 && fwrite(&binary[0], 1, written, file) == (size_t)written;
+    ok = fclose(file) == 0 && ok;
+    if (!ok || rename(temporary.c_str(), path.c_str()) != 0) {
+        printf("Could not write %s\n", path.c_str());
+        remove(temporary.c_str());
+    }
+}
+
+// Compile or link status, printing the log on failure
+bool shaderLibrary::finished(GLuint object, GLenum kind){
+    GLint success = GL_FALSE;
+    GLchar infoLog[1024];
+    if (kind == GL_LINK_STATUS) {
+        glGetProgramiv(object, GL_LINK_STATUS, &success);
+        if (!success) {
+            glGetProgramInfoLog(object, sizeof(infoLog), NULL, infoLog);
+        }
+    } else {
+        glGetShaderiv(object, GL_COMPILE_STATUS, &success);
+        if (!success) {
+            glGetShaderInfoLog(object, sizeof(infoLog), NULL, infoLog);
+        }
+    }
+    if (!success) {
+        printf("%s\n", infoLog);
+    }
+    return success == GL_TRUE;
+}
+
+// Collects one compiled variant. The fragment shader is no longer needed
+// once the program is linked.
+bool shaderLibrary::check(variant& v, GLuint vertexShader){
+    bool ok = this->finished(v.shader, GL_COMPILE_STATUS);
+    if (!ok) {
+        printf("Shader %s failed to compile\n", v.name.c_str());
+    } else if (!(ok = this->finished(v.linking, GL_LINK_STATUS))) {
+        printf("Shader %s failed to link\n", v.name.c_str());
+    }
+    glDetachShader(v.linking, vertexShader);
+    glDetachShader(v.linking, v.shader);
+    glDeleteShader(v.shader);
+    v.shader = 0;
+    if (!ok) {
+        glDeleteProgram(v.linking);
+        v.linking = 0;
+    }
+    return ok;
+}
+
+// Reads the driver's identity and whether program binaries can be cached
+void shaderLibrary::prepare(){
+    this->driver = glString(GL_VENDOR) + "\n" + glString(GL_RENDERER) + "\n" + glString(GL_VERSION);
+    GLint formats = 0;
+    if (GLEW_ARB_get_program_binary) {
+        glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formats);
+    }
+    this->binaries = formats > 0;
+    if (this->binaries && mkdir(SHADER_CACHE_DIR, 0755) != 0 && errno != EEXIST) {
+        printf("Could not create %s: %s\n", SHADER_CACHE_DIR, strerror(errno));
+        this->binaries = false;
+    }
+}
+
+// Gives each variant in `pending` a linked program in `linking`, from the
+// cache or compiled, or leaves `linking` 0 if it does not build. Returns 0
+// if any did not.
+int shaderLibrary::compile(std::vector<variant*>& pending){
+    std::vector<variant*> compiling;
+    for (size_t i = 0; i < pending.size(); i++) {
+        variant& v = *pending[i];
+        v.linking = glCreateProgram();
+        if (this->binaries && this->loadCached(v)) {
+            this->loaded++;
+        } else {
+            compiling.push_back(&v);
+        }
+    }
+    if (compiling.empty()) {
+        return 1;
+    }
+
+    // Let the driver compile on as many threads as it likes
+    if (GLEW_KHR_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+    } else if (GLEW_ARB_parallel_shader_compile) {
+        glMaxShaderCompilerThreadsARB(0xFFFFFFFF);
+    }
+    const char* text = this->vertex.c_str();
+    GLuint vertexShader = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vertexShader, 1, &text, NULL);
+    glCompileShader(vertexShader);
+    // Submit everything first; asking for any status would wait for that compile
+    for (size_t i = 0; i < compiling.size(); i++) {
+        text = compiling[i]->fragment.c_str();
+        compiling[i]->shader = glCreateShader(GL_FRAGMENT_SHADER);
+        glShaderSource(compiling[i]->shader, 1, &text, NULL);
+        glCompileShader(compiling[i]->shader);
+    }
+    for (size_t i = 0; i < compiling.size(); i++) {
+        variant& v = *compiling[i];
+        glAttachShader(v.linking, vertexShader);
+        glAttachShader(v.linking, v.shader);
+        if (this->binaries) {
+            glProgramParameteri(v.linking, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+        }
+        glLinkProgram(v.linking);
+    }
+
+    bool ok = this->finished(vertexShader, GL_COMPILE_STATUS);
+    for (size_t i = 0; i < compiling.size(); i++) {
+        variant& v = *compiling[i];
+        if (!this->check(v, vertexShader)) {
+            ok = false;
+            continue;
+        }
+        if (this->binaries) {
+            this->saveCached(v);
+        }
+        this->compiled++;
+    }
+    glDeleteShader(vertexShader);
+    return ok ? 1 : 0;
+}
+
+// Builds the registered programs that are not built yet, or only variant
+// `only` when it is not negative. Returns 1 if they all built; a variant
+// that failed keeps program 0 and the others are still usable. Works on
+// whichever context is current, which may be one shared with the renderer:
+// program() only changes once a variant's program is completely linked.
+// A file-backed variant is read again first, so one built long after
+// startup (a quality tier nobody needed until now) has the latest edits.
+int shaderLibrary::build(int only){
+    this->prepare();
+    this->compiled = 0;
+    this->loaded = 0;
+    std::vector<variant*> pending;
+    for (size_t i = 0; i < this->variants.size(); i++) {
+        variant& v = this->variants[i];
+        if ((only < 0 || (int)i == only) && v.program == 0) {
+            std::string text;
+            if (!v.path.empty() && readSource(v.path, text)) {
+                v.fragment = this->specialize(v, v.filter != NULL ? v.filter(text.c_str()) : text);
+            }
+            pending.push_back(&v);
+        }
+    }
+    int ok = this->compile(pending);
+    for (size_t i = 0; i < pending.size(); i++) {
+        pending[i]->program = pending[i]->linking;
+    }
+    return ok;
+}
+
+// Reads a file-backed variant's source again and, if it changed, builds it
+// into a new program. Returns 1 when the new program is built: program()
+// is then the new one and *replaced the one before (or 0), which is the
+// caller's to delete once nothing draws with it. Returns 0 if the file
+// cannot be read or does not build, and -1 if it has not changed; either
+// way the last good program stays.
+int shaderLibrary::reload(int index, GLuint* replaced){
+    variant& v = this->variants[index];
+    std::string text;
+    if (v.path.empty() || !readSource(v.path, text)) {
+        printf("Could not read shader %s\n", v.path.c_str());
+        return 0;
+    }
+    if (v.filter != NULL) {
+        text = v.filter(text.c_str());
+    }
+    text = this->specialize(v, text);
+    if (text == v.fragment && v.program != 0) {
+        return -1;
+    }
+    this->prepare();
+    this->compiled = 0;
+    this->loaded = 0;
+    v.fragment = text;
+    std::vector<variant*> pending(1, &v);
+    this->compile(pending);
+    if (v.linking == 0) {
+        return 0;
+    }
+    *replaced = v.program;
+    v.program = v.linking;
+    return 1;
+}
+
+void shaderLibrary::release(){
+    for (size_t i = 0; i < this->variants.size(); i++) {
+        if (this->variants[i].program != 0) {
+            glDeleteProgram(this->variants[i].program);
+            this->variants[i].program = 0;
+        }
+    }
+}
+
+int shaderLibrary::count(){
+    return (int)this->variants.size();
+}
+
+// Index of the first variant called `name`, -1 if there is none
+int shaderLibrary::find(const char* name){
+    for (size_t i = 0; i < this->variants.size(); i++) {
+        if (this->variants[i].name == name) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+// Index of the variant called `name` specialized for `tier` (-1 for the
+// one as written), -1 if there is none
+int shaderLibrary::find(const char* name, int tier){
+    for (size_t i = 0; i < this->variants.size(); i++) {
+        if (this->variants[i].name == name && this->variants[i].tier == tier) {
+            return (int)i;
+        }
+    }
+    return -1;
+}
+
+const char* shaderLibrary::name(int index){
+    return this->variants[index].name.c_str();
+}
+
+// File a variant is read from, "" for one registered from a string
+const char* shaderLibrary::path(int index){
+    return this->variants[index].path.c_str();
+}
+
+// Quality tier a variant is specialized for, -1 if it is as written
+int shaderLibrary::tier(int index){
+    return this->variants[index].tier;
+}
+
+GLuint shaderLibrary::program(int index){
+    return index >= 0 && index < (int)this->variants.size() ? this->variants[index].program : 0;
+}
+
+GLuint shaderLibrary::program(const char* name){
+    return this->program(this->find(name));
+}
+
+int shaderLibrary::compiledCount(){
+    return this->compiled;
+}
+
+int shaderLibrary::cachedCount(){
+    return this->loaded;
+}
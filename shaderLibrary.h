@@ -0,0 +1,89 @@
+#ifndef SHADERLIBRARY_H
+#define SHADERLIBRARY_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+
+#define SHADER_CACHE_DIR ".shadercache" // Linked program binaries, one file per program
+#define SHADER_CACHE_MAGIC 0x53484243u  // "SHBC", first word of every cache file
+
+typedef std::string (*shaderFilter)(const char* source);
+
+// Every fragment shader variant, each linked with one shared vertex shader
+// into a program at startup, so a scene is picked by name at run time
+// instead of by editing main.cpp.
+//
+//   shaderLibrary library(vertexShaderSource);
+//   library.add("menger", shaderParams::inject(fragmentShaderSource7));
+//   ...
+//   library.build();                 // Compiles, or loads from the cache
+//   glUseProgram(library.program("menger"));
+//
+// build() first tries the on-disk cache: programs are stored with
+// glGetProgramBinary under a key hashed from their sources and the
+// driver's vendor, renderer and version strings, so a warm start skips
+// GLSL compilation entirely and a driver update just misses the cache.
+// Whatever is not cached is compiled all at once: every shader and program
+// is submitted before any status is asked for, which with
+// KHR_parallel_shader_compile (or the ARB version) lets the driver spread
+// the work over its own threads.
+//
+// A variant can also come from a file (addFile()); reload() rebuilds it
+// from the file's current contents and swaps the new program in only if
+// it links, so a typo while editing leaves the last good program in use.
+//
+// One name can be registered once per quality tier (shaderQuality.h): each
+// tier is its own variant, specialized when added and again on every
+// reload, with its own cache entry.
+class shaderLibrary{
+    private:
+        typedef struct {
+            std::string name;
+            std::string fragment;
+            std::string path;        // Source file, empty for built-in sources
+            shaderFilter filter;     // Applied to the file's text
+            int tier;                // Quality tier it is specialized for, -1 for as written
+            GLuint program;          // 0 until built
+            GLuint linking;          // The program while build() works on it
+            GLuint shader;           // Fragment shader while it compiles
+            bool cached;
+        } variant;
+
+        std::string vertex;
+        std::vector<variant> variants;
+        std::string driver;          // Vendor, renderer and version, part of every cache key
+        bool binaries;               // Program binaries can be saved and loaded
+        int compiled;
+        int loaded;
+
+        std::string cachePath(const variant&);
+        bool loadCached(variant&);
+        void saveCached(const variant&);
+        bool finished(GLuint object, GLenum kind);
+        bool check(variant&, GLuint vertexShader);
+        std::string specialize(const variant&, const std::string& text);
+        void prepare();
+        int compile(std::vector<variant*>& pending);
+    public:
+        shaderLibrary(const char* vertexSource);
+
+        int add(const char* name, const std::string& fragmentSource, int tier = -1);
+        int addFile(const char* name, const char* path, shaderFilter filter = NULL, int tier = -1);
+        int build(int only = -1);
+        int reload(int index, GLuint* replaced);
+        void release();   // Deletes the programs; needs the context
+
+        int count();
+        int find(const char* name);             // Its first variant, whatever the tier
+        int find(const char* name, int tier);
+        const char* name(int);
+        const char* path(int);
+        int tier(int);
+        GLuint program(int);
+        GLuint program(const char* name);
+        int compiledCount();   // Programs the last build() compiled from source
+        int cachedCount();     // And the ones it loaded from the cache
+};
+
+#endif
@@ -0,0 +1,280 @@
+#include "shaderParams.h"
+#include <stdio.h>
+#include <string.h>
+
+// GLSL side of frameParams. The members keep the names the shaders used
+// as loose uniforms.
+static const char* paramsBlockSource =
+    "layout(std140) uniform " PARAMS_BLOCK " {\n"
+    "    vec2 u_resolution;\n"
+    "    vec2 u_offset;\n"
+    "    vec2 u_c;\n"
+    "    float u_zoom;\n"
+    "    float c_parameter_r;\n"
+    "    float c_parameter_g;\n"
+    "    float c_parameter_b;\n"
+    "    float amplitude;\n"
+    "    float u_time;\n"
+    "    float continuous_time;\n"
+    "};\n";
+
+typedef struct {
+    const char* name;
+    size_t offset;
+} paramsMember;
+
+static const paramsMember paramsLayout[] = {
+    { "u_resolution", offsetof(frameParams, resolution) },
+    { "u_offset", offsetof(frameParams, offset) },
+    { "u_c", offsetof(frameParams, c) },
+    { "u_zoom", offsetof(frameParams, zoom) },
+    { "c_parameter_r", offsetof(frameParams, colorR) },
+    { "c_parameter_g", offsetof(frameParams, colorG) },
+    { "c_parameter_b", offsetof(frameParams, colorB) },
+    { "amplitude", offsetof(frameParams, amplitude) },
+    { "u_time", offsetof(frameParams, beatDuration) },
+    { "continuous_time", offsetof(frameParams, time) },
+};
+static const int paramsCount = sizeof(paramsLayout) / sizeof(paramsLayout[0]);
+
+static_assert(sizeof(frameParams) % 16 == 0, "std140 rounds a block up to 16 bytes");
+
+shaderParams::shaderParams(){
+    memset(&this->values, 0, sizeof(this->values));
+    this->buffer = 0;
+    this->persistent = false;
+    this->mapped = NULL;
+    this->regionBytes = sizeof(frameParams);
+    this->region = 0;
+    for (int r = 0; r < PARAMS_RING_REGIONS; r++) {
+        this->fences[r] = 0;
+    }
+    this->dirtyFrom = 0;
+    this->dirtyTo = 0;
+}
+
+// Creates the uniform buffer and binds it at PARAMS_BINDING. Needs a
+// current context. Returns 1 on success.
+int shaderParams::init(){
+    if (this->buffer != 0) {
+        return 1;
+    }
+    while (glGetError() != GL_NO_ERROR) {
+    }
+    GLint alignment = 256;
+    glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+    this->regionBytes = (sizeof(frameParams) + alignment - 1) / alignment * alignment;
+    this->region = 0;
+
+    glGenBuffers(1, &this->buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+    this->persistent = false;
+    if (GLEW_ARB_buffer_storage) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(GL_UNIFORM_BUFFER, this->regionBytes * PARAMS_RING_REGIONS, NULL, flags);
+        this->mapped = (unsigned char*)glMapBufferRange(GL_UNIFORM_BUFFER, 0, this->regionBytes * PARAMS_RING_REGIONS, flags);
+        if (this->mapped != NULL) {
+            this->persistent = true;
+        } else {
+            // Storage is immutable once allocated, so start over with a plain buffer
+            glDeleteBuffers(1, &this->buffer);
+            glGenBuffers(1, &this->buffer);
+            glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        }
+    }
+    if (this->persistent) {
+        memcpy(this->mapped, &this->values, sizeof(frameParams));
+    } else {
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(frameParams), &this->values, GL_DYNAMIC_DRAW);
+    }
+    glBindBufferRange(GL_UNIFORM_BUFFER, PARAMS_BINDING, this->buffer, 0, sizeof(frameParams));
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    this->dirtyFrom = 0;
+    this->dirtyTo = 0;
+    if (glGetError() != GL_NO_ERROR) {
+        printf("Could not create the shader parameter buffer\n");
+        this->release();
+        return 0;
+    }
+    return 1;
+}
+
+void shaderParams::release(){
+    for (int r = 0; r < PARAMS_RING_REGIONS; r++) {
+        if (this->fences[r] != 0) {
+            glDeleteSync(this->fences[r]);
+            this->fences[r] = 0;
+        }
+    }
+    if (this->mapped != NULL) {
+        glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        glUnmapBuffer(GL_UNIFORM_BUFFER);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        this->mapped = NULL;
+    }
+    if (this->buffer != 0) {
+        glDeleteBuffers(1, &this->buffer);
+        this->buffer = 0;
+    }
+    this->persistent = false;
+}
+
+// Reflects the program's FrameParams block once, after linking: checks
+// that every member sits where frameParams puts it and points the block
+// at PARAMS_BINDING. Returns 0 (and says why) for a program without the
+// block or with a layout that does not match.
+int shaderParams::attach(GLuint program){
+    GLuint block = glGetUniformBlockIndex(program, PARAMS_BLOCK);
+    if (block == GL_INVALID_INDEX) {
+        printf("Program %u has no %s block; was its source passed through shaderParams::inject()?\n", program, PARAMS_BLOCK);
+        return 0;
+    }
+    GLint blockBytes = 0;
+    glGetActiveUniformBlockiv(program, block, GL_UNIFORM_BLOCK_DATA_SIZE, &blockBytes);
+    if (blockBytes > (GLint)sizeof(frameParams)) {
+        printf("%s is %d bytes in program %u, frameParams only %d\n", PARAMS_BLOCK, blockBytes, program, (int)sizeof(frameParams));
+        return 0;
+    }
+
+    // std140 members are all active, used or not, so each one is there to look up
+    const GLchar* names[paramsCount];
+    GLuint indices[paramsCount];
+    GLint offsets[paramsCount];
+    for (int m = 0; m < paramsCount; m++) {
+        names[m] = paramsLayout[m].name;
+    }
+    glGetUniformIndices(program, paramsCount, names, indices);
+    for (int m = 0; m < paramsCount; m++) {
+        if (indices[m] == GL_INVALID_INDEX) {
+            printf("%s.%s is missing from program %u\n", PARAMS_BLOCK, names[m], program);
+            return 0;
+        }
+    }
+    glGetActiveUniformsiv(program, paramsCount, indices, GL_UNIFORM_OFFSET, offsets);
+    for (int m = 0; m < paramsCount; m++) {
+        if (offsets[m] != (GLint)paramsLayout[m].offset) {
+            printf("%s.%s is at byte %d in program %u, frameParams has it at %d\n",
+                   PARAMS_BLOCK, names[m], offsets[m], program, (int)paramsLayout[m].offset);
+            return 0;
+        }
+    }
+    glUniformBlockBinding(program, block, PARAMS_BINDING);
+    return 1;
+}
+
+void shaderParams::set(float* field, const float* value, int count){
+    if (memcmp(field, value, sizeof(float) * count) == 0) {
+        return;
+    }
+    memcpy(field, value, sizeof(float) * count);
+    size_t from = (const unsigned char*)field - (const unsigned char*)&this->values;
+    size_t to = from + sizeof(float) * count;
+    if (this->dirtyFrom == this->dirtyTo) {
+        this->dirtyFrom = from;
+        this->dirtyTo = to;
+    } else {
+        this->dirtyFrom = from < this->dirtyFrom ? from : this->dirtyFrom;
+        this->dirtyTo = to > this->dirtyTo ? to : this->dirtyTo;
+    }
+}
+
+// Sends whatever changed since the last call. Call once a frame, before drawing.
+void shaderParams::upload(){
+    if (this->buffer == 0 || this->dirtyFrom == this->dirtyTo) {
+        return;
+    }
+    if (this->persistent) {
+        this->uploadPersistent();
+    } else {
+        glBindBuffer(GL_UNIFORM_BUFFER, this->buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, this->dirtyFrom, this->dirtyTo - this->dirtyFrom,
+                        (const unsigned char*)&this->values + this->dirtyFrom);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+    }
+    this->dirtyFrom = 0;
+    this->dirtyTo = 0;
+}
+
+// Moves on to the next region: the draws so far are fenced against the
+// region they used, and the next one is only written once its own fence
+// (PARAMS_RING_REGIONS - 1 frames old) has passed
+void shaderParams::uploadPersistent(){
+    this->fences[this->region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    this->region = (this->region + 1) % PARAMS_RING_REGIONS;
+    GLsync fence = this->fences[this->region];
+    if (fence != 0) {
+        glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000ULL);
+        glDeleteSync(fence);
+        this->fences[this->region] = 0;
+    }
+    // A region holds a whole block, so the untouched members are copied too
+    GLintptr at = this->regionBytes * this->region;
+    memcpy(this->mapped + at, &this->values, sizeof(frameParams));
+    glBindBufferRange(GL_UNIFORM_BUFFER, PARAMS_BINDING, this->buffer, at, sizeof(frameParams));
+}
+
+bool shaderParams::isPersistent(){
+    return this->persistent;
+}
+
+void shaderParams::setResolution(float width, float height){
+    float value[2] = { width, height };
+    this->set(this->values.resolution, value, 2);
+}
+
+void shaderParams::setOffset(float x, float y){
+    float value[2] = { x, y };
+    this->set(this->values.offset, value, 2);
+}
+
+void shaderParams::setC(float x, float y){
+    float value[2] = { x, y };
+    this->set(this->values.c, value, 2);
+}
+
+void shaderParams::setZoom(float zoom){
+    this->set(&this->values.zoom, &zoom, 1);
+}
+
+// colorR to colorB are adjacent, so one range covers all three
+void shaderParams::setColor(float r, float g, float b){
+    float value[3] = { r, g, b };
+    this->set(&this->values.colorR, value, 3);
+}
+
+void shaderParams::setAmplitude(float amplitude){
+    this->set(&this->values.amplitude, &amplitude, 1);
+}
+
+void shaderParams::setBeatDuration(float seconds){
+    this->set(&this->values.beatDuration, &seconds, 1);
+}
+
+void shaderParams::setTime(float seconds){
+    this->set(&this->values.time, &seconds, 1);
+}
+
+const frameParams& shaderParams::current(){
+    return this->values;
+}
+
+// The source with the FrameParams block after its #version line, and a
+// #line so compile errors still point at the shader's own lines
+std::string shaderParams::inject(const char* source){
+    std::string text = source;
+    size_t version = text.find("#version");
+    size_t at = 0;
+    int nextLine = 1;
+    if (version != std::string::npos) {
+        size_t end = text.find('\n', version);
+        at = end == std::string::npos ? text.size() : end + 1;
+        for (size_t i = 0; i < at; i++) {
+            if (text[i] == '\n') {
+                nextLine++;
+            }
+        }
+    }
+    char line[32];
+    snprintf(line, sizeof(line), "#line %d\n", nextLine);
+    return text.substr(0, at) + paramsBlockSource + line + text.substr(at);
+}
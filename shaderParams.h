@@ -0,0 +1,88 @@
+#ifndef SHADERPARAMS_H
+#define SHADERPARAMS_H
+
+#include <GL/glew.h>
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+#define PARAMS_BLOCK "FrameParams" // Name of the uniform block in every fragment shader
+#define PARAMS_BINDING 0           // Uniform buffer binding point it is read from
+#define PARAMS_RING_REGIONS 3      // Frames the persistently mapped buffer rotates through
+
+// CPU mirror of the FrameParams block, laid out by the std140 rules: vec2
+// on 8 bytes, float on 4, the block rounded up to 16. Field order here and
+// in paramsBlockSource (shaderParams.cpp) must match; shaderParams::attach()
+// checks every offset against the linked program.
+typedef struct {
+    float resolution[2];   // u_resolution, pixels
+    float offset[2];       // u_offset
+    float c[2];            // u_c, the Julia constant
+    float zoom;            // u_zoom
+    float colorR;          // c_parameter_r
+    float colorG;          // c_parameter_g
+    float colorB;          // c_parameter_b
+    float amplitude;       // amplitude, normalised loudness
+    float beatDuration;    // u_time, seconds per beat
+    float time;            // continuous_time, seconds since start
+    float pad[3];
+} frameParams;
+
+// Replaces per-frame glGetUniformLocation/glUniform* with one uniform
+// buffer shared by every shader program. Shaders no longer declare the
+// parameters themselves: inject() puts the FrameParams block right after
+// their #version line, and its members keep the old uniform names, so the
+// shader bodies read them unchanged.
+//
+//   shaderParams params;
+//   params.init();
+//   std::string source = shaderParams::inject(fragmentShaderSource7);
+//   ... compile and link ...
+//   params.attach(program);          // Once per program, after linking
+//   // every frame:
+//   params.setZoom(zoom);
+//   params.setTime(now);
+//   params.upload();                 // Only if something changed
+//
+// Setters only touch the CPU mirror and widen the dirty byte range.
+// upload() then sends that range with one glBufferSubData, or, where
+// ARB_buffer_storage is available, writes the block into the next region
+// of a persistently mapped ring and rebinds that region, fenced so the CPU
+// never overwrites a region the GPU may still be reading.
+class shaderParams{
+    private:
+        frameParams values;
+        GLuint buffer;
+        bool persistent;
+        unsigned char* mapped;         // Persistent mapping of the whole ring
+        GLsizeiptr regionBytes;        // One block, rounded up to the offset alignment
+        int region;                    // Region bound at PARAMS_BINDING
+        GLsync fences[PARAMS_RING_REGIONS];
+        size_t dirtyFrom;              // Byte range of values changed since the last upload
+        size_t dirtyTo;
+
+        void set(float* field, const float* value, int count);
+        void uploadPersistent();
+    public:
+        shaderParams();
+
+        int init();
+        void release();   // Needs the context, so call it before glfwTerminate()
+        int attach(GLuint program);
+        void upload();
+        bool isPersistent();
+
+        void setResolution(float width, float height);
+        void setOffset(float x, float y);
+        void setC(float x, float y);
+        void setZoom(float);
+        void setColor(float r, float g, float b);
+        void setAmplitude(float);
+        void setBeatDuration(float);
+        void setTime(float);
+        const frameParams& current();
+
+        static std::string inject(const char* source);
+};
+
+#endif
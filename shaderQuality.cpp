@@ -0,0 +1,67 @@
+#include "shaderQuality.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+static const char* tierNames[QUALITY_TIERS] = { "low", "medium", "high", "ultra" };
+
+typedef struct {
+    const char* name;
+    int percent[QUALITY_TIERS];   // Of the shader's own default, per tier
+    bool capped;                  // Never above the default (it sizes an array)
+} qualityBound;
+
+static const qualityBound bounds[] = {
+    { "MAX_ITER",      { 25, 50, 100, 200 }, false },
+    { "MAX_STEPS",     { 35, 60, 100, 150 }, false },
+    { "NUM_SAMPLES",   { 25, 50, 100, 100 }, true },
+    { "AO_SAMPLES",    { 40, 60, 100, 160 }, false },
+    { "REFLECT_STEPS", { 35, 70, 100, 200 }, false }
+};
+
+const char* qualityName(int tier){
+    return tier >= 0 && tier < QUALITY_TIERS ? tierNames[tier] : "";
+}
+
+int qualityTier(const char* name){
+    for (int t = 0; t < QUALITY_TIERS; t++) {
+        if (strcmp(name, tierNames[t]) == 0) {
+            return t;
+        }
+    }
+    return -1;
+}
+
+// The source with each known bound #defined for `tier` after its #version
+// line, and a #line so compile errors still point at the shader's own lines
+std::string qualitySpecialize(const std::string& source, int tier){
+    std::string defines;
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++) {
+        std::string directive = std::string("#define ") + bounds[b].name + " ";
+        size_t at = source.find(directive);
+        if (at == std::string::npos) {
+            continue;
+        }
+        int value = atoi(source.c_str() + at + directive.size());
+        int scaled = std::max(1, value * bounds[b].percent[tier] / 100);
+        if (bounds[b].capped) {
+            scaled = std::min(scaled, value);
+        }
+        char line[64];
+        snprintf(line, sizeof(line), "#define %s %d\n", bounds[b].name, scaled);
+        defines += line;
+    }
+
+    size_t version = source.find("#version");
+    size_t at = 0;
+    int nextLine = 1;
+    if (version != std::string::npos) {
+        size_t end = source.find('\n', version);
+        at = end == std::string::npos ? source.size() : end + 1;
+        nextLine += (int)std::count(source.begin(), source.begin() + at, '\n');
+    }
+    char line[32];
+    snprintf(line, sizeof(line), "#line %d\n", nextLine);
+    return source.substr(0, at) + defines + line + source.substr(at);
+}
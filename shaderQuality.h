@@ -0,0 +1,36 @@
+#ifndef SHADERQUALITY_H
+#define SHADERQUALITY_H
+
+#include <string>
+
+// Quality tiers a scene can be built at. HIGH is each shader as written.
+enum {
+    QUALITY_LOW = 0,
+    QUALITY_MEDIUM,
+    QUALITY_HIGH,
+    QUALITY_ULTRA,
+    QUALITY_TIERS
+};
+
+#define QUALITY_DEFAULT QUALITY_HIGH
+
+// Shader specialization. The loop bounds that decide a shader's cost are
+// preprocessor constants with a default:
+//
+//   #ifndef MAX_ITER
+//   #define MAX_ITER 2000
+//   #endif
+//
+// and qualitySpecialize() puts a #define of each one, scaled for the tier,
+// right after the #version line. Every tier is an ordinary program with
+// constant loop bounds, so the driver unrolls and schedules it exactly as
+// it does the shader as written; nothing reads a bound at run time. The
+// bounds it knows are MAX_ITER and MAX_STEPS (escape-time iterations and
+// ray-march steps), NUM_SAMPLES (supersamples per pixel, at most the
+// shader's own), AO_SAMPLES and REFLECT_STEPS. A shader without one of
+// them is left alone there.
+const char* qualityName(int tier);            // "low", "medium", "high" or "ultra"
+int qualityTier(const char* name);            // -1 for anything else
+std::string qualitySpecialize(const std::string& source, int tier);
+
+#endif
@@ -0,0 +1,76 @@
+#include "shaderWatch.h"
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+
+shaderWatch::shaderWatch(){
+    this->fd = -1;
+}
+
+shaderWatch::~shaderWatch(){
+    this->close();
+}
+
+// Starts watching `path`. Returns its id for changed(), or -1.
+int shaderWatch::add(const char* path){
+    if (this->fd < 0) {
+        this->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (this->fd < 0) {
+            printf("Could not start watching files: %s\n", strerror(errno));
+            return -1;
+        }
+    }
+    entry e;
+    std::string full = path;
+    size_t slash = full.rfind('/');
+    e.directory = slash == std::string::npos ? "." : full.substr(0, slash);
+    e.file = slash == std::string::npos ? full : full.substr(slash + 1);
+    // A directory watched twice gets the same descriptor back
+    e.watch = inotify_add_watch(this->fd, e.directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+    if (e.watch < 0) {
+        printf("Could not watch %s: %s\n", e.directory.c_str(), strerror(errno));
+        return -1;
+    }
+    this->entries.push_back(e);
+    return (int)this->entries.size() - 1;
+}
+
+// Appends the ids of the files saved since the last call to `ids`, each
+// once. Returns how many there were.
+int shaderWatch::changed(std::vector<int>& ids){
+    if (this->fd < 0) {
+        return 0;
+    }
+    int found = 0;
+    // Aligned as the kernel expects struct inotify_event to be
+    char buffer[WATCH_EVENT_BYTES] __attribute__((aligned(__alignof__(struct inotify_event))));
+    ssize_t got;
+    while ((got = read(this->fd, buffer, sizeof(buffer))) > 0) {
+        for (char* at = buffer; at < buffer + got; ) {
+            const struct inotify_event* event = (const struct inotify_event*)at;
+            at += sizeof(struct inotify_event) + event->len;
+            if (event->len == 0) {
+                continue;
+            }
+            for (size_t i = 0; i < this->entries.size(); i++) {
+                if (this->entries[i].watch == event->wd && this->entries[i].file == event->name
+                    && std::find(ids.begin(), ids.end(), (int)i) == ids.end()) {
+                    ids.push_back((int)i);
+                    found++;
+                }
+            }
+        }
+    }
+    return found;
+}
+
+void shaderWatch::close(){
+    if (this->fd >= 0) {
+        ::close(this->fd);
+        this->fd = -1;
+    }
+    this->entries.clear();
+}
@@ -0,0 +1,41 @@
+#ifndef SHADERWATCH_H
+#define SHADERWATCH_H
+
+#include <string>
+#include <vector>
+
+#define WATCH_EVENT_BYTES 4096 // inotify events read per system call
+
+// Tells which of a set of files were saved since the last look, through
+// inotify. The directories are watched rather than the files: editors that
+// save by writing a new file and renaming it over the old one replace the
+// file's inode, which a watch on the file itself would lose.
+//
+//   shaderWatch watch;
+//   int id = watch.add("shader/fragment.glsl");
+//   ...
+//   std::vector<int> saved;
+//   if (watch.changed(saved)) ...     // Never blocks
+//
+// A file counts as saved when it is closed after writing or renamed into
+// place, so a save is reported once, not once per write.
+class shaderWatch{
+    private:
+        typedef struct {
+            std::string directory;
+            std::string file;
+            int watch;
+        } entry;
+
+        int fd;
+        std::vector<entry> entries;
+    public:
+        shaderWatch();
+        ~shaderWatch();
+
+        int add(const char* path);
+        int changed(std::vector<int>& ids);
+        void close();
+};
+
+#endif
@@ -0,0 +1,593 @@
+#include "simdKernels.h"
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_X86 1
+#include <immintrin.h>
+#endif
+
+// Paeth's 19-exchange median-of-9 network; the median ends up in p[4]
+#define MEDIAN9_NETWORK(EXCHANGE) \
+    EXCHANGE(1, 2) EXCHANGE(4, 5) EXCHANGE(7, 8) EXCHANGE(0, 1) EXCHANGE(3, 4) EXCHANGE(6, 7) \
+    EXCHANGE(1, 2) EXCHANGE(4, 5) EXCHANGE(7, 8) EXCHANGE(0, 3) EXCHANGE(5, 8) EXCHANGE(4, 7) \
+    EXCHANGE(3, 6) EXCHANGE(1, 4) EXCHANGE(2, 5) EXCHANGE(4, 7) EXCHANGE(4, 2) EXCHANGE(6, 4) \
+    EXCHANGE(4, 2)
+
+#define MEDIAN9_SCALAR(a, b) { float lo = std::min(p[a], p[b]); p[b] = std::max(p[a], p[b]); p[a] = lo; }
+
+static void median9Scalar(const float* in, float* out, int n){
+    for (int i = 0; i < n; i++) {
+        float p[9];
+        for (int j = 0; j < 9; j++) {
+            p[j] = in[i + j];
+        }
+        MEDIAN9_NETWORK(MEDIAN9_SCALAR)
+        out[i] = p[4];
+    }
+}
+
+// Kernels sized for a buffer or a resonator bank are templates on the size:
+// N > 0 is a compile-time trip count, so the compiler drops the remainder
+// loop and unrolls the main one; N = 0 is the generic version for any n.
+#ifndef SIMD_X86
+template <int N>
+static float dotScalar(const float* a, const float* b, int n){
+    const int count = N > 0 ? N : n;
+    float sum = 0.0f;
+    for (int i = 0; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+template <int B>
+static void resonatorScalar(float* re, float* im, const float* cr, const float* ci, int bins, const float* x, int n){
+    const int count = B > 0 ? B : bins;
+    for (int b = 0; b < count; b++) {
+        float r = re[b], q = im[b];
+        for (int i = 0; i < n; i++) {
+            float nr = cr[b] * r - ci[b] * q + x[i];
+            q = ci[b] * r + cr[b] * q;
+            r = nr;
+        }
+        re[b] = r;
+        im[b] = q;
+    }
+}
+
+static void sparseScalar(const int* rowStart, int rows, const int* col, const float* kr, const float* ki,
+                         const float* xr, const float* xi, float* yr, float* yi){
+    for (int r = 0; r < rows; r++) {
+        float sr = 0.0f, si = 0.0f;
+        for (int j = rowStart[r]; j < rowStart[r + 1]; j++) {
+            float a = xr[col[j]], b = xi[col[j]];
+            sr += a * kr[j] + b * ki[j];
+            si += b * kr[j] - a * ki[j];
+        }
+        yr[r] = sr;
+        yi[r] = si;
+    }
+}
+
+static void deinterleaveScalar(const float* in, int channels, int frames, float* const* out){
+    for (int i = 0; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            out[c][i] = in[i * channels + c];
+        }
+    }
+}
+
+static void midSideScalar(const float* left, const float* right, float* mid, float* side, int n){
+    for (int i = 0; i < n; i++) {
+        mid[i] = 0.5f * (left[i] + right[i]);
+        side[i] = 0.5f * (left[i] - right[i]);
+    }
+}
+
+template <int N>
+static void widenScalar(const float* in, double* out, int n){
+    const int count = N > 0 ? N : n;
+    for (int i = 0; i < count; i++) {
+        out[i] = in[i];
+    }
+}
+
+template <int N>
+static void mixDownScalar(const float* const* in, int channels, float* out, int n){
+    const int count = N > 0 ? N : n;
+    float scale = 1.0f / channels;
+    for (int i = 0; i < count; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            sum += in[c][i];
+        }
+        out[i] = sum * scale;
+    }
+}
+#else
+template <int N>
+static float dotSse(const float* a, const float* b, int n){
+    const int count = N > 0 ? N : n;
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    __m128 acc = _mm_add_ps(acc0, acc1);
+    acc = _mm_add_ps(acc, _mm_movehl_ps(acc, acc));
+    acc = _mm_add_ss(acc, _mm_shuffle_ps(acc, acc, 1));
+    float sum = _mm_cvtss_f32(acc);
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+template <int N>
+__attribute__((target("avx2,fma")))
+static float dotAvx2(const float* a, const float* b, int n){
+    const int count = N > 0 ? N : n;
+    __m256 acc0 = _mm256_setzero_ps();
+    __m256 acc1 = _mm256_setzero_ps();
+    int i = 0;
+    for (; i + 16 <= count; i += 16) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+        acc1 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i + 8), _mm256_loadu_ps(b + i + 8), acc1);
+    }
+    for (; i + 8 <= count; i += 8) {
+        acc0 = _mm256_fmadd_ps(_mm256_loadu_ps(a + i), _mm256_loadu_ps(b + i), acc0);
+    }
+    __m256 acc = _mm256_add_ps(acc0, acc1);
+    __m128 half = _mm_add_ps(_mm256_castps256_ps128(acc), _mm256_extractf128_ps(acc, 1));
+    half = _mm_add_ps(half, _mm_movehl_ps(half, half));
+    half = _mm_add_ss(half, _mm_shuffle_ps(half, half, 1));
+    float sum = _mm_cvtss_f32(half);
+    for (; i < count; i++) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+// Four resonators per register; state stays in registers for the whole
+// block. A bank of B resonators keeps all B / 4 groups in one sample loop,
+// the generic version one group at a time.
+template <int B>
+static void resonatorSse(float* re, float* im, const float* cr, const float* ci, int bins, const float* x, int n){
+    const int groups = B > 0 ? B / 4 : 1;
+    for (int b = 0; b < bins; b += 4 * groups) {
+        __m128 r[groups], q[groups], c[groups], s[groups];
+        for (int g = 0; g < groups; g++) {
+            r[g] = _mm_loadu_ps(re + b + 4 * g);
+            q[g] = _mm_loadu_ps(im + b + 4 * g);
+            c[g] = _mm_loadu_ps(cr + b + 4 * g);
+            s[g] = _mm_loadu_ps(ci + b + 4 * g);
+        }
+        for (int i = 0; i < n; i++) {
+            __m128 in = _mm_set1_ps(x[i]);
+            for (int g = 0; g < groups; g++) {
+                __m128 nr = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(c[g], r[g]), _mm_mul_ps(s[g], q[g])), in);
+                q[g] = _mm_add_ps(_mm_mul_ps(s[g], r[g]), _mm_mul_ps(c[g], q[g]));
+                r[g] = nr;
+            }
+        }
+        for (int g = 0; g < groups; g++) {
+            _mm_storeu_ps(re + b + 4 * g, r[g]);
+            _mm_storeu_ps(im + b + 4 * g, q[g]);
+        }
+    }
+}
+
+template <int B>
+__attribute__((target("avx2,fma")))
+static void resonatorAvx2(float* re, float* im, const float* cr, const float* ci, int bins, const float* x, int n){
+    const int groups = B > 0 ? B / 8 : 1;
+    for (int b = 0; b < bins; b += 8 * groups) {
+        __m256 r[groups], q[groups], c[groups], s[groups];
+        for (int g = 0; g < groups; g++) {
+            r[g] = _mm256_loadu_ps(re + b + 8 * g);
+            q[g] = _mm256_loadu_ps(im + b + 8 * g);
+            c[g] = _mm256_loadu_ps(cr + b + 8 * g);
+            s[g] = _mm256_loadu_ps(ci + b + 8 * g);
+        }
+        for (int i = 0; i < n; i++) {
+            __m256 in = _mm256_set1_ps(x[i]);
+            for (int g = 0; g < groups; g++) {
+                __m256 nr = _mm256_fmsub_ps(c[g], r[g], _mm256_fmsub_ps(s[g], q[g], in));
+                q[g] = _mm256_fmadd_ps(s[g], r[g], _mm256_mul_ps(c[g], q[g]));
+                r[g] = nr;
+            }
+        }
+        for (int g = 0; g < groups; g++) {
+            _mm256_storeu_ps(re + b + 8 * g, r[g]);
+            _mm256_storeu_ps(im + b + 8 * g, q[g]);
+        }
+    }
+}
+
+static float horizontalSum(__m128 v){
+    v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+    v = _mm_add_ss(v, _mm_shuffle_ps(v, v, 1));
+    return _mm_cvtss_f32(v);
+}
+
+static void sparseSse(const int* rowStart, int rows, const int* col, const float* kr, const float* ki,
+                      const float* xr, const float* xi, float* yr, float* yi){
+    for (int r = 0; r < rows; r++) {
+        __m128 sr = _mm_setzero_ps(), si = _mm_setzero_ps();
+        for (int j = rowStart[r]; j < rowStart[r + 1]; j += 4) {
+            const int* c = col + j;
+            __m128 a = _mm_set_ps(xr[c[3]], xr[c[2]], xr[c[1]], xr[c[0]]);
+            __m128 b = _mm_set_ps(xi[c[3]], xi[c[2]], xi[c[1]], xi[c[0]]);
+            __m128 k = _mm_loadu_ps(kr + j), l = _mm_loadu_ps(ki + j);
+            sr = _mm_add_ps(sr, _mm_add_ps(_mm_mul_ps(a, k), _mm_mul_ps(b, l)));
+            si = _mm_add_ps(si, _mm_sub_ps(_mm_mul_ps(b, k), _mm_mul_ps(a, l)));
+        }
+        yr[r] = horizontalSum(sr);
+        yi[r] = horizontalSum(si);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void sparseAvx2(const int* rowStart, int rows, const int* col, const float* kr, const float* ki,
+                       const float* xr, const float* xi, float* yr, float* yi){
+    for (int r = 0; r < rows; r++) {
+        __m256 sr = _mm256_setzero_ps(), si = _mm256_setzero_ps();
+        for (int j = rowStart[r]; j < rowStart[r + 1]; j += 8) {
+            __m256i c = _mm256_loadu_si256((const __m256i*)(col + j));
+            __m256 a = _mm256_i32gather_ps(xr, c, 4);
+            __m256 b = _mm256_i32gather_ps(xi, c, 4);
+            __m256 k = _mm256_loadu_ps(kr + j), l = _mm256_loadu_ps(ki + j);
+            sr = _mm256_fmadd_ps(a, k, _mm256_fmadd_ps(b, l, sr));
+            si = _mm256_fmadd_ps(b, k, _mm256_fnmadd_ps(a, l, si));
+        }
+        yr[r] = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(sr), _mm256_extractf128_ps(sr, 1)));
+        yi[r] = horizontalSum(_mm_add_ps(_mm256_castps256_ps128(si), _mm256_extractf128_ps(si, 1)));
+    }
+}
+
+// Stereo is two shuffles per four frames; other layouts fall back to a
+// strided copy
+static void deinterleaveSse(const float* in, int channels, int frames, float* const* out){
+    int i = 0;
+    if (channels == 2) {
+        for (; i + 4 <= frames; i += 4) {
+            __m128 a = _mm_loadu_ps(in + 2 * i);     // l0 r0 l1 r1
+            __m128 b = _mm_loadu_ps(in + 2 * i + 4); // l2 r2 l3 r3
+            _mm_storeu_ps(out[0] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+            _mm_storeu_ps(out[1] + i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1)));
+        }
+    }
+    for (; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            out[c][i] = in[i * channels + c];
+        }
+    }
+}
+
+// Stereo uses in-lane shuffles plus a cross-lane permute; any other channel
+// count gathers eight frames of one channel per instruction
+__attribute__((target("avx2,fma")))
+static void deinterleaveAvx2(const float* in, int channels, int frames, float* const* out){
+    int i = 0;
+    if (channels == 2) {
+        for (; i + 8 <= frames; i += 8) {
+            __m256 a = _mm256_loadu_ps(in + 2 * i);
+            __m256 b = _mm256_loadu_ps(in + 2 * i + 8);
+            __m256 left = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0));  // l0 l1 l4 l5 | l2 l3 l6 l7
+            __m256 right = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3, 1, 3, 1));
+            left = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(left), _MM_SHUFFLE(3, 1, 2, 0)));
+            right = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(right), _MM_SHUFFLE(3, 1, 2, 0)));
+            _mm256_storeu_ps(out[0] + i, left);
+            _mm256_storeu_ps(out[1] + i, right);
+        }
+    } else if (channels > 2) {
+        __m256i stride = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(channels));
+        for (; i + 8 <= frames; i += 8) {
+            const float* base = in + i * channels;
+            for (int c = 0; c < channels; c++) {
+                _mm256_storeu_ps(out[c] + i, _mm256_i32gather_ps(base + c, stride, 4));
+            }
+        }
+    }
+    for (; i < frames; i++) {
+        for (int c = 0; c < channels; c++) {
+            out[c][i] = in[i * channels + c];
+        }
+    }
+}
+
+static void midSideSse(const float* left, const float* right, float* mid, float* side, int n){
+    __m128 half = _mm_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 l = _mm_loadu_ps(left + i), r = _mm_loadu_ps(right + i);
+        _mm_storeu_ps(mid + i, _mm_mul_ps(half, _mm_add_ps(l, r)));
+        _mm_storeu_ps(side + i, _mm_mul_ps(half, _mm_sub_ps(l, r)));
+    }
+    for (; i < n; i++) {
+        mid[i] = 0.5f * (left[i] + right[i]);
+        side[i] = 0.5f * (left[i] - right[i]);
+    }
+}
+
+__attribute__((target("avx2,fma")))
+static void midSideAvx2(const float* left, const float* right, float* mid, float* side, int n){
+    __m256 half = _mm256_set1_ps(0.5f);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 l = _mm256_loadu_ps(left + i), r = _mm256_loadu_ps(right + i);
+        _mm256_storeu_ps(mid + i, _mm256_mul_ps(half, _mm256_add_ps(l, r)));
+        _mm256_storeu_ps(side + i, _mm256_mul_ps(half, _mm256_sub_ps(l, r)));
+    }
+    for (; i < n; i++) {
+        mid[i] = 0.5f * (left[i] + right[i]);
+        side[i] = 0.5f * (left[i] - right[i]);
+    }
+}
+
+// Four or eight outputs per pass of the network, each lane its own window
+#define MEDIAN9_SSE(a, b) { __m128 lo = _mm_min_ps(p[a], p[b]); p[b] = _mm_max_ps(p[a], p[b]); p[a] = lo; }
+#define MEDIAN9_AVX2(a, b) { __m256 lo = _mm256_min_ps(p[a], p[b]); p[b] = _mm256_max_ps(p[a], p[b]); p[a] = lo; }
+
+static void median9Sse(const float* in, float* out, int n){
+    int i = 0;
+    for (; i + 4 <= n; i += 4) {
+        __m128 p[9];
+        for (int j = 0; j < 9; j++) {
+            p[j] = _mm_loadu_ps(in + i + j);
+        }
+        MEDIAN9_NETWORK(MEDIAN9_SSE)
+        _mm_storeu_ps(out + i, p[4]);
+    }
+    median9Scalar(in + i, out + i, n - i);
+}
+
+__attribute__((target("avx2,fma")))
+static void median9Avx2(const float* in, float* out, int n){
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256 p[9];
+        for (int j = 0; j < 9; j++) {
+            p[j] = _mm256_loadu_ps(in + i + j);
+        }
+        MEDIAN9_NETWORK(MEDIAN9_AVX2)
+        _mm256_storeu_ps(out + i, p[4]);
+    }
+    median9Scalar(in + i, out + i, n - i);
+}
+
+template <int N>
+static void widenSse(const float* in, double* out, int n){
+    const int count = N > 0 ? N : n;
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 x = _mm_loadu_ps(in + i);
+        _mm_storeu_pd(out + i, _mm_cvtps_pd(x));
+        _mm_storeu_pd(out + i + 2, _mm_cvtps_pd(_mm_movehl_ps(x, x)));
+    }
+    for (; i < count; i++) {
+        out[i] = in[i];
+    }
+}
+
+template <int N>
+__attribute__((target("avx2,fma")))
+static void widenAvx2(const float* in, double* out, int n){
+    const int count = N > 0 ? N : n;
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_pd(out + i, _mm256_cvtps_pd(_mm_loadu_ps(in + i)));
+        _mm256_storeu_pd(out + i + 4, _mm256_cvtps_pd(_mm_loadu_ps(in + i + 4)));
+    }
+    for (; i < count; i++) {
+        out[i] = in[i];
+    }
+}
+
+template <int N>
+static void mixDownSse(const float* const* in, int channels, float* out, int n){
+    const int count = N > 0 ? N : n;
+    float scale = 1.0f / channels;
+    __m128 s = _mm_set1_ps(scale);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128 sum = _mm_loadu_ps(in[0] + i);
+        for (int c = 1; c < channels; c++) {
+            sum = _mm_add_ps(sum, _mm_loadu_ps(in[c] + i));
+        }
+        _mm_storeu_ps(out + i, _mm_mul_ps(sum, s));
+    }
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            sum += in[c][i];
+        }
+        out[i] = sum * scale;
+    }
+}
+
+template <int N>
+__attribute__((target("avx2,fma")))
+static void mixDownAvx2(const float* const* in, int channels, float* out, int n){
+    const int count = N > 0 ? N : n;
+    float scale = 1.0f / channels;
+    __m256 s = _mm256_set1_ps(scale);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256 sum = _mm256_loadu_ps(in[0] + i);
+        for (int c = 1; c < channels; c++) {
+            sum = _mm256_add_ps(sum, _mm256_loadu_ps(in[c] + i));
+        }
+        _mm256_storeu_ps(out + i, _mm256_mul_ps(sum, s));
+    }
+    for (; i < count; i++) {
+        float sum = 0.0f;
+        for (int c = 0; c < channels; c++) {
+            sum += in[c][i];
+        }
+        out[i] = sum * scale;
+    }
+}
+
+static bool hasAvx2(){
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma");
+}
+#endif
+
+typedef float (*dotKernel)(const float*, const float*, int);
+
+static const dotKernel* pickDot(){
+#ifdef SIMD_X86
+    static const dotKernel avx2[] = SIZED_KERNELS(dotAvx2);
+    static const dotKernel sse[] = SIZED_KERNELS(dotSse);
+    return hasAvx2() ? avx2 : sse;
+#else
+    static const dotKernel scalar[] = SIZED_KERNELS(dotScalar);
+    return scalar;
+#endif
+}
+
+float dotProduct(const float* a, const float* b, int n){
+    static const dotKernel* kernels = pickDot();
+    return kernels[sizeSlot(n)](a, b, n);
+}
+
+// Slot of a bank size in a resonator kernel table; the last slot holds the
+// generic version
+#define BANK_KERNELS(kernel) { kernel<8>, kernel<16>, kernel<0> }
+
+static int bankSlot(int bins){
+    return bins == 8 ? 0 : (bins == 16 ? 1 : 2);
+}
+
+typedef void (*resonatorKernel)(float*, float*, const float*, const float*, int, const float*, int);
+
+static const resonatorKernel* pickResonator(){
+#ifdef SIMD_X86
+    static const resonatorKernel avx2[] = BANK_KERNELS(resonatorAvx2);
+    static const resonatorKernel sse[] = BANK_KERNELS(resonatorSse);
+    return hasAvx2() ? avx2 : sse;
+#else
+    static const resonatorKernel scalar[] = BANK_KERNELS(resonatorScalar);
+    return scalar;
+#endif
+}
+
+void resonatorBank(float* re, float* im, const float* cr, const float* ci, int bins, const float* x, int n){
+    static const resonatorKernel* kernels = pickResonator();
+    kernels[bankSlot(bins)](re, im, cr, ci, bins, x, n);
+}
+
+typedef void (*sparseKernel)(const int*, int, const int*, const float*, const float*,
+                             const float*, const float*, float*, float*);
+
+static sparseKernel pickSparse(){
+#ifdef SIMD_X86
+    return hasAvx2() ? sparseAvx2 : sparseSse;
+#else
+    return sparseScalar;
+#endif
+}
+
+void sparseComplexMatVec(const int* rowStart, int rows, const int* col, const float* kr, const float* ki,
+                         const float* xr, const float* xi, float* yr, float* yi){
+    static sparseKernel kernel = pickSparse();
+    kernel(rowStart, rows, col, kr, ki, xr, xi, yr, yi);
+}
+
+typedef void (*deinterleaveKernel)(const float*, int, int, float* const*);
+
+static deinterleaveKernel pickDeinterleave(){
+#ifdef SIMD_X86
+    return hasAvx2() ? deinterleaveAvx2 : deinterleaveSse;
+#else
+    return deinterleaveScalar;
+#endif
+}
+
+void deinterleave(const float* in, int channels, int frames, float* const* out){
+    static deinterleaveKernel kernel = pickDeinterleave();
+    if (channels == 1) {
+        memcpy(out[0], in, sizeof(float) * frames);
+        return;
+    }
+    kernel(in, channels, frames, out);
+}
+
+typedef void (*midSideKernel)(const float*, const float*, float*, float*, int);
+
+static midSideKernel pickMidSide(){
+#ifdef SIMD_X86
+    return hasAvx2() ? midSideAvx2 : midSideSse;
+#else
+    return midSideScalar;
+#endif
+}
+
+void midSide(const float* left, const float* right, float* mid, float* side, int n){
+    static midSideKernel kernel = pickMidSide();
+    kernel(left, right, mid, side, n);
+}
+
+typedef void (*median9Kernel)(const float*, float*, int);
+
+static median9Kernel pickMedian9(){
+#ifdef SIMD_X86
+    return hasAvx2() ? median9Avx2 : median9Sse;
+#else
+    return median9Scalar;
+#endif
+}
+
+void median9(const float* in, float* out, int n){
+    static median9Kernel kernel = pickMedian9();
+    kernel(in, out, n);
+}
+
+typedef void (*widenKernel)(const float*, double*, int);
+
+static const widenKernel* pickWiden(){
+#ifdef SIMD_X86
+    static const widenKernel avx2[] = SIZED_KERNELS(widenAvx2);
+    static const widenKernel sse[] = SIZED_KERNELS(widenSse);
+    return hasAvx2() ? avx2 : sse;
+#else
+    static const widenKernel scalar[] = SIZED_KERNELS(widenScalar);
+    return scalar;
+#endif
+}
+
+void widenToDouble(const float* in, double* out, int n){
+    static const widenKernel* kernels = pickWiden();
+    kernels[sizeSlot(n)](in, out, n);
+}
+
+typedef void (*mixDownKernel)(const float* const*, int, float*, int);
+
+static const mixDownKernel* pickMixDown(){
+#ifdef SIMD_X86
+    static const mixDownKernel avx2[] = SIZED_KERNELS(mixDownAvx2);
+    static const mixDownKernel sse[] = SIZED_KERNELS(mixDownSse);
+    return hasAvx2() ? avx2 : sse;
+#else
+    static const mixDownKernel scalar[] = SIZED_KERNELS(mixDownScalar);
+    return scalar;
+#endif
+}
+
+void mixDown(const float* const* in, int channels, float* out, int n){
+    static const mixDownKernel* kernels = pickMixDown();
+    kernels[sizeSlot(n)](in, channels, out, n);
+}
+
+const char* simdLevel(){
+#ifdef SIMD_X86
+    return hasAvx2() ? "avx2" : "sse";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,66 @@
+#ifndef SIMDKERNELS_H
+#define SIMDKERNELS_H
+
+// Hot inner loops shared by the DSP modules. Each kernel has an AVX2/FMA
+// version, an SSE version and a plain C++ version; the best one the CPU
+// supports is picked the first time the kernel is called, so the binary
+// still runs on machines without AVX2 and no -march flag is needed.
+
+// Advances `bins` damped complex resonators over n input samples:
+// s = (cr + i*ci) * s + x. `bins` must be a multiple of 8 (pad with zero
+// coefficients). Banks of 8 and 16 are specialised: every group of
+// resonators advances in the same sample loop, so their dependency chains
+// overlap instead of running one group after another.
+void resonatorBank(float* re, float* im, const float* cr, const float* ci, int bins, const float* x, int n);
+
+// Complex sparse matrix-vector product with a conjugated matrix:
+// y[r] = sum over row r of conj(kr + i*ki) * (xr[col] + i*xi[col]).
+// Rows are CSR (rowStart has rows + 1 entries) and every row's length must
+// be a multiple of 8 (pad with zero coefficients).
+void sparseComplexMatVec(const int* rowStart, int rows, const int* col, const float* kr, const float* ki,
+                         const float* xr, const float* xi, float* yr, float* yi);
+
+// Splits `frames` interleaved frames of `channels` samples into one buffer
+// per channel: out[c][i] = in[i * channels + c].
+void deinterleave(const float* in, int channels, int frames, float* const* out);
+
+// mid = (left + right) / 2, side = (left - right) / 2
+void midSide(const float* left, const float* right, float* mid, float* side, int n);
+
+// out[i] = median of in[i .. i + 8] for i in [0, n); `in` holds n + 8
+// values. A fixed compare-exchange network, so a register of outputs is
+// computed at once instead of one sorted window per output.
+void median9(const float* in, float* out, int n);
+
+// The kernels below run once per analysed buffer and are specialised for
+// buffer sizes of 256, 512, 1024 and 2048, with a generic path for the rest.
+// Modules with their own per-buffer loops (transientDetector, loudnessMeter)
+// use the same table: a template on the size, N > 0 a compile-time trip
+// count and N = 0 any n, instantiated with SIZED_KERNELS and picked with
+// sizeSlot().
+#define SIZED_KERNELS(kernel) { kernel<256>, kernel<512>, kernel<1024>, kernel<2048>, kernel<0> }
+
+inline int sizeSlot(int n){
+    switch (n) {
+        case 256: return 0;
+        case 512: return 1;
+        case 1024: return 2;
+        case 2048: return 3;
+        default: return 4;
+    }
+}
+
+// Sum of a[i] * b[i] for i in [0, n). Also used for filter taps, which
+// take the generic path.
+float dotProduct(const float* a, const float* b, int n);
+
+// out[i] = in[i] for i in [0, n), float to double (the FFT input)
+void widenToDouble(const float* in, double* out, int n);
+
+// out[i] = mean over c of in[c][i]
+void mixDown(const float* const* in, int channels, float* out, int n);
+
+// Name of the instruction set the kernels dispatched to ("avx2", "sse", "scalar")
+const char* simdLevel();
+
+#endif
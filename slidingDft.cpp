@@ -0,0 +1,135 @@
+#include "slidingDft.h"
+#include "simdKernels.h"
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+slidingDft::slidingDft(double sampleRate) : stream(SDFT_STREAM_FRAMES){
+    this->sampleRate = sampleRate;
+    this->count = 0;
+    this->padded = 0;
+    memset(this->re, 0, sizeof(this->re));
+    memset(this->im, 0, sizeof(this->im));
+    memset(this->cr, 0, sizeof(this->cr));
+    memset(this->ci, 0, sizeof(this->ci));
+    memset(&this->latestFrame, 0, sizeof(sdftFrame));
+    this->sampleCount = 0;
+    this->hop = 1;
+    this->untilEmit = 1;
+    this->pending.store(false);
+
+    // Kick fundamental and body, bass, snare body and crack, hat band
+    static const double defaults[] = {45.0, 55.0, 65.0, 80.0, 110.0, 180.0, 220.0, 330.0, 1000.0, 5000.0, 8000.0, 11000.0};
+    this->setBins(std::vector<double>(defaults, defaults + sizeof(defaults) / sizeof(defaults[0])));
+    this->setControlRate(SDFT_DEFAULT_RATE);
+    this->applyPending();
+    this->untilEmit = this->hop;
+}
+
+int slidingDft::setBins(const std::vector<double>& hz, double cycles){
+    std::vector<double> windows(hz.size());
+    for (size_t i = 0; i < hz.size(); i++) {
+        windows[i] = hz[i] > 0.0 ? std::max(cycles / hz[i], SDFT_MIN_WINDOW) : SDFT_MIN_WINDOW;
+    }
+    return this->setBins(hz, windows);
+}
+
+// Returns 0 if the request does not fit (too many bins, or frequencies
+// outside (0, Nyquist)). Takes effect at the start of the next block.
+int slidingDft::setBins(const std::vector<double>& hz, const std::vector<double>& windowSeconds){
+    if (hz.size() > SDFT_MAX_BINS || hz.size() != windowSeconds.size()) {
+        return 0;
+    }
+    for (size_t i = 0; i < hz.size(); i++) {
+        if (hz[i] <= 0.0 || hz[i] >= this->sampleRate / 2.0 || windowSeconds[i] <= 0.0) {
+            return 0;
+        }
+    }
+    std::lock_guard<std::mutex> guard(this->configLock);
+    this->pendingHz = hz;
+    this->pendingWindow = windowSeconds;
+    this->pending.store(true, std::memory_order_release);
+    return 1;
+}
+
+void slidingDft::setControlRate(double framesPerSecond){
+    std::lock_guard<std::mutex> guard(this->configLock);
+    this->pendingHop = std::max(1, (int)std::lround(this->sampleRate / framesPerSecond));
+    this->pending.store(true, std::memory_order_release);
+}
+
+std::vector<double> slidingDft::bins(){
+    std::lock_guard<std::mutex> guard(this->configLock);
+    return this->pendingHz;
+}
+
+// Audio thread only. Never waits: if a writer holds the lock we simply try
+// again next block.
+void slidingDft::applyPending(){
+    std::unique_lock<std::mutex> guard(this->configLock, std::try_to_lock);
+    if (!guard.owns_lock()) {
+        return;
+    }
+    this->count = (int)this->pendingHz.size();
+    this->padded = (this->count + 7) & ~7;
+    for (int b = 0; b < SDFT_MAX_BINS; b++) {
+        this->re[b] = this->im[b] = 0.0f;
+        if (b < this->count) {
+            double w = 2.0 * M_PI * this->pendingHz[b] / this->sampleRate;
+            double r = std::exp(-1.0 / (this->pendingWindow[b] * this->sampleRate));
+            this->cr[b] = r * std::cos(w);
+            this->ci[b] = r * std::sin(w);
+            this->gain[b] = 2.0 * (1.0 - r); // Steady-state |s| of a sine is A / (2(1 - r))
+            this->hz[b] = this->pendingHz[b];
+        } else {
+            this->cr[b] = this->ci[b] = 0.0f;
+            this->gain[b] = 0.0f;
+            this->hz[b] = 0.0f;
+        }
+    }
+    this->hop = this->pendingHop;
+    this->untilEmit = std::min(this->untilEmit, this->hop);
+    this->pending.store(false, std::memory_order_relaxed);
+}
+
+void slidingDft::emit(){
+    sdftFrame frame;
+    frame.sample = this->sampleCount;
+    frame.count = this->count;
+    for (int b = 0; b < SDFT_MAX_BINS; b++) {
+        frame.magnitude[b] = b < this->count
+            ? this->gain[b] * std::sqrt(this->re[b] * this->re[b] + this->im[b] * this->im[b])
+            : 0.0f;
+    }
+    this->latestFrame = frame;
+    this->stream.push(frame); // A consumer that stops reading just misses frames
+}
+
+void slidingDft::process(const float* in, unsigned long frames){
+    if (this->pending.load(std::memory_order_acquire)) {
+        this->applyPending();
+    }
+    unsigned long done = 0;
+    while (done < frames) {
+        int chunk = (int)std::min<unsigned long>(this->untilEmit, frames - done);
+        if (this->padded > 0) {
+            resonatorBank(this->re, this->im, this->cr, this->ci, this->padded, in + done, chunk);
+        }
+        done += chunk;
+        this->sampleCount += chunk;
+        this->untilEmit -= chunk;
+        if (this->untilEmit == 0) {
+            this->emit();
+            this->untilEmit = this->hop;
+        }
+    }
+}
+
+// Consumer side of the control-rate stream
+bool slidingDft::nextFrame(sdftFrame* frame){
+    return this->stream.pop(*frame);
+}
+
+sdftFrame slidingDft::latest(){
+    return this->latestFrame;
+}
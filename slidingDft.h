@@ -0,0 +1,73 @@
+#ifndef SLIDINGDFT_H
+#define SLIDINGDFT_H
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "spscRing.h"
+
+#define SDFT_MAX_BINS 16          // Two AVX registers worth of resonators
+#define SDFT_DEFAULT_RATE 1000.0  // Control-rate frames per second
+#define SDFT_DEFAULT_CYCLES 4.0   // Each bin averages over this many periods of its frequency
+#define SDFT_MIN_WINDOW 0.002     // ...but never less than 2 ms
+#define SDFT_STREAM_FRAMES 1024   // One second of frames at the default rate
+
+// Magnitudes of every tracked bin at one control-rate tick
+typedef struct {
+    unsigned long long sample; // Input sample index the frame was taken at
+    int count;
+    float magnitude[SDFT_MAX_BINS];
+} sdftFrame;
+
+// Bank of damped sliding-DFT resonators, one per frequency of interest
+// (kick fundamental, snare body, hat band, ...). Each bin costs O(1) per
+// sample, so the magnitudes can be read out at up to ~1 kHz without any FFT.
+// The damping (r < 1) makes the recursion unconditionally stable, unlike a
+// plain sliding DFT whose rounding errors accumulate forever.
+//
+// Bins and control rate can be changed from any thread; the audio thread
+// picks the new configuration up at its next block.
+class slidingDft{
+    private:
+        double sampleRate;
+
+        // Owned by the audio thread
+        int count;
+        int padded;       // count rounded up to the SIMD width
+        float re[SDFT_MAX_BINS];
+        float im[SDFT_MAX_BINS];
+        float cr[SDFT_MAX_BINS];
+        float ci[SDFT_MAX_BINS];
+        float gain[SDFT_MAX_BINS];
+        float hz[SDFT_MAX_BINS];
+        int hop;
+        int untilEmit;
+        unsigned long long sampleCount;
+        sdftFrame latestFrame;
+
+        // Staged by setBins()/setControlRate()
+        std::mutex configLock;
+        std::vector<double> pendingHz;
+        std::vector<double> pendingWindow;
+        int pendingHop;
+        std::atomic<bool> pending;
+
+        spscRing<sdftFrame> stream;
+
+        void applyPending();
+        void emit();
+    public:
+        slidingDft(double sampleRate);
+
+        int setBins(const std::vector<double>& hz, double cycles = SDFT_DEFAULT_CYCLES);
+        int setBins(const std::vector<double>& hz, const std::vector<double>& windowSeconds);
+        void setControlRate(double framesPerSecond);
+        std::vector<double> bins();
+
+        void process(const float*, unsigned long);
+
+        bool nextFrame(sdftFrame*);
+        sdftFrame latest();
+};
+
+#endif
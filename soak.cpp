@@ -0,0 +1,409 @@
+// Accelerated soak test for the audio analyzer.
+//
+// Pushes synthetic (or looped file) audio through audioAnalyzer and its
+// feature bus much faster than real time, repeating the same 30 second
+// init/endSession cycle the visualiser's analysis thread runs. Along the way
+// it samples RSS, open file descriptors, heap usage and the published
+// features, and fails if any of them keep growing.
+//
+//   ./soak [--hours 24] [--speed 100] [--session 30] [--file song.wav]
+//          [--sample-every 600] [--channels 1] [--rate 44100]
+//          [--hop 1024] [--window 1024] [--inputs 1]
+//
+// --speed 0 runs as fast as the machine allows. --channels N spreads the
+// source over N channels at slightly different gains to exercise the
+// multichannel path. --rate generates the source at another capture rate
+// to exercise the sample-rate converter; a file is played at its own rate.
+// --hop and --window set the analysis geometry; the source is still fed in
+// FRAMES_PER_BUFFER blocks, as from a device. The analyzers run behind a
+// deviceManager, fed offline; --inputs N gives it N inputs at falling
+// gains and blends them (MERGE_WEIGHTED), and the run fails if the merged
+// view reports more beats than the inputs detected.
+
+#include "audioAnalyzer.h"
+#include "deviceManager.h"
+#include <sndfile.h>
+#include <malloc.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <string>
+
+// Growth allowed over a simulated 24 hours before we call it unbounded
+#define SOAK_RSS_LIMIT_MB 16.0
+#define SOAK_HEAP_LIMIT_MB 16.0
+#define SOAK_FD_LIMIT 2.0
+#define SOAK_BPM_DRIFT_LIMIT 5.0
+
+typedef struct {
+    double simSeconds;   // Simulated time at which the sample was taken
+    double rssMB;
+    double heapMB;
+    double fds;
+    double meanBpm;      // Mean published BPM since the previous sample
+    double meanFreq;
+    long nonFinite;      // Published values that were NaN or inf
+} soakSample;
+
+typedef struct {
+    double hours = 24.0;
+    double speed = 100.0;
+    int session = 30;
+    double sampleEvery = 600.0;
+    int channels = 1;
+    double rate = 0.0;   // 0: SAMPLE_RATE, or the file's rate
+    int hop = FRAMES_PER_BUFFER;
+    int window = FFT_SIZE;
+    int inputs = 1;
+    std::string file;
+} soakOptions;
+
+static double residentMB(){
+    long pages = 0, resident = 0;
+    FILE* f = fopen("/proc/self/statm", "r");
+    if (f == NULL) {
+        return 0.0;
+    }
+    if (fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+        resident = 0;
+    }
+    fclose(f);
+    return resident * (double)sysconf(_SC_PAGESIZE) / (1024.0 * 1024.0);
+}
+
+static double heapInUseMB(){
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 33))
+    struct mallinfo2 info = mallinfo2();
+#else
+    struct mallinfo info = mallinfo();
+#endif
+    return ((double)info.uordblks + (double)info.hblkhd) / (1024.0 * 1024.0);
+}
+
+static double openDescriptors(){
+    DIR* dir = opendir("/proc/self/fd");
+    if (dir == NULL) {
+        return 0.0;
+    }
+    int count = 0;
+    while (readdir(dir) != NULL) {
+        count++;
+    }
+    closedir(dir);
+    return count - 3; // ".", ".." and the descriptor opendir itself holds
+}
+
+// Least squares slope of value(t) over the samples after warm-up
+static double growthPerDay(const std::vector<soakSample>& samples, size_t first, double soakSample::*value){
+    size_t n = samples.size() - first;
+    if (n < 3) {
+        return 0.0;
+    }
+    double meanT = 0.0, meanV = 0.0;
+    for (size_t i = first; i < samples.size(); i++) {
+        meanT += samples[i].simSeconds;
+        meanV += samples[i].*value;
+    }
+    meanT /= n;
+    meanV /= n;
+    double num = 0.0, den = 0.0;
+    for (size_t i = first; i < samples.size(); i++) {
+        double dt = samples[i].simSeconds - meanT;
+        num += dt * (samples[i].*value - meanV);
+        den += dt * dt;
+    }
+    return den > 0.0 ? num / den * 86400.0 : 0.0;
+}
+
+// 120 BPM kick on the beat, noisy hi-hat on the off-beat, a little hiss
+class syntheticSource{
+    private:
+        unsigned long long sample;
+        unsigned int seed;
+        double rate;
+        float noise(){
+            seed = seed * 1664525u + 1013904223u;
+            return (seed >> 8) / 8388608.0f - 1.0f;
+        }
+    public:
+        syntheticSource(double rate): sample(0), seed(12345), rate(rate) {}
+        void fill(float* out, unsigned long frames){
+            const double beat = 0.5;
+            for (unsigned long i = 0; i < frames; i++, sample++) {
+                double t = sample / rate;
+                double sinceKick = fmod(t, beat);
+                double sinceHat = fmod(t + beat / 2.0, beat);
+                float kick = 0.8f * std::exp(-sinceKick / 0.15) * std::sin(2.0 * M_PI * 60.0 * sinceKick);
+                float hat = 0.2f * std::exp(-sinceHat / 0.03) * noise();
+                out[i] = kick + hat + 0.01f * noise();
+            }
+        }
+};
+
+// Loops an audio file forever, mixed down to mono
+class fileSource{
+    private:
+        SNDFILE* file;
+        SF_INFO info;
+        std::vector<float> interleaved;
+    public:
+        fileSource(): file(NULL) {}
+        ~fileSource(){
+            if (file != NULL) sf_close(file);
+        }
+        int open(const std::string& path){
+            memset(&info, 0, sizeof(info));
+            file = sf_open(path.c_str(), SFM_READ, &info);
+            if (file == NULL) {
+                fprintf(stderr, "Could not open %s: %s\n", path.c_str(), sf_strerror(NULL));
+                return 0;
+            }
+            interleaved.resize(FRAMES_PER_BUFFER * info.channels);
+            return 1;
+        }
+        double rate(){
+            return info.samplerate;
+        }
+        void fill(float* out, unsigned long frames){
+            unsigned long done = 0;
+            while (done < frames) {
+                sf_count_t got = sf_readf_float(file, &interleaved[0], frames - done);
+                if (got <= 0) {
+                    sf_seek(file, 0, SEEK_SET);
+                    continue;
+                }
+                for (sf_count_t i = 0; i < got; i++) {
+                    float sum = 0.0f;
+                    for (int c = 0; c < info.channels; c++) {
+                        sum += interleaved[i * info.channels + c];
+                    }
+                    out[done + i] = sum / info.channels;
+                }
+                done += got;
+            }
+        }
+};
+
+static int parseOptions(int argc, char** argv, soakOptions* options){
+    for (int i = 1; i < argc; i++) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--hours" && hasValue) options->hours = atof(argv[++i]);
+        else if (arg == "--speed" && hasValue) options->speed = atof(argv[++i]);
+        else if (arg == "--session" && hasValue) options->session = atoi(argv[++i]);
+        else if (arg == "--sample-every" && hasValue) options->sampleEvery = atof(argv[++i]);
+        else if (arg == "--file" && hasValue) options->file = argv[++i];
+        else if (arg == "--channels" && hasValue) options->channels = atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue) options->rate = atof(argv[++i]);
+        else if (arg == "--hop" && hasValue) options->hop = atoi(argv[++i]);
+        else if (arg == "--window" && hasValue) options->window = atoi(argv[++i]);
+        else if (arg == "--inputs" && hasValue) options->inputs = atoi(argv[++i]);
+        else {
+            fprintf(stderr, "usage: %s [--hours H] [--speed X] [--session S] [--sample-every S] [--file path] [--channels N] [--rate Hz] [--hop N] [--window N] [--inputs N]\n", argv[0]);
+            return 0;
+        }
+    }
+    if (options->hours <= 0 || options->session <= 0 || options->sampleEvery <= 0 || options->speed < 0) {
+        fprintf(stderr, "hours, session and sample-every must be positive, speed must not be negative\n");
+        return 0;
+    }
+    if (options->channels < 1 || options->channels > MAX_CHANNELS) {
+        fprintf(stderr, "channels must be between 1 and %d\n", MAX_CHANNELS);
+        return 0;
+    }
+    if (options->inputs < 1 || options->inputs > MAX_INPUTS) {
+        fprintf(stderr, "inputs must be between 1 and %d\n", MAX_INPUTS);
+        return 0;
+    }
+    if (options->rate != 0.0 && (options->rate < MIN_INPUT_RATE || options->rate > MAX_INPUT_RATE)) {
+        fprintf(stderr, "rate must be between %.0f and %.0f Hz\n", MIN_INPUT_RATE, MAX_INPUT_RATE);
+        return 0;
+    }
+    return 1;
+}
+
+static int report(const char* name, double growth, double limit, const char* unit){
+    bool failed = std::fabs(growth) > limit;
+    fprintf(stderr, "  %-10s %+10.3f %s/day (limit %.1f) %s\n", name, growth, unit, limit, failed ? "FAIL" : "ok");
+    return failed ? 1 : 0;
+}
+
+int main(int argc, char** argv){
+    soakOptions options;
+    if (!parseOptions(argc, argv, &options)) {
+        return 2;
+    }
+
+    fileSource file;
+    bool useFile = !options.file.empty();
+    if (useFile && !file.open(options.file)) {
+        return 2;
+    }
+    if (options.rate == 0.0) {
+        options.rate = useFile ? file.rate() : SAMPLE_RATE;
+    }
+    syntheticSource synthetic(options.rate);
+
+    // One buffer is FRAMES_PER_BUFFER frames at the capture rate, as from a device
+    const double bufferSeconds = FRAMES_PER_BUFFER / options.rate;
+    const unsigned long long totalBuffers = (unsigned long long)(options.hours * 3600.0 / bufferSeconds);
+    const unsigned long long buffersPerSession = (unsigned long long)(options.session / bufferSeconds);
+    // A sample interval shorter than one buffer samples every buffer
+    const unsigned long long buffersPerSample = std::max(1ULL, (unsigned long long)(options.sampleEvery / bufferSeconds));
+
+    fprintf(stderr, "Soaking %.1f simulated hours at %s, %d s sessions, source: %s at %.0f Hz\n",
+        options.hours, options.speed > 0 ? (std::to_string((int)options.speed) + "x").c_str() : "full speed",
+        options.session, useFile ? options.file.c_str() : "synthetic 120 BPM", options.rate);
+
+    // Never started: no devices are opened, buffers go in through process()
+    deviceManager inputs;
+    for (int i = 0; i < options.inputs; i++) {
+        if (inputs.addDevice(i, options.channels) < 0) {
+            return 2;
+        }
+        inputs.analyzer(i)->setInputRate(options.rate);
+        if (!inputs.analyzer(i)->setGeometry(options.hop, options.window)) {
+            return 2;
+        }
+    }
+    inputs.setPolicy(MERGE_WEIGHTED);
+    std::vector<float> buffer(FRAMES_PER_BUFFER);
+    std::vector<float> interleaved(FRAMES_PER_BUFFER * options.channels);
+    std::vector<soakSample> samples;
+    double bpmSum = 0.0, freqSum = 0.0;
+    long featureCount = 0, nonFinite = 0;
+    bool sessionOpen = false;
+    unsigned long long inputBeats = 0, mergedBeats = 0;
+    std::vector<unsigned long long> inputFrames(options.inputs, 0);
+
+    // Poll and clear the beat latches from another thread, as the render
+    // loop does, while sessions come and go underneath
+    std::atomic<bool> soaking(true);
+    std::atomic<unsigned long long> beatsSeen(0);
+    std::thread renderer([&]() {
+        while (soaking.load()) {
+            if (inputs.lowBeat()) {
+                inputs.setLowBeat(false);
+                beatsSeen++;
+            }
+            if (inputs.highBeat()) {
+                inputs.setHighBeat(false);
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+    });
+
+    auto wallStart = std::chrono::steady_clock::now();
+    for (unsigned long long n = 0; n < totalBuffers; n++) {
+        // Same lifecycle as threadFunction in main.cpp
+        if (n % buffersPerSession == 0) {
+            for (int i = 0; i < options.inputs; i++) {
+                if (sessionOpen) inputs.analyzer(i)->endSession();
+                if (!inputs.analyzer(i)->initAnalysis()) {
+                    fprintf(stderr, "initAnalysis failed after %llu buffers\n", n);
+                    soaking.store(false);
+                    renderer.join();
+                    return 1;
+                }
+            }
+            sessionOpen = true;
+        }
+
+        if (useFile) file.fill(&buffer[0], FRAMES_PER_BUFFER);
+        else synthetic.fill(&buffer[0], FRAMES_PER_BUFFER);
+        for (unsigned long i = 0; i < FRAMES_PER_BUFFER; i++) {
+            for (int c = 0; c < options.channels; c++) {
+                interleaved[i * options.channels + c] = buffer[i] * (1.0f - 0.1f * c);
+            }
+        }
+        // Each input hears the source a little quieter than the last
+        for (int i = 0; i < options.inputs; i++) {
+            if (i > 0) {
+                for (size_t k = 0; k < interleaved.size(); k++) {
+                    interleaved[k] *= 0.8f;
+                }
+            }
+            inputs.process(i, &interleaved[0], FRAMES_PER_BUFFER);
+            featureFrame own = inputs.getFeatures(i);
+            if (own.frameIndex != inputFrames[i] && own.lowBeatDetected) inputBeats++;
+            inputFrames[i] = own.frameIndex;
+            if (inputs.getFeatures().lowBeatDetected) mergedBeats++;
+        }
+
+        featureFrame frame = inputs.getFeatures();
+        if (!std::isfinite(frame.bpm) || !std::isfinite(frame.freq)
+            || !std::isfinite(frame.maxLowBeat) || !std::isfinite(frame.maxHighBeat)) {
+            nonFinite++;
+        } else {
+            bpmSum += frame.bpm;
+            freqSum += frame.freq;
+            featureCount++;
+        }
+
+        if ((n + 1) % buffersPerSample == 0 || n + 1 == totalBuffers) {
+            soakSample s;
+            s.simSeconds = (n + 1) * bufferSeconds;
+            s.rssMB = residentMB();
+            s.heapMB = heapInUseMB();
+            s.fds = openDescriptors();
+            s.meanBpm = featureCount > 0 ? bpmSum / featureCount : 0.0;
+            s.meanFreq = featureCount > 0 ? freqSum / featureCount : 0.0;
+            s.nonFinite = nonFinite;
+            samples.push_back(s);
+            fprintf(stderr, "%8.2f h  rss %8.2f MB  heap %8.2f MB  fds %4.0f  bpm %7.2f  freq %9.3f  non-finite %ld\n",
+                s.simSeconds / 3600.0, s.rssMB, s.heapMB, s.fds, s.meanBpm, s.meanFreq, s.nonFinite);
+            bpmSum = freqSum = 0.0;
+            featureCount = nonFinite = 0;
+        }
+
+        // Hold the requested speed-up instead of racing ahead
+        if (options.speed > 0) {
+            std::chrono::duration<double> target((n + 1) * bufferSeconds / options.speed);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - wallStart;
+            if (target > elapsed) {
+                std::this_thread::sleep_for(target - elapsed);
+            }
+        }
+    }
+    soaking.store(false);
+    renderer.join();
+    if (sessionOpen) {
+        for (int i = 0; i < options.inputs; i++) {
+            inputs.analyzer(i)->endSession();
+        }
+    }
+
+    std::chrono::duration<double> wall = std::chrono::steady_clock::now() - wallStart;
+    fprintf(stderr, "Simulated %.1f h in %.1f s (%.0fx real time), %llu low beats taken\n",
+        options.hours, wall.count(), options.hours * 3600.0 / wall.count(), beatsSeen.load());
+
+    // Ignore the first tenth of the run while allocators and FFTW settle
+    size_t warmup = samples.size() / 10;
+    int failures = 0;
+    fprintf(stderr, "Growth after warm-up:\n");
+    failures += report("rss", growthPerDay(samples, warmup, &soakSample::rssMB), SOAK_RSS_LIMIT_MB, "MB");
+    failures += report("heap", growthPerDay(samples, warmup, &soakSample::heapMB), SOAK_HEAP_LIMIT_MB, "MB");
+    failures += report("fds", growthPerDay(samples, warmup, &soakSample::fds), SOAK_FD_LIMIT, "fd");
+    failures += report("bpm", growthPerDay(samples, warmup, &soakSample::meanBpm), SOAK_BPM_DRIFT_LIMIT, "BPM");
+
+    long totalNonFinite = 0;
+    for (size_t i = 0; i < samples.size(); i++) {
+        totalNonFinite += samples[i].nonFinite;
+    }
+    if (totalNonFinite > 0) {
+        fprintf(stderr, "  %ld published frames contained NaN or inf FAIL\n", totalNonFinite);
+        failures++;
+    }
+    // Each merge sees every input's latest frame; a beat must still count once
+    fprintf(stderr, "  beats      %llu merged from %llu detected on %d input(s) %s\n",
+        mergedBeats, inputBeats, options.inputs, mergedBeats > inputBeats ? "FAIL" : "ok");
+    if (mergedBeats > inputBeats) {
+        failures++;
+    }
+
+    fprintf(stderr, failures ? "SOAK FAILED\n" : "SOAK PASSED\n");
+    return failures ? 1 : 0;
+}
@@ -1,84 +1,39 @@
 #include "./sound_analysis.h"
 
-// Callback function to capture audio data
-static int recordCallback(const void* inputBuffer, void* outputBuffer,
-                          unsigned long framesPerBuffer,
-                          const PaStreamCallbackTimeInfo* timeInfo,
-                          PaStreamCallbackFlags statusFlags,
-                          void* userData)
-{
-    // Cast the input buffer to 16-bit PCM format
-    auto* audioBuffers = static_cast<std::vector<std::vector<short>>*>(userData);
-    const short* in = static_cast<const short*>(inputBuffer);
-
-    // Copy the input buffer data to a vector
-    if (in != nullptr) {
-        std::vector<short> buffer(in, in + framesPerBuffer*sizeof(short));
-        audioBuffers->push_back(buffer);
-    }else{
-        cout << "NULL AUDIOBUFFER" << endl;
-    }
-
-    // Continue recording
-    return paContinue;
-}
+// Opened on the first recording and kept running, so later recordings
+// skip Pa_Initialize and stream setup and start as soon as they are asked for
+static audioReader reader;
 
 std::vector<std::vector<short>> getRawAudio() {
     std::vector<std::vector<short>> audioBuffers;
-
-    // Initialize PortAudio
-    PaError err = Pa_Initialize();
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-        
-    }
-
-    // Set up input parameters
-    PaStreamParameters inputParameters;
-    inputParameters.device = Pa_GetDefaultInputDevice();
-    if (inputParameters.device == paNoDevice) {
-        std::cerr << "Error: No default input device." << std::endl;
+    if (!reader.isOpen() && !reader.open(-1, NUM_CHANNELS, SAMPLE_RATE)) {
+        std::cerr << "Error: Could not open the default input device." << std::endl;
+        return audioBuffers;
     }
+    // Only what arrives from now on belongs to this recording
+    reader.discard();
+    unsigned long long lostBefore = reader.overruns();
 
-    inputParameters.channelCount = NUM_CHANNELS;
-    inputParameters.sampleFormat = SAMPLE_FORMAT;
-    inputParameters.suggestedLatency = Pa_GetDeviceInfo(inputParameters.device)->defaultLowInputLatency;
-    inputParameters.hostApiSpecificStreamInfo = nullptr;
-
-    // Open an audio stream
-    PaStream* stream;
-    err = Pa_OpenStream(&stream,
-                        &inputParameters,
-                        nullptr,  // No output parameters (input only)
-                        SAMPLE_RATE,
-                        FRAMES_PER_BUFFER,
-                        paClipOff,  // No clipping
-                        recordCallback,
-                        &audioBuffers);   // No user data
-
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-    }
-
-    // Start the stream
-    err = Pa_StartStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
-    }
-
-    // Record for 5 seconds
     std::cout << "Recording for " << RECORD_DURATION << " seconds..." << std::endl;
-    Pa_Sleep(RECORD_DURATION * 1000);
-
-    // Stop the stream
-    err = Pa_StopStream(stream);
-    if (err != paNoError) {
-        std::cerr << "PortAudio error: " << Pa_GetErrorText(err) << std::endl;
+    std::vector<float> block(FRAMES_PER_BUFFER * NUM_CHANNELS);
+    long remaining = (long)SAMPLE_RATE * RECORD_DURATION;
+    while (remaining > 0) {
+        long frames = reader.read(&block[0], std::min<long>(FRAMES_PER_BUFFER, remaining), READ_TIMEOUT);
+        if (frames <= 0) {
+            std::cerr << "Timed out waiting for the input device" << std::endl;
+            break;
+        }
+        // The reader delivers floats; the detector reads 16-bit PCM
+        std::vector<short> buffer(frames * NUM_CHANNELS);
+        for (size_t i = 0; i < buffer.size(); i++) {
+            buffer[i] = (short)std::lrint(std::max(-1.0f, std::min(1.0f, block[i])) * 32767.0f);
+        }
+        audioBuffers.push_back(buffer);
+        remaining -= frames;
+    }
+    if (reader.overruns() > lostBefore) {
+        std::cerr << "Dropped " << reader.overruns() - lostBefore << " frames while recording" << std::endl;
     }
-
-    // Close the stream
-    Pa_CloseStream(stream);
-    Pa_Terminate();
 
     // Print the number of buffers recorded
     std::cout << "Recording finished. Number of buffers: " << audioBuffers.size() << std::endl;
@@ -125,25 +80,31 @@ vector<PcmAudioFrame> getPcmAudioFrames(const string& path, PcmAudioFrameFormat
 
 int detect_shouldReturnTheBpmAndTheBeat(const string& path, PcmAudioFrameFormat format)
 {
-    constexpr float SamplingFrequency = 44100;
     constexpr size_t FrameSampleCount = FRAMES_PER_BUFFER;
 
-    vector<PcmAudioFrame> frames = getPcmAudioFrames(path, format, FrameSampleCount);
-    MusicBeatDetector musicBeatDetector(SamplingFrequency, FrameSampleCount);
+    // Frames are decoded ahead on another thread into a small reused pool,
+    // so memory no longer grows with the length of the file
+    pcmFrameStream frames(path, format, FrameSampleCount);
+    // An MP3 decodes at its own rate; raw PCM carries none and is taken as SAMPLE_RATE
+    float samplingFrequency = frames.sampleRate() > 0 ? (float)frames.sampleRate() : SAMPLE_RATE;
+    MusicBeatDetector musicBeatDetector(samplingFrequency, FrameSampleCount);
 
-    vector<float> bpms;
+    double bpmSum = 0.0;
+    size_t frameCount = 0;
     size_t beatCount = 0;
-    for (const PcmAudioFrame& frame : frames)
+    const PcmAudioFrame* frame;
+    while ((frame = frames.next()) != NULL)
     {
-        Beat beat = musicBeatDetector.detect(frame);
-        bpms.push_back(beat.bpm);
+        Beat beat = musicBeatDetector.detect(*frame);
+        bpmSum += beat.bpm;
+        frameCount++;
         if (beat.isBeat)
         {
             beatCount++;
         }
     }
 
-    float bpmMean = accumulate(bpms.begin(), bpms.end(), 0.0) / bpms.size();
+    float bpmMean = frameCount > 0 ? bpmSum / frameCount : 0.0f;
 
     cout << (int)bpmMean << endl;
     return (int)bpmMean;
@@ -4,6 +4,11 @@
 #include <sndfile.h>
 #include <alsa/asoundlib.h>
 #include <lame/lame.h>
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+#include "pcmFrameStream.h"
+#include "audioReader.h"
 
 using namespace introlab;
 using namespace std;
@@ -11,8 +16,9 @@ using namespace std;
 #define SAMPLE_RATE 44100
 #define NUM_CHANNELS 1  // Mono audio
 #define FRAMES_PER_BUFFER 512
-#define SAMPLE_FORMAT paInt32 // 16-bit PCM
+#define SAMPLE_FORMAT paInt16 // 16-bit PCM
 #define RECORD_DURATION 10        // Duration of the recording in seconds
+#define READ_TIMEOUT 1.0          // Seconds to wait for the device before giving up on a recording
 
 vector<PcmAudioFrame> getPcmAudioFrames(const string& path, PcmAudioFrameFormat format, size_t frameSampleCount);
 int detect_shouldReturnTheBpmAndTheBeat(const string& path, PcmAudioFrameFormat format);
\ No newline at end of file
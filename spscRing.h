@@ -0,0 +1,144 @@
+#ifndef SPSCRING_H
+#define SPSCRING_H
+
+#include <atomic>
+#include <vector>
+#include <cstddef>
+#include <algorithm>
+
+// Fixed-size single-producer/single-consumer queue. Neither side ever locks
+// or allocates after construction, so it is safe to push from the audio
+// callback. Capacity is rounded up to a power of two.
+template <typename T>
+class spscRing{
+    private:
+        std::vector<T> slots;
+        size_t mask;
+        // Padding keeps the two indices on separate cache lines (C++11 new
+        // cannot honour alignas(64) on heap objects)
+        char padHead[64];
+        std::atomic<size_t> head; // Next slot the producer writes
+        char padTail[64];
+        std::atomic<size_t> tail; // Next slot the consumer reads
+    public:
+        spscRing(size_t capacity){
+            size_t size = 1;
+            while (size < capacity) size <<= 1;
+            this->slots.resize(size);
+            this->mask = size - 1;
+            this->head.store(0);
+            this->tail.store(0);
+        }
+
+        // Returns false (and drops the item) when the consumer has fallen behind
+        bool push(const T& item){
+            size_t h = this->head.load(std::memory_order_relaxed);
+            if (h - this->tail.load(std::memory_order_acquire) > this->mask) {
+                return false;
+            }
+            this->slots[h & this->mask] = item;
+            this->head.store(h + 1, std::memory_order_release);
+            return true;
+        }
+
+        bool pop(T& item){
+            size_t t = this->tail.load(std::memory_order_relaxed);
+            if (t == this->head.load(std::memory_order_acquire)) {
+                return false;
+            }
+            item = this->slots[t & this->mask];
+            this->tail.store(t + 1, std::memory_order_release);
+            return true;
+        }
+
+        // In-place variants for large items: the producer fills the slot
+        // claim() returns (NULL when full) and publishes it with commit();
+        // the consumer reads front() (NULL when empty) and frees it with release().
+        T* claim(){
+            size_t h = this->head.load(std::memory_order_relaxed);
+            if (h - this->tail.load(std::memory_order_acquire) > this->mask) {
+                return NULL;
+            }
+            return &this->slots[h & this->mask];
+        }
+
+        void commit(){
+            this->head.store(this->head.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        T* front(){
+            size_t t = this->tail.load(std::memory_order_relaxed);
+            if (t == this->head.load(std::memory_order_acquire)) {
+                return NULL;
+            }
+            return &this->slots[t & this->mask];
+        }
+
+        void release(){
+            this->tail.store(this->tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+        }
+
+        // Bulk variants for sample streams: move up to `count` items in or
+        // out in at most two copies and return how many were moved
+        size_t write(const T* items, size_t count){
+            size_t h = this->head.load(std::memory_order_relaxed);
+            size_t space = this->mask + 1 - (h - this->tail.load(std::memory_order_acquire));
+            count = count < space ? count : space;
+            for (size_t i = 0; i < count; ) {
+                size_t at = (h + i) & this->mask;
+                size_t run = this->mask + 1 - at < count - i ? this->mask + 1 - at : count - i;
+                std::copy(items + i, items + i + run, this->slots.begin() + at);
+                i += run;
+            }
+            this->head.store(h + count, std::memory_order_release);
+            return count;
+        }
+
+        size_t read(T* items, size_t count){
+            size_t t = this->tail.load(std::memory_order_relaxed);
+            size_t queued = this->head.load(std::memory_order_acquire) - t;
+            count = count < queued ? count : queued;
+            for (size_t i = 0; i < count; ) {
+                size_t at = (t + i) & this->mask;
+                size_t run = this->mask + 1 - at < count - i ? this->mask + 1 - at : count - i;
+                std::copy(this->slots.begin() + at, this->slots.begin() + at + run, items + i);
+                i += run;
+            }
+            this->tail.store(t + count, std::memory_order_release);
+            return count;
+        }
+
+        // Producer side, for filling the ring straight from read(): the
+        // contiguous free run at the head (count is 0 when full), then
+        // produced() publishes however many items were actually written
+        T* writable(size_t& count){
+            size_t h = this->head.load(std::memory_order_relaxed);
+            size_t space = this->mask + 1 - (h - this->tail.load(std::memory_order_acquire));
+            size_t at = h & this->mask;
+            count = std::min(space, this->mask + 1 - at);
+            return &this->slots[at];
+        }
+
+        void produced(size_t count){
+            this->head.store(this->head.load(std::memory_order_relaxed) + count, std::memory_order_release);
+        }
+
+        // Consumer side: drops up to `count` queued items unread
+        size_t skip(size_t count){
+            size_t t = this->tail.load(std::memory_order_relaxed);
+            size_t queued = this->head.load(std::memory_order_acquire) - t;
+            count = count < queued ? count : queued;
+            this->tail.store(t + count, std::memory_order_release);
+            return count;
+        }
+
+        size_t size(){
+            return this->head.load(std::memory_order_acquire) - this->tail.load(std::memory_order_acquire);
+        }
+
+        size_t capacity(){
+            return this->mask + 1;
+        }
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include "threadPlacement.h"
+#include "logger.h"
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmath>
+#include <string>
+#include <sstream>
+
+static const char* roleNames[THREAD_ROLE_COUNT] = {"audio", "analysis", "render"};
+
+#define WARNED_PIN 1        // Affinity refused
+#define WARNED_SCHEDULE 2   // Policy or priority refused
+
+static const char* policyName(int policy){
+    switch (policy) {
+        case SCHED_FIFO: return "fifo";
+        case SCHED_RR: return "rr";
+        default: return "other";
+    }
+}
+
+// "2", "0,1", "3-5", "0-1,4"; returns 0 for anything it cannot read
+static unsigned long long parseCpuList(const std::string& list){
+    unsigned long long mask = 0;
+    std::stringstream items(list);
+    std::string item;
+    while (std::getline(items, item, ',')) {
+        int first, last;
+        if (sscanf(item.c_str(), "%d-%d", &first, &last) != 2) {
+            if (sscanf(item.c_str(), "%d", &first) != 1) {
+                return 0;
+            }
+            last = first;
+        }
+        if (first < 0 || last < first || last >= THREAD_MAX_CPUS) {
+            return 0;
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            mask |= 1ULL << cpu;
+        }
+    }
+    return mask;
+}
+
+threadPlacement::threadPlacement(){
+    // Nothing changes until configured: the OS defaults, no pinning
+    for (int r = 0; r < THREAD_ROLE_COUNT; r++) {
+        this->roles[r].policy = SCHED_OTHER;
+        this->roles[r].priority = 0;
+        this->roles[r].cpus = 0;
+        this->warned[r].store(0);
+    }
+    this->lockMemory = false;
+}
+
+// Reads a placement file (format in the header). Lines it cannot read are
+// reported and skipped. Returns 0 if the file cannot be opened.
+int threadPlacement::load(const char* path){
+    FILE* file = fopen(path, "r");
+    if (file == NULL) {
+        return 0;
+    }
+    char line[256];
+    int lineNumber = 0;
+    while (fgets(line, sizeof(line), file) != NULL) {
+        lineNumber++;
+        char* comment = strchr(line, '#');
+        if (comment != NULL) {
+            *comment = '\0';
+        }
+        char role[32], policy[32], cpus[128];
+        int priority = 0;
+        int fields = sscanf(line, "%31s %31s %d %127s", role, policy, &priority, cpus);
+        if (fields <= 0) {
+            continue;
+        }
+        if (strcmp(role, "mlockall") == 0 && fields >= 2) {
+            this->lockMemory = strcmp(policy, "yes") == 0 || strcmp(policy, "1") == 0;
+            continue;
+        }
+
+        int index = -1;
+        for (int r = 0; r < THREAD_ROLE_COUNT; r++) {
+            if (strcmp(role, roleNames[r]) == 0) {
+                index = r;
+            }
+        }
+        int schedPolicy = strcmp(policy, "fifo") == 0 ? SCHED_FIFO
+                        : strcmp(policy, "rr") == 0 ? SCHED_RR
+                        : strcmp(policy, "other") == 0 ? SCHED_OTHER : -1;
+        unsigned long long mask = fields == 4 ? parseCpuList(cpus) : 0;
+        if (index < 0 || fields < 3 || schedPolicy < 0 || (fields == 4 && mask == 0)) {
+            printf("%s:%d: expected '<audio|analysis|render> <fifo|rr|other> <priority> [cpus]'\n", path, lineNumber);
+            continue;
+        }
+        this->set(index, schedPolicy, priority, mask);
+    }
+    fclose(file);
+    return 1;
+}
+
+void threadPlacement::set(int role, int policy, int priority, unsigned long long cpus){
+    if (role < 0 || role >= THREAD_ROLE_COUNT) {
+        return;
+    }
+    this->roles[role].policy = policy;
+    this->roles[role].priority = priority;
+    this->roles[role].cpus = cpus;
+    this->warned[role].store(0);
+}
+
+// Locks current and future pages in RAM so the audio path never takes a page fault
+void threadPlacement::setLockMemory(bool lock){
+    this->lockMemory = lock;
+}
+
+threadConfig threadPlacement::get(int role){
+    return this->roles[role];
+}
+
+// Process-wide settings; call once from main before starting threads
+int threadPlacement::applyProcess(){
+    if (!this->lockMemory) {
+        return 1;
+    }
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+        printf("mlockall failed: %s (raise the memlock limit)\n", strerror(errno));
+        return 0;
+    }
+    return 1;
+}
+
+// Applies the role's placement to the calling thread. Returns 0 if any part
+// of it was refused; whatever could be applied stays applied. Called from
+// the audio callback, so refusals are reported through the logger, and only
+// the first for each role: every input's worker and every restarted stream
+// applies the same placement and would be refused the same way.
+int threadPlacement::apply(int role){
+    if (role < 0 || role >= THREAD_ROLE_COUNT) {
+        return 0;
+    }
+    const threadConfig& config = this->roles[role];
+    int ok = 1;
+
+    if (config.cpus != 0) {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for (int cpu = 0; cpu < THREAD_MAX_CPUS; cpu++) {
+            if (config.cpus & (1ULL << cpu)) {
+                CPU_SET(cpu, &cpus);
+            }
+        }
+        int err = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+        if (err != 0) {
+            if (!(this->warned[role].fetch_or(WARNED_PIN) & WARNED_PIN)) {
+                logWarn("Could not pin the %s thread: %s", roleNames[role], strerror(err));
+            }
+            ok = 0;
+        }
+    }
+
+    sched_param param;
+    memset(&param, 0, sizeof(param));
+    if (config.policy == SCHED_FIFO || config.policy == SCHED_RR) {
+        int low = sched_get_priority_min(config.policy);
+        int high = sched_get_priority_max(config.policy);
+        param.sched_priority = config.priority < low ? low : (config.priority > high ? high : config.priority);
+    }
+    int err = pthread_setschedparam(pthread_self(), config.policy, &param);
+    if (err != 0) {
+        if (!(this->warned[role].fetch_or(WARNED_SCHEDULE) & WARNED_SCHEDULE)) {
+            logWarn("Could not give the %s thread %s priority %d: %s (needs CAP_SYS_NICE or an rtprio limit)",
+                roleNames[role], policyName(config.policy), param.sched_priority, strerror(err));
+        }
+        ok = 0;
+    }
+    return ok;
+}
+
+threadJitter::threadJitter(double period){
+    this->period = period;
+    this->meanInterval = 0.0;
+    this->started = false;
+    this->samples.store(0);
+    this->totalNs.store(0);
+    this->worstNs.store(0);
+    this->late.store(0);
+    this->resetRequested.store(false);
+}
+
+// Only before the owning thread starts ticking
+void threadJitter::setPeriod(double seconds){
+    this->period = seconds;
+    this->started = false;
+}
+
+void threadJitter::tick(){
+    std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+    if (!this->started) {
+        this->started = true;
+        this->last = now;
+        return;
+    }
+    double interval = std::chrono::duration<double>(now - this->last).count();
+    this->last = now;
+
+    double expected = this->period;
+    if (expected <= 0.0) {
+        // Running mean over roughly the last hundred intervals
+        this->meanInterval = this->meanInterval == 0.0 ? interval : this->meanInterval + 0.01 * (interval - this->meanInterval);
+        expected = this->meanInterval;
+    }
+    this->record(std::fabs(interval - expected));
+}
+
+// One wakeup `seconds` away from when it should have happened. Owning thread only.
+void threadJitter::record(double seconds){
+    if (this->resetRequested.exchange(false)) {
+        this->samples.store(0, std::memory_order_relaxed);
+        this->totalNs.store(0, std::memory_order_relaxed);
+        this->worstNs.store(0, std::memory_order_relaxed);
+        this->late.store(0, std::memory_order_relaxed);
+    }
+    long long offNs = (long long)(seconds * 1e9);
+    this->samples.store(this->samples.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    this->totalNs.store(this->totalNs.load(std::memory_order_relaxed) + offNs, std::memory_order_relaxed);
+    if (offNs > this->worstNs.load(std::memory_order_relaxed)) {
+        this->worstNs.store(offNs, std::memory_order_relaxed);
+    }
+    if (offNs > JITTER_LATE_US * 1000.0) {
+        this->late.store(this->late.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+// Since the start or the last reset()
+jitterStats threadJitter::stats(){
+    jitterStats stats;
+    stats.samples = this->samples.load(std::memory_order_relaxed);
+    long long total = this->totalNs.load(std::memory_order_relaxed);
+    stats.meanUs = stats.samples > 0 ? total / 1000.0 / stats.samples : 0.0;
+    stats.worstUs = this->worstNs.load(std::memory_order_relaxed) / 1000.0;
+    stats.late = this->late.load(std::memory_order_relaxed);
+    return stats;
+}
+
+// Starts a new measurement window from the owning thread's next tick
+void threadJitter::reset(){
+    this->resetRequested.store(true);
+}
@@ -0,0 +1,89 @@
+#ifndef THREADPLACEMENT_H
+#define THREADPLACEMENT_H
+
+#include <atomic>
+#include <chrono>
+
+#define THREAD_MAX_CPUS 64        // Cores a placement mask can name
+#define JITTER_LATE_US 1000.0     // A wakeup this far off its period counts as late
+
+// Threads the visualiser places
+enum {
+    THREAD_AUDIO = 0,    // PortAudio callbacks (capture, and analysis for a single analyzer)
+    THREAD_ANALYSIS,     // deviceManager workers
+    THREAD_RENDER,       // The GL loop
+    THREAD_ROLE_COUNT
+};
+
+typedef struct {
+    int policy;                  // SCHED_OTHER, SCHED_FIFO or SCHED_RR
+    int priority;                // 1-99 for SCHED_FIFO / SCHED_RR, ignored otherwise
+    unsigned long long cpus;     // Bit per core the thread may run on, 0 to leave it alone
+} threadConfig;
+
+typedef struct {
+    unsigned long long samples;  // Wakeups measured
+    double meanUs;               // Mean distance from the expected period
+    double worstUs;
+    unsigned long long late;     // Wakeups more than JITTER_LATE_US off
+} jitterStats;
+
+// Scheduling policy, priority and CPU affinity per thread role, plus
+// optional mlockall, so the audio path can run on isolated cores with
+// real-time priority on the show machines. Each thread calls apply() with
+// its role once it is running. Without permission for real-time scheduling
+// (CAP_SYS_NICE or an rtprio limit) the thread stays SCHED_OTHER and only
+// the affinity is applied; the refusal is reported once per role, not once
+// per thread or stream restart.
+//
+// Placement can come from a file, one role per line:
+//   # role     policy  priority  cpus
+//   audio      fifo    80        2
+//   analysis   fifo    70        3-5
+//   render     other   0         0,1
+//   mlockall   yes
+class threadPlacement{
+    private:
+        threadConfig roles[THREAD_ROLE_COUNT];
+        bool lockMemory;
+        std::atomic<int> warned[THREAD_ROLE_COUNT];   // Refusals already reported for the role, a bit per kind
+    public:
+        threadPlacement();
+
+        int load(const char* path);
+        void set(int role, int policy, int priority, unsigned long long cpus);
+        void setLockMemory(bool);
+        threadConfig get(int role);
+
+        int applyProcess();
+        int apply(int role);
+};
+
+// Scheduling jitter of one periodic thread: how far each wakeup lands from
+// where the period says it should. The owning thread calls tick() once per
+// period; any thread may read stats(). With no period given the running
+// mean interval stands in for it (for the render loop, say). A thread that
+// knows how late it woke (a worker handed a timestamped block) can record()
+// that directly instead.
+class threadJitter{
+    private:
+        double period;            // Seconds, 0 to measure against the mean interval
+        double meanInterval;
+        std::chrono::steady_clock::time_point last;
+        bool started;
+        std::atomic<unsigned long long> samples;
+        std::atomic<long long> totalNs;
+        std::atomic<long long> worstNs;
+        std::atomic<unsigned long long> late;
+        std::atomic<bool> resetRequested;
+    public:
+        threadJitter(double period = 0.0);
+
+        void setPeriod(double seconds);
+        void tick();
+        void record(double seconds);
+        jitterStats stats();
+        void reset();
+};
+
+#endif
@@ -0,0 +1,175 @@
+#include "transientDetector.h"
+#include "simdKernels.h"
+
+// One-pole smoothing coefficient for a time constant in seconds
+static float followerCoeff(double sampleRate, double seconds){
+    return 1.0 - std::exp(-1.0 / (seconds * sampleRate));
+}
+
+static void fillBands(float* lanes, float value){
+    for (int i = 0; i < 4; i++) {
+        lanes[i] = value;
+    }
+}
+
+transientDetector::transientDetector(double sampleRate){
+    const double q = 0.70710678; // Butterworth, squared into LR4 by the second stage
+    biquadCoeffs lowLow = biquadLowpass(sampleRate, CROSSOVER_LOW_HZ, q);
+    biquadCoeffs lowHigh = biquadHighpass(sampleRate, CROSSOVER_LOW_HZ, q);
+    biquadCoeffs highHigh = biquadHighpass(sampleRate, CROSSOVER_HIGH_HZ, q);
+    biquadCoeffs highLow = biquadLowpass(sampleRate, CROSSOVER_HIGH_HZ, q);
+
+    // Lane 0: low band, lane 1: everything above the low split, lane 2: high
+    // band, lane 3: lane 1's previous output low-passed into the mid band.
+    // Pipelining the mid filter by one sample lets all eight sections run as
+    // two four-wide biquads.
+    biquad4* stages[2] = {&this->stageA, &this->stageB};
+    for (int s = 0; s < 2; s++) {
+        stages[s]->setLane(0, lowLow);
+        stages[s]->setLane(1, lowHigh);
+        stages[s]->setLane(2, highHigh);
+        stages[s]->setLane(3, highLow);
+    }
+
+    fillBands(this->envAttack, followerCoeff(sampleRate, 0.005));
+    fillBands(this->envRelease, followerCoeff(sampleRate, 0.120));
+    fillBands(this->fastAttack, followerCoeff(sampleRate, 0.0003));
+    fillBands(this->fastRelease, followerCoeff(sampleRate, 0.020));
+    fillBands(this->slowAttack, followerCoeff(sampleRate, 0.040));
+    fillBands(this->slowRelease, followerCoeff(sampleRate, 0.150));
+
+    this->refractorySamples = (unsigned long)(0.060 * sampleRate);
+    this->onsetRatio = 1.6f;
+    this->rearmRatio = 1.3f;
+    this->floor = 1e-3f;
+    this->reset();
+}
+
+void transientDetector::reset(){
+    this->stageA.reset();
+    this->stageB.reset();
+    this->midPipe = 0.0f;
+    fillBands(this->env, 0.0f);
+    fillBands(this->fast, 0.0f);
+    fillBands(this->slow, 0.0f);
+    for (int b = 0; b < NUM_BANDS; b++) {
+        this->armed[b] = true;
+        this->lastTransient[b] = 0;
+    }
+    this->sampleCount = 0;
+}
+
+void transientDetector::process(const float* in, unsigned long frames, transientResult* result){
+    typedef void (transientDetector::*blockKernel)(const float*, unsigned long, transientResult*);
+    static const blockKernel kernels[] = SIZED_KERNELS(&transientDetector::processBlock);
+    (this->*kernels[sizeSlot((int)frames)])(in, frames, result);
+}
+
+// The filters, envelopes and arming state live in locals for the whole
+// block and are stored back once at the end
+template <int N>
+void transientDetector::processBlock(const float* in, unsigned long frames, transientResult* result){
+    const unsigned long count = N > 0 ? N : frames;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        result->transient[b] = false;
+        result->transientOffset[b] = -1;
+    }
+    int armedBits = 0;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        armedBits |= this->armed[b] ? 1 << b : 0;
+    }
+    unsigned long long sampleCount = this->sampleCount;
+    float midPipe = this->midPipe;
+
+#if defined(__SSE2__)
+    biquad4::lanes stageA = this->stageA.load();
+    biquad4::lanes stageB = this->stageB.load();
+    __m128 e = _mm_load_ps(this->env);
+    __m128 f = _mm_load_ps(this->fast);
+    __m128 s = _mm_load_ps(this->slow);
+    const __m128 envAttack = _mm_load_ps(this->envAttack), envRelease = _mm_load_ps(this->envRelease);
+    const __m128 fastAttack = _mm_load_ps(this->fastAttack), fastRelease = _mm_load_ps(this->fastRelease);
+    const __m128 slowAttack = _mm_load_ps(this->slowAttack), slowRelease = _mm_load_ps(this->slowRelease);
+    const __m128 onsetRatio = _mm_set1_ps(this->onsetRatio);
+    const __m128 rearmRatio = _mm_set1_ps(this->rearmRatio);
+    const __m128 floor = _mm_set1_ps(this->floor);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+#endif
+
+    for (unsigned long i = 0; i < count; i++, sampleCount++) {
+        int onsetBits, rearmBits;
+#if defined(__SSE2__)
+        __m128 x = _mm_set_ps(midPipe, in[i], in[i], in[i]);
+        __m128 y = stageB.process(stageA.process(x));
+        midPipe = _mm_cvtss_f32(_mm_shuffle_ps(y, y, _MM_SHUFFLE(1, 1, 1, 1)));
+
+        // Reorder to [low, mid, high, -] and rectify
+        __m128 bands = _mm_shuffle_ps(y, y, _MM_SHUFFLE(1, 2, 3, 0));
+        bands = _mm_andnot_ps(sign, bands);
+
+        __m128 rising = _mm_cmpgt_ps(bands, e);
+        __m128 k = _mm_or_ps(_mm_and_ps(rising, envAttack), _mm_andnot_ps(rising, envRelease));
+        e = _mm_add_ps(e, _mm_mul_ps(k, _mm_sub_ps(bands, e)));
+        rising = _mm_cmpgt_ps(bands, f);
+        k = _mm_or_ps(_mm_and_ps(rising, fastAttack), _mm_andnot_ps(rising, fastRelease));
+        f = _mm_add_ps(f, _mm_mul_ps(k, _mm_sub_ps(bands, f)));
+        rising = _mm_cmpgt_ps(bands, s);
+        k = _mm_or_ps(_mm_and_ps(rising, slowAttack), _mm_andnot_ps(rising, slowRelease));
+        s = _mm_add_ps(s, _mm_mul_ps(k, _mm_sub_ps(bands, s)));
+
+        __m128 onset = _mm_and_ps(_mm_cmpgt_ps(f, _mm_mul_ps(s, onsetRatio)), _mm_cmpgt_ps(f, floor));
+        __m128 quiet = _mm_cmplt_ps(f, _mm_mul_ps(s, rearmRatio));
+        onsetBits = _mm_movemask_ps(onset);
+        rearmBits = _mm_movemask_ps(quiet);
+#else
+        float x[4] = {in[i], in[i], in[i], midPipe};
+        float a[4], y[4];
+        this->stageA.process(x, a);
+        this->stageB.process(a, y);
+        midPipe = y[1];
+
+        float bands[4] = {std::fabs(y[0]), std::fabs(y[3]), std::fabs(y[2]), 0.0f};
+        onsetBits = rearmBits = 0;
+        for (int b = 0; b < NUM_BANDS; b++) {
+            this->env[b] += (bands[b] > this->env[b] ? this->envAttack[b] : this->envRelease[b]) * (bands[b] - this->env[b]);
+            this->fast[b] += (bands[b] > this->fast[b] ? this->fastAttack[b] : this->fastRelease[b]) * (bands[b] - this->fast[b]);
+            this->slow[b] += (bands[b] > this->slow[b] ? this->slowAttack[b] : this->slowRelease[b]) * (bands[b] - this->slow[b]);
+            if (this->fast[b] > this->slow[b] * this->onsetRatio && this->fast[b] > this->floor) onsetBits |= 1 << b;
+            if (this->fast[b] < this->slow[b] * this->rearmRatio) rearmBits |= 1 << b;
+        }
+#endif
+
+        // Most samples neither fire an armed band nor could re-arm one
+        if (((onsetBits & armedBits) | (rearmBits & ~armedBits)) & ((1 << NUM_BANDS) - 1)) {
+            // Fire once per onset, then wait for the band to settle before re-arming
+            for (int b = 0; b < NUM_BANDS; b++) {
+                int bit = 1 << b;
+                if ((armedBits & bit) && (onsetBits & bit)) {
+                    armedBits &= ~bit;
+                    this->lastTransient[b] = sampleCount;
+                    if (!result->transient[b]) {
+                        result->transient[b] = true;
+                        result->transientOffset[b] = (int)i;
+                    }
+                } else if (!(armedBits & bit) && (rearmBits & bit)
+                           && sampleCount - this->lastTransient[b] >= this->refractorySamples) {
+                    armedBits |= bit;
+                }
+            }
+        }
+    }
+
+#if defined(__SSE2__)
+    this->stageA.store(stageA);
+    this->stageB.store(stageB);
+    _mm_store_ps(this->env, e);
+    _mm_store_ps(this->fast, f);
+    _mm_store_ps(this->slow, s);
+#endif
+    this->midPipe = midPipe;
+    this->sampleCount = sampleCount;
+    for (int b = 0; b < NUM_BANDS; b++) {
+        this->armed[b] = (armedBits & (1 << b)) != 0;
+        result->envelope[b] = this->env[b];
+    }
+}
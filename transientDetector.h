@@ -0,0 +1,59 @@
+#ifndef TRANSIENTDETECTOR_H
+#define TRANSIENTDETECTOR_H
+
+#include "biquad.h"
+
+#define CROSSOVER_LOW_HZ 150.0   // Low/mid split (kick lives below this)
+#define CROSSOVER_HIGH_HZ 2500.0 // Mid/high split (hats and snare crack above this)
+
+enum { BAND_LOW = 0, BAND_MID = 1, BAND_HIGH = 2, NUM_BANDS = 3 };
+
+// What the time-domain path saw in one block
+typedef struct {
+    float envelope[NUM_BANDS];      // Attack/release envelope of each band at the end of the block
+    bool transient[NUM_BANDS];      // A transient started somewhere in the block
+    int transientOffset[NUM_BANDS]; // Sample index of the first one, -1 if none
+} transientResult;
+
+// Per-sample time-domain analysis that runs next to the FFT path.
+// A Linkwitz-Riley (LR4) crossover splits the signal into low/mid/high, each
+// band gets an envelope follower, and a fast-vs-slow envelope comparison flags
+// transients within a millisecond or two of their onset instead of waiting
+// for a whole FFT block. Blocks of the analyzer's common hop sizes run a
+// loop specialised for that size (see SIZED_KERNELS in simdKernels.h).
+class transientDetector{
+    private:
+        biquad4 stageA;     // First section of every LR4 filter
+        biquad4 stageB;     // Second section
+        float midPipe;      // Low-cut output carried into the next sample's mid lane
+
+        // Attack/release coefficients, one lane per band (lane 3 unused)
+        alignas(16) float envAttack[4];
+        alignas(16) float envRelease[4];
+        alignas(16) float fastAttack[4];
+        alignas(16) float fastRelease[4];
+        alignas(16) float slowAttack[4];
+        alignas(16) float slowRelease[4];
+
+        alignas(16) float env[4];
+        alignas(16) float fast[4];
+        alignas(16) float slow[4];
+
+        bool armed[NUM_BANDS];
+        unsigned long long lastTransient[NUM_BANDS];
+        unsigned long long sampleCount;
+        unsigned long refractorySamples;
+
+        float onsetRatio;   // fast/slow ratio that counts as a transient
+        float rearmRatio;   // fast/slow ratio below which the band can fire again
+        float floor;        // Ignore anything quieter than this
+
+        template <int N> void processBlock(const float*, unsigned long, transientResult*);
+    public:
+        transientDetector(double sampleRate);
+
+        void reset();
+        void process(const float*, unsigned long, transientResult*);
+};
+
+#endif